@@ -0,0 +1,77 @@
+#include "onboardingflow.h"
+#include "softlanding.h"
+#include "setupwizard.h"
+#include <QMediaPlayer>
+#include <QAudioOutput>
+#include <QUrl>
+#include <QDebug>
+
+// Resources live in a static library, so they have to be registered explicitly
+static void initOnboardingResources() {
+    Q_INIT_RESOURCE(resources);
+}
+
+OnboardingFlow::OnboardingFlow(QObject *parent)
+    : QObject(parent), m_player(nullptr), m_audioOutput(nullptr),
+      m_softLanding(nullptr), m_wizard(nullptr), m_completed(false) {
+    initOnboardingResources();
+}
+
+OnboardingFlow::~OnboardingFlow() {
+    delete m_softLanding;
+    if (m_wizard) {
+        disconnect(m_wizard, nullptr, this, nullptr);
+        delete m_wizard;
+    }
+}
+
+void OnboardingFlow::start() {
+    m_player = new QMediaPlayer(this);
+    m_audioOutput = new QAudioOutput(this);
+    m_player->setAudioOutput(m_audioOutput);
+    m_player->setSource(QUrl("qrc:/music/The_Day_of_Night.mp3"));
+    m_audioOutput->setVolume(1.0); // Set volume (0.0 - 1.0)
+    
+    // Enable seamless looping
+    QMediaPlayer *player = m_player;
+    connect(player, &QMediaPlayer::mediaStatusChanged, this, [player](QMediaPlayer::MediaStatus status) {
+        if (status == QMediaPlayer::EndOfMedia) {
+            player->setPosition(0);  // Reset to beginning
+            player->play();          // Start playing again
+        }
+    });
+    
+    m_player->play();
+
+    m_softLanding = new SoftLanding;
+    m_softLanding->setFixedSize(1280, 720); // Set window size to 1280x720 (16:9)
+    connect(m_softLanding, &SoftLanding::finished, this, &OnboardingFlow::showWizard);
+    m_softLanding->show(); // Apple-style fullscreen welcome screen
+}
+
+void OnboardingFlow::showWizard() {
+    m_softLanding->hide();
+    
+    m_wizard = new SetupWizard;
+    m_wizard->setFixedSize(1280, 720); // Also set wizard size
+    m_wizard->setAttribute(Qt::WA_DeleteOnClose);
+    connect(m_wizard, &SetupWizard::setupCompleted, this, &OnboardingFlow::onSetupCompleted);
+    connect(m_wizard, &QObject::destroyed, this, &OnboardingFlow::onWizardDestroyed);
+    m_wizard->show();
+}
+
+void OnboardingFlow::onSetupCompleted(const QJsonObject &config) {
+    qDebug() << "Onboarding completed";
+    m_completed = true;
+    m_player->stop();
+    emit completed(config);
+}
+
+void OnboardingFlow::onWizardDestroyed() {
+    m_wizard = nullptr;
+    if (!m_completed) {
+        qDebug() << "Onboarding closed before completion";
+        m_player->stop();
+        emit cancelled();
+    }
+}
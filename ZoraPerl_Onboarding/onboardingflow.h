@@ -0,0 +1,40 @@
+#ifndef ONBOARDINGFLOW_H
+#define ONBOARDINGFLOW_H
+
+#include <QObject>
+#include <QJsonObject>
+
+class QMediaPlayer;
+class QAudioOutput;
+class SoftLanding;
+class SetupWizard;
+
+// Welcome screen, setup wizard and background music as one unit, so the
+// onboarding can run standalone or inside the ZoraPerl desktop process.
+class OnboardingFlow : public QObject {
+    Q_OBJECT
+
+public:
+    explicit OnboardingFlow(QObject *parent = nullptr);
+    ~OnboardingFlow();
+
+    void start();
+
+signals:
+    void completed(const QJsonObject &config);
+    void cancelled();
+
+private slots:
+    void showWizard();
+    void onSetupCompleted(const QJsonObject &config);
+    void onWizardDestroyed();
+
+private:
+    QMediaPlayer *m_player;
+    QAudioOutput *m_audioOutput;
+    SoftLanding *m_softLanding;
+    SetupWizard *m_wizard;
+    bool m_completed;
+};
+
+#endif // ONBOARDINGFLOW_H
@@ -1,4 +1,5 @@
 #include "setupwizard.h"
+#include "zora_layout.h"
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QLabel>
@@ -532,7 +533,10 @@ void SetupWizard::previousStep() {
 
 void SetupWizard::finishSetup() {
     collectUserData();
-    saveConfigToFile();
+    if (saveConfigToFile()) {
+        // Emitted before closing so a host can show its next window first
+        emit setupCompleted(configData);
+    }
     close();
 }
 
@@ -575,76 +579,13 @@ void SetupWizard::collectUserData() {
     configData["setupDate"] = QDateTime::currentDateTime().toString(Qt::ISODate);
 }
 
-void SetupWizard::saveConfigToFile() {
-    // Get the application's directory and navigate to find ZoraPerl/etc
-    QDir appDir(QCoreApplication::applicationDirPath());
-    qDebug() << "Application directory:" << appDir.absolutePath();
-    
-    // Navigate up to find the ZoraPerl directory
-    QString configPath;
-    QDir searchDir = appDir;
-    
-    // Try different levels up to find ZoraPerl/etc
-    for (int i = 0; i < 5; ++i) {
-        qDebug() << "Searching in:" << searchDir.absolutePath();
-        
-        QDir zoraDir(searchDir.absoluteFilePath("ZoraPerl/etc"));
-        qDebug() << "Checking path:" << zoraDir.absolutePath();
-        
-        if (zoraDir.exists()) {
-            configPath = zoraDir.absolutePath();
-            qDebug() << "Found ZoraPerl/etc at:" << configPath;
-            break;
-        }
-        
-        // Also check if we're already in ZoraPerl and etc exists
-        QDir etcDir(searchDir.absoluteFilePath("etc"));
-        if (etcDir.exists() && searchDir.dirName() == "ZoraPerl") {
-            configPath = etcDir.absolutePath();
-            qDebug() << "Found etc directory in ZoraPerl at:" << configPath;
-            break;
-        }
-        
-        if (!searchDir.cdUp()) {
-            qDebug() << "Cannot navigate up further";
-            break; // Can't go up anymore
-        }
-    }
-    
-    // If not found, try relative to current working directory
-    if (configPath.isEmpty()) {
-        qDebug() << "Trying current working directory approach";
-        QDir currentDir = QDir::current();
-        qDebug() << "Current working directory:" << currentDir.absolutePath();
-        
-        for (int i = 0; i < 5; ++i) {
-            QDir zoraDir(currentDir.absoluteFilePath("ZoraPerl/etc"));
-            qDebug() << "Checking path:" << zoraDir.absolutePath();
-            
-            if (zoraDir.exists()) {
-                configPath = zoraDir.absolutePath();
-                qDebug() << "Found ZoraPerl/etc at:" << configPath;
-                break;
-            }
-            if (!currentDir.cdUp()) {
-                break;
-            }
-        }
-    }
-    
-    // Create the directory if it doesn't exist
+bool SetupWizard::saveConfigToFile() {
+    // Shared resolver, so the desktop finds the config where we write it
+    QString configPath = ZoraLayout::path("etc");
     QDir configDir(configPath);
-    if (configPath.isEmpty() || !configDir.exists()) {
-        if (configPath.isEmpty()) {
-            // Fallback: create relative to application directory
-            configPath = appDir.absoluteFilePath("../ZoraPerl/etc");
-            configDir = QDir(configPath);
-        }
-        
-        if (!configDir.mkpath(".")) {
-            QMessageBox::warning(this, "Error", "Failed to create configuration directory: " + configPath);
-            return;
-        }
+    if (!configDir.mkpath(".")) {
+        QMessageBox::warning(this, "Error", "Failed to create configuration directory: " + configPath);
+        return false;
     }
     
     // Create the full file path - use config.json as requested
@@ -660,8 +601,10 @@ void SetupWizard::saveConfigToFile() {
         file.close();
         qDebug() << "Configuration saved to:" << configFilePath;
         QMessageBox::information(this, "Success", "Configuration saved successfully!");
-    } else {
-        QMessageBox::warning(this, "Error", "Failed to save configuration file: " + configFilePath);
+        return true;
     }
+    
+    QMessageBox::warning(this, "Error", "Failed to save configuration file: " + configFilePath);
+    return false;
 }
 // :3
\ No newline at end of file
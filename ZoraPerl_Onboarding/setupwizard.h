@@ -22,6 +22,9 @@ class SetupWizard : public QWidget {
 public:
     SetupWizard(QWidget *parent = nullptr);
 
+signals:
+    void setupCompleted(const QJsonObject &config);
+
 private slots:
     void nextStep();
     void previousStep();
@@ -62,7 +65,7 @@ private:
     QWidget *createSummaryStep();
     
     void collectUserData();
-    void saveConfigToFile();
+    bool saveConfigToFile();
     void updateStepIndicator();
 };
 
@@ -1,4 +1,5 @@
 #include "softlanding.h"
+#include "zora_layout.h"
 #include <QVBoxLayout>
 #include <QFont>
 #include <QPalette>
@@ -42,67 +43,9 @@ SoftLanding::SoftLanding(QWidget *parent) : QWidget(parent) {
 void SoftLanding::setupDirectories() {
     greeting->setText("Setting up directories...");
     
-    // Find the main Zora_Perl directory by backtracking from executable location
-    QString executablePath = QCoreApplication::applicationDirPath();
-    QDir currentDir(executablePath);
-    
-    qDebug() << "Starting from executable path:" << executablePath;
-    
-    // Navigate up until we find the main Zora_Perl directory
-    QString zoraMainPath;
-    while (currentDir.cdUp()) {
-        qDebug() << "Checking directory:" << currentDir.absolutePath();
-        if (currentDir.dirName() == "Zora_Perl") {
-            zoraMainPath = currentDir.absolutePath();
-            qDebug() << "Found Zora_Perl main directory:" << zoraMainPath;
-            break;
-        }
-    }
-    
-    if (zoraMainPath.isEmpty()) {
-        qDebug() << "Could not find Zora_Perl main directory, using current path";
-        zoraMainPath = executablePath + "/../../";  // Fallback
-    }
-    
-    // Create ZoraPerl directory and subdirectories
-    QDir mainDir(zoraMainPath);
-    QString zoraPerlPath = mainDir.absoluteFilePath("ZoraPerl");
-    
-    QDir zoraPerlDir(zoraPerlPath);
-    if (!zoraPerlDir.exists()) {
-        qDebug() << "Creating ZoraPerl directory structure...";
-        
-        // Create main ZoraPerl directory
-        if (!mainDir.mkdir("ZoraPerl")) {
-            qDebug() << "Failed to create ZoraPerl directory";
-        } else {
-            qDebug() << "Created ZoraPerl directory at:" << zoraPerlPath;
-        }
-        
-        // Create subdirectories
-        QStringList subdirs = {"bin", "compat", "etc", "system", "users"};
-        for (const QString &subdir : subdirs) {
-            if (!zoraPerlDir.mkdir(subdir)) {
-                qDebug() << "Failed to create" << subdir << "directory";
-            } else {
-                qDebug() << "Created" << subdir << "directory";
-            }
-        }
-    } else {
-        qDebug() << "ZoraPerl directory structure already exists";
-        
-        // Check if all subdirectories exist, create missing ones
-        QStringList subdirs = {"bin", "compat", "etc", "system", "users"};
-        for (const QString &subdir : subdirs) {
-            QString subdirPath = zoraPerlDir.absoluteFilePath(subdir);
-            if (!QDir(subdirPath).exists()) {
-                if (!zoraPerlDir.mkdir(subdir)) {
-                    qDebug() << "Failed to create missing" << subdir << "directory";
-                } else {
-                    qDebug() << "Created missing" << subdir << "directory";
-                }
-            }
-        }
+    // Create ZoraPerl directory and any missing subdirectories
+    if (!ZoraLayout::createMissingDirectories()) {
+        qDebug() << "Failed to create ZoraPerl directory structure at:" << ZoraLayout::rootPath();
     }
     
     // Show completion message
@@ -0,0 +1,113 @@
+// Measures how many PythonManager calls per second go through with 1..N
+// calling threads. Build once against the regular CPython and once with
+// -DZORAPERL_PYTHON_FREETHREADED=ON, then compare the tables.
+//
+//   ZoraPerlPythonBenchmark [iterations-per-thread] [max-threads]
+
+#include "python_manager.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QTextStream>
+#include <QList>
+#include <atomic>
+#include <functional>
+
+namespace {
+struct Workload {
+    const char *name;
+    std::function<bool(PythonManager &)> run;
+};
+
+double measure(PythonManager &python, const Workload &workload, int threads, int iterations) {
+    std::atomic<int> failures(0);
+    QList<QThread *> workers;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    for (int i = 0; i < threads; ++i) {
+        QThread *worker = QThread::create([&]() {
+            for (int n = 0; n < iterations; ++n) {
+                if (!workload.run(python)) {
+                    ++failures;
+                }
+            }
+        });
+        workers.append(worker);
+        worker->start();
+    }
+
+    for (QThread *worker : std::as_const(workers)) {
+        worker->wait();
+        delete worker;
+    }
+
+    qint64 elapsed = qMax<qint64>(1, timer.nsecsElapsed());
+    if (failures > 0) {
+        QTextStream(stderr) << workload.name << ": " << failures.load() << " calls failed\n";
+    }
+    return double(threads) * iterations * 1e9 / elapsed;
+}
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QStringList args = app.arguments();
+    int iterations = args.size() > 1 ? args.at(1).toInt() : 200;
+    int maxThreads = args.size() > 2 ? args.at(2).toInt() : QThread::idealThreadCount();
+
+    QTextStream out(stdout);
+
+    PythonManager python;
+    if (!python.initialize()) {
+        QTextStream(stderr) << "Python failed to initialize\n";
+        return 1;
+    }
+
+    out << "Python " << python.getVersion().section(' ', 0, 0)
+        << (PythonManager::isFreeThreadedBuild() ? " (free-threaded build)" : " (GIL build)")
+        << ", concurrent execution: " << (python.runsConcurrently() ? "yes" : "no") << "\n";
+
+    const QList<Workload> workloads = {
+        {"executeString: integer loop", [](PythonManager &p) {
+            return p.executeString("total = 0\nfor i in range(20000):\n    total += i * i\n");
+        }},
+        {"executeString: string building", [](PythonManager &p) {
+            return p.executeString("parts = [str(i) for i in range(5000)]\ntext = ','.join(parts)\n");
+        }},
+        {"evaluateExpression: sum", [](PythonManager &p) {
+            return !p.evaluateExpression("sum(x * 3 for x in range(10000))").startsWith("Error:");
+        }},
+        {"evaluateExpression: arithmetic", [](PythonManager &p) {
+            return p.evaluateExpression("3*(4+5)/2 + math.sqrt(2)") == "14.914213562373096";
+        }},
+        {"evaluate: typed list", [](PythonManager &p) {
+            return p.evaluate("[x * 0.5 for x in range(1000)]").success;
+        }},
+    };
+
+    QList<int> threadCounts;
+    for (int threads = 1; threads < maxThreads; threads *= 2) {
+        threadCounts.append(threads);
+    }
+    threadCounts.append(qMax(1, maxThreads));
+
+    for (const Workload &workload : workloads) {
+        out << "\n" << workload.name << "\n";
+        double baseline = 0;
+        for (int threads : std::as_const(threadCounts)) {
+            double rate = measure(python, workload, threads, iterations);
+            if (baseline == 0) {
+                baseline = rate;
+            }
+            out << QString("  %1 threads: %2 calls/s (%3x)\n")
+                       .arg(threads, 3)
+                       .arg(rate, 10, 'f', 0)
+                       .arg(rate / baseline, 0, 'f', 2);
+            out.flush();
+        }
+    }
+
+    return 0;
+}
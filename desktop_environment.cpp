@@ -1,4 +1,9 @@
 #include "desktop_environment.h"
+#include "startup_trace.h"
+#include "python_console.h"
+#include "wallpaper_engine.h"
+#include "desktop_icons.h"
+#include "zora_layout.h"
 #include <QApplication>
 #include <QScreen>
 #include <QPainter>
@@ -19,39 +24,72 @@
 #include <QSystemTrayIcon>
 #include <QDebug>
 #include <QCursor>
+#include <QPaintEvent>
+#include <QResizeEvent>
+#include <QShowEvent>
+#include <QHideEvent>
+
+DesktopSurface::DesktopSurface(QScreen *screen, QWidget *parent)
+    : QWidget(parent), m_backgroundDirty(true), m_wallpaperEngine(new WallpaperEngine(this)) {
+    setWindowFlags(Qt::Window | Qt::FramelessWindowHint);
+    
+    // paintEvent covers every exposed pixel from the cached background
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    
+    connect(m_wallpaperEngine, &WallpaperEngine::ready, this, &DesktopSurface::onWallpaperReady);
+    setTargetScreen(screen);
+}
+
+QScreen *DesktopSurface::targetScreen() const {
+    return m_screen;
+}
+
+void DesktopSurface::setTargetScreen(QScreen *screen) {
+    disconnect(m_geometryConnection);
+    m_screen = screen;
+    if (!screen) {
+        return;
+    }
+    
+    setScreen(screen);
+    setGeometry(screen->geometry());
+    m_geometryConnection = connect(screen, &QScreen::geometryChanged, this, [this](const QRect &geometry) {
+        setGeometry(geometry);
+    });
+}
 
 DesktopEnvironment::DesktopEnvironment(QWidget *parent)
-    : QWidget(parent), m_taskBar(nullptr), m_trayIcon(nullptr), m_desktopMenu(nullptr) {
+    : DesktopSurface(QApplication::primaryScreen(), parent), m_taskBar(nullptr), m_trayIcon(nullptr),
+      m_desktopMenu(nullptr), m_pythonConsoleAction(nullptr), m_pythonManager(nullptr),
+      m_pythonConsole(nullptr), m_iconView(nullptr) {
     setupDesktop();
     setupTaskBar();
     setupTrayIcon();
+    setupScreens();
 }
 
 void DesktopEnvironment::setupDesktop() {
-    // Set up the desktop to be full screen
-    setWindowTitle("ZoraPerl Desktop");
-    setWindowFlags(Qt::Window | Qt::FramelessWindowHint);
+    TraceSpan span("DesktopEnvironment::setupDesktop", "desktop");
     
-    // Get screen geometry (Qt6 way)
-    QScreen *screen = QApplication::primaryScreen();
-    if (screen) {
-        QRect screenGeometry = screen->geometry();
-        setGeometry(screenGeometry);
-    }
+    // DesktopSurface already fills the primary screen
+    setWindowTitle("ZoraPerl Desktop");
     
     // Set up layout
     QVBoxLayout *mainLayout = new QVBoxLayout(this);
     mainLayout->setContentsMargins(0, 0, 0, 0);
     mainLayout->setSpacing(0);
     
-    // Add stretch to push taskbar to bottom
-    mainLayout->addStretch();
+    // Icons fill the space above the taskbar, pushing it to the bottom
+    m_iconView = new DesktopIconView(this);
+    mainLayout->addWidget(m_iconView, 1);
     
     // Create desktop context menu
     m_desktopMenu = new QMenu(this);
     
     QAction *terminalAction = m_desktopMenu->addAction("Open Terminal");
     QAction *fileManagerAction = m_desktopMenu->addAction("File Manager");
+    m_pythonConsoleAction = m_desktopMenu->addAction("Python Console");
+    m_pythonConsoleAction->setVisible(false);
     m_desktopMenu->addSeparator();
     QAction *settingsAction = m_desktopMenu->addAction("Settings");
     QAction *aboutAction = m_desktopMenu->addAction("About ZoraPerl");
@@ -60,6 +98,7 @@ void DesktopEnvironment::setupDesktop() {
     
     connect(terminalAction, &QAction::triggered, this, &DesktopEnvironment::openTerminal);
     connect(fileManagerAction, &QAction::triggered, this, &DesktopEnvironment::openFileManager);
+    connect(m_pythonConsoleAction, &QAction::triggered, this, &DesktopEnvironment::openPythonConsole);
     connect(settingsAction, &QAction::triggered, this, &DesktopEnvironment::openSettings);
     connect(aboutAction, &QAction::triggered, this, &DesktopEnvironment::showAbout);
     connect(exitAction, &QAction::triggered, qApp, &QApplication::quit);
@@ -67,10 +106,14 @@ void DesktopEnvironment::setupDesktop() {
     // Set minimum size
     setMinimumSize(800, 600);
     
+    connect(this, &DesktopSurface::contextMenuRequested, this, &DesktopEnvironment::showDesktopMenuAt);
+    
     qDebug() << "Desktop environment initialized";
 }
 
 void DesktopEnvironment::setupTaskBar() {
+    TraceSpan span("DesktopEnvironment::setupTaskBar", "desktop");
+    
     m_taskBar = new TaskBar(this);
     
     // Add taskbar to layout
@@ -81,6 +124,8 @@ void DesktopEnvironment::setupTaskBar() {
 }
 
 void DesktopEnvironment::setupTrayIcon() {
+    TraceSpan span("DesktopEnvironment::setupTrayIcon", "desktop");
+    
     if (!QSystemTrayIcon::isSystemTrayAvailable()) {
         qDebug() << "System tray not available";
         return;
@@ -106,8 +151,110 @@ void DesktopEnvironment::setupTrayIcon() {
     m_trayIcon->show();
 }
 
-void DesktopEnvironment::paintEvent(QPaintEvent *event) {
+void DesktopEnvironment::setupScreens() {
+    TraceSpan span("DesktopEnvironment::setupScreens", "desktop");
+    
+    for (QScreen *screen : QApplication::screens()) {
+        if (screen != targetScreen()) {
+            addScreen(screen);
+        }
+    }
+    
+    // Only the affected screen's surface is created or destroyed
+    connect(qApp, &QGuiApplication::screenAdded, this, &DesktopEnvironment::addScreen);
+    connect(qApp, &QGuiApplication::screenRemoved, this, &DesktopEnvironment::removeScreen);
+    connect(qApp, &QGuiApplication::primaryScreenChanged, this, &DesktopEnvironment::onPrimaryScreenChanged);
+}
+
+void DesktopEnvironment::addScreen(QScreen *screen) {
+    if (!screen || screen == targetScreen() || m_screenSurfaces.contains(screen)) {
+        return;
+    }
+    
+    DesktopSurface *surface = new DesktopSurface(screen, this);
+    surface->setWindowTitle(QString("ZoraPerl Desktop (%1)").arg(screen->name()));
+    surface->setWallpaper(m_wallpaperPath);
+    connect(surface, &DesktopSurface::contextMenuRequested, this, &DesktopEnvironment::showDesktopMenuAt);
+    m_screenSurfaces.insert(screen, surface);
+    
+    if (isVisible()) {
+        surface->show();
+    }
+}
+
+void DesktopEnvironment::removeScreen(QScreen *screen) {
+    if (DesktopSurface *surface = m_screenSurfaces.take(screen)) {
+        delete surface;
+    }
+}
+
+void DesktopEnvironment::onPrimaryScreenChanged(QScreen *screen) {
+    // The taskbar follows the primary screen; the old primary gets a plain surface
+    QScreen *previous = targetScreen();
+    if (!screen || screen == previous) {
+        return;
+    }
+    removeScreen(screen);
+    setTargetScreen(screen);
+    if (previous && QApplication::screens().contains(previous)) {
+        addScreen(previous);
+    }
+}
+
+void DesktopEnvironment::showEvent(QShowEvent *event) {
+    DesktopSurface::showEvent(event);
+    for (DesktopSurface *surface : std::as_const(m_screenSurfaces)) {
+        surface->show();
+    }
+}
+
+void DesktopEnvironment::hideEvent(QHideEvent *event) {
+    for (DesktopSurface *surface : std::as_const(m_screenSurfaces)) {
+        surface->hide();
+    }
+    DesktopSurface::hideEvent(event);
+}
+
+void DesktopSurface::paintEvent(QPaintEvent *event) {
+    // Menus closing and taskbar updates repaint small parts of the desktop;
+    // those only copy the matching pixels out of the cached background
+    const qreal dpr = devicePixelRatioF();
+    if (m_backgroundDirty || m_background.devicePixelRatio() != dpr
+        || m_background.deviceIndependentSize().toSize() != size()) {
+        renderBackground();
+    }
+    
     QPainter painter(this);
+    for (const QRect &rect : event->region()) {
+        QRectF source(rect.x() * dpr, rect.y() * dpr, rect.width() * dpr, rect.height() * dpr);
+        painter.drawPixmap(QRectF(rect), m_background, source);
+    }
+    
+    // The first completed paint ends the startup trace (no-op once written)
+    StartupTrace::instance().finish("DesktopEnvironment first paint");
+}
+
+void DesktopSurface::renderBackground() {
+    TraceSpan span("DesktopSurface::renderBackground", "desktop");
+    
+    const qreal dpr = devicePixelRatioF();
+    m_background = QPixmap(size() * dpr);
+    m_background.setDevicePixelRatio(dpr);
+    m_backgroundDirty = false;
+    
+    // Painted in logical coordinates; the pixmap's ratio maps them to device pixels
+    QPainter painter(&m_background);
+    painter.setRenderHint(QPainter::TextAntialiasing);
+    
+    // A wallpaper decoded for another size is stretched until the right one arrives
+    if (!m_wallpaper.isNull()) {
+        if (m_wallpaper.size() != m_background.size()) {
+            painter.setRenderHint(QPainter::SmoothPixmapTransform);
+            requestWallpaper();
+        }
+        painter.drawImage(rect(), m_wallpaper);
+        return;
+    }
     
     // Create gradient background
     QLinearGradient gradient(0, 0, 0, height());
@@ -135,16 +282,85 @@ void DesktopEnvironment::paintEvent(QPaintEvent *event) {
     painter.drawText(welcomeRect, Qt::AlignCenter | Qt::AlignTop, "Right-click for options");
 }
 
-void DesktopEnvironment::mousePressEvent(QMouseEvent *event) {
-    if (event->button() == Qt::LeftButton) {
-        // Left click - could be used for desktop icons in the future
-        qDebug() << "Desktop left-clicked at:" << event->pos();
+void DesktopEnvironment::setWallpaper(const QString &path) {
+    m_wallpaperPath = path;
+    DesktopSurface::setWallpaper(path);
+    for (DesktopSurface *surface : std::as_const(m_screenSurfaces)) {
+        surface->setWallpaper(path);
+    }
+}
+
+void DesktopSurface::setWallpaper(const QString &path) {
+    if (path == m_wallpaperPath) {
+        return;
+    }
+    m_wallpaperPath = path;
+    m_wallpaper = QImage();
+    
+    // A variant cached by an earlier boot is mapped right away; only a new
+    // photo or size is decoded, on the thread pool
+    if (!path.isEmpty()) {
+        m_wallpaper = m_wallpaperEngine->cached(path, size() * devicePixelRatioF());
+        if (m_wallpaper.isNull()) {
+            requestWallpaper();
+        }
+    }
+    invalidateBackground();
+}
+
+void DesktopSurface::requestWallpaper() {
+    if (!m_wallpaperPath.isEmpty()) {
+        m_wallpaperEngine->request(m_wallpaperPath, size() * devicePixelRatioF());
+    }
+}
+
+void DesktopSurface::onWallpaperReady(const QString &path, const QImage &image) {
+    // Results for an older size are fine as a stand-in; renderBackground asks again
+    if (path != m_wallpaperPath) {
+        return;
+    }
+    m_wallpaper = image;
+    invalidateBackground();
+}
+
+void DesktopSurface::invalidateBackground() {
+    m_backgroundDirty = true;
+    update();
+}
+
+void DesktopSurface::resizeEvent(QResizeEvent *event) {
+    invalidateBackground();
+    QWidget::resizeEvent(event);
+}
+
+void DesktopSurface::changeEvent(QEvent *event) {
+    switch (event->type()) {
+    case QEvent::PaletteChange:
+    case QEvent::StyleChange:
+    case QEvent::FontChange:
+        invalidateBackground();
+        break;
+    default:
+        break;
     }
-    QWidget::mousePressEvent(event);
+    QWidget::changeEvent(event);
 }
 
-void DesktopEnvironment::contextMenuEvent(QContextMenuEvent *event) {
-    m_desktopMenu->exec(event->globalPos());
+bool DesktopSurface::event(QEvent *event) {
+    // Moving to another screen can change the device pixel ratio; the system
+    // theme changing means the cached text rendering may be stale
+    if (event->type() == QEvent::ScreenChangeInternal || event->type() == QEvent::ThemeChange) {
+        invalidateBackground();
+    }
+    return QWidget::event(event);
+}
+
+void DesktopSurface::contextMenuEvent(QContextMenuEvent *event) {
+    emit contextMenuRequested(event->globalPos());
+}
+
+void DesktopEnvironment::showDesktopMenuAt(const QPoint &globalPos) {
+    m_desktopMenu->exec(globalPos);
 }
 
 void DesktopEnvironment::showDesktopMenu() {
@@ -199,8 +415,44 @@ void DesktopEnvironment::showAbout() {
                        "© 2024 ZoraPerl Project");
 }
 
+void DesktopEnvironment::openPythonConsole() {
+    if (!m_pythonManager) {
+        QMessageBox::warning(this, "Error", "Python is not available");
+        return;
+    }
+    
+    // Kept after closing so scrollback and history survive reopening
+    if (!m_pythonConsole) {
+        m_pythonConsole = new PythonConsole(m_pythonManager, this);
+    }
+    m_pythonConsole->show();
+    m_pythonConsole->raise();
+    m_pythonConsole->activateWindow();
+}
+
+void DesktopEnvironment::setPythonManager(PythonManager *pythonManager) {
+    m_pythonManager = pythonManager;
+}
+
+void DesktopEnvironment::setUserName(const QString &userName) {
+    // The name comes from the config file; never let it point outside users/
+    if (userName.isEmpty() || userName.contains('/') || userName.contains('\\') || userName.startsWith('.')) {
+        m_iconView->setDirectory(QString());
+        return;
+    }
+    m_iconView->setDirectory(ZoraLayout::path(QString("users/%1/Desktop").arg(userName)));
+}
+
+void DesktopEnvironment::setDeveloperMode(bool enabled) {
+    m_pythonConsoleAction->setVisible(enabled);
+    m_taskBar->setPythonConsoleVisible(enabled);
+    if (!enabled && m_pythonConsole) {
+        m_pythonConsole->hide();
+    }
+}
+
 // TaskBar implementation
-TaskBar::TaskBar(QWidget *parent) : QWidget(parent) {
+TaskBar::TaskBar(QWidget *parent) : QWidget(parent), m_pythonConsoleAction(nullptr) {
     setupTaskBar();
 }
 
@@ -262,6 +514,12 @@ void TaskBar::setupTaskBar() {
             desktop->openFileManager();
         }
     });
+    m_pythonConsoleAction = m_startMenu->addAction("Python Console", [this]() {
+        if (DesktopEnvironment *desktop = qobject_cast<DesktopEnvironment*>(parent())) {
+            desktop->openPythonConsole();
+        }
+    });
+    m_pythonConsoleAction->setVisible(false);
     m_startMenu->addSeparator();
     m_startMenu->addAction("Settings", [this]() {
         if (DesktopEnvironment *desktop = qobject_cast<DesktopEnvironment*>(parent())) {
@@ -277,6 +535,10 @@ void TaskBar::setupTaskBar() {
     m_startMenu->addAction("Exit", qApp, &QApplication::quit);
 }
 
+void TaskBar::setPythonConsoleVisible(bool visible) {
+    m_pythonConsoleAction->setVisible(visible);
+}
+
 void TaskBar::updateClock() {
     QDateTime currentTime = QDateTime::currentDateTime();
     QString timeString = currentTime.toString("hh:mm:ss");
@@ -10,11 +10,64 @@
 #include <QTimer>
 #include <QMenu>
 #include <QSystemTrayIcon>
+#include <QPixmap>
+#include <QImage>
+#include <QHash>
+#include <QPointer>
+#include <QScreen>
 
 class TaskBar;
-class DesktopBackground;
+class PythonManager;
+class PythonConsole;
+class WallpaperEngine;
+class DesktopIconView;
 
-class DesktopEnvironment : public QWidget {
+// The desktop on one screen: fills that screen and keeps its own cached
+// background and wallpaper at the screen's size and device pixel ratio, so
+// a repaint or resize on one monitor never touches another.
+class DesktopSurface : public QWidget {
+    Q_OBJECT
+
+public:
+    explicit DesktopSurface(QScreen *screen, QWidget *parent = nullptr);
+    
+    QScreen *targetScreen() const;
+    void setTargetScreen(QScreen *screen);
+    
+    // Image drawn instead of the gradient; an empty path restores the gradient
+    void setWallpaper(const QString &path);
+
+signals:
+    void contextMenuRequested(const QPoint &globalPos);
+    
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void changeEvent(QEvent *event) override;
+    bool event(QEvent *event) override;
+    void contextMenuEvent(QContextMenuEvent *event) override;
+
+private:
+    void renderBackground();
+    void invalidateBackground();
+    void requestWallpaper();
+    void onWallpaperReady(const QString &path, const QImage &image);
+    
+    QPointer<QScreen> m_screen;
+    QMetaObject::Connection m_geometryConnection;
+    
+    // Gradient and text rendered once per size, device pixel ratio and theme
+    QPixmap m_background;
+    bool m_backgroundDirty;
+    
+    WallpaperEngine *m_wallpaperEngine;
+    QString m_wallpaperPath;
+    QImage m_wallpaper;     // scaled to this surface's size in device pixels
+};
+
+// The primary screen's surface, with the taskbar and menus. Every other
+// screen gets a plain DesktopSurface, created and removed as screens come and go.
+class DesktopEnvironment : public DesktopSurface {
     Q_OBJECT
 
 public:
@@ -25,11 +78,21 @@ public:
     void openFileManager();
     void openSettings();
     void showAbout();
+    void openPythonConsole();
+    
+    // The Python console is offered on developerMode machines only
+    void setPythonManager(PythonManager *pythonManager);
+    void setDeveloperMode(bool enabled);
+    
+    // Applies to every screen
+    void setWallpaper(const QString &path);
+    
+    // Shows the icons in ZoraPerl/users/<name>/Desktop
+    void setUserName(const QString &userName);
     
 protected:
-    void paintEvent(QPaintEvent *event) override;
-    void mousePressEvent(QMouseEvent *event) override;
-    void contextMenuEvent(QContextMenuEvent *event) override;
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
 
 public slots:
     void showDesktopMenu();
@@ -38,11 +101,23 @@ private:
     void setupDesktop();
     void setupTaskBar();
     void setupTrayIcon();
+    void setupScreens();
+    void addScreen(QScreen *screen);
+    void removeScreen(QScreen *screen);
+    void onPrimaryScreenChanged(QScreen *screen);
+    void showDesktopMenuAt(const QPoint &globalPos);
     
     TaskBar *m_taskBar;
     QSystemTrayIcon *m_trayIcon;
     QMenu *m_desktopMenu;
+    QAction *m_pythonConsoleAction;
     QTimer *m_clockTimer;
+    PythonManager *m_pythonManager;
+    PythonConsole *m_pythonConsole;
+    DesktopIconView *m_iconView;
+    
+    QHash<QScreen *, DesktopSurface *> m_screenSurfaces;   // secondary screens
+    QString m_wallpaperPath;
 };
 
 class TaskBar : public QWidget {
@@ -51,6 +126,8 @@ class TaskBar : public QWidget {
 public:
     explicit TaskBar(QWidget *parent = nullptr);
     
+    void setPythonConsoleVisible(bool visible);
+    
 private slots:
     void updateClock();
     void showStartMenu();
@@ -62,6 +139,7 @@ private:
     QLabel *m_clockLabel;
     QTimer *m_clockTimer;
     QMenu *m_startMenu;
+    QAction *m_pythonConsoleAction;
 };
 
 #endif // DESKTOP_ENVIRONMENT_H
\ No newline at end of file
@@ -0,0 +1,544 @@
+#include "desktop_icons.h"
+#include "startup_trace.h"
+#include "thumbnail_cache.h"
+#include <QApplication>
+#include <QCursor>
+#include <QDateTime>
+#include <QDebug>
+#include <QDesktopServices>
+#include <QDir>
+#include <QFileIconProvider>
+#include <QFileSystemWatcher>
+#include <QFontMetrics>
+#include <QMouseEvent>
+#include <QPaintEvent>
+#include <QPainter>
+#include <QRubberBand>
+#include <QScrollBar>
+#include <QSet>
+#include <QTimer>
+#include <QUrl>
+#include <QWheelEvent>
+#include <QtConcurrent>
+
+namespace {
+const int kPreviewCacheKiB = 16 << 10;
+const int kTypeIconCacheKiB = 4 << 10;
+const int kIconsPerPass = 8;
+
+const int kIconSize = 48;
+const int kCellWidth = 96;
+const int kCellHeight = 88;
+const int kIconTop = 6;
+const int kMargin = 12;
+const int kReloadDelayMs = 250;
+
+QFileIconProvider &iconProvider() {
+    static QFileIconProvider provider;
+    return provider;
+}
+
+int bucketCoordinate(int value, int bucketSize) {
+    // Rounds towards negative infinity, so cells left of or above 0 stay distinct
+    return value >= 0 ? value / bucketSize : -((-value - 1) / bucketSize) - 1;
+}
+}
+
+// --- DesktopIconIndex ---
+
+DesktopIconIndex::DesktopIconIndex(int bucketSize)
+    : m_bucketSize(qMax(1, bucketSize)), m_stamp(0) {
+}
+
+void DesktopIconIndex::clear() {
+    m_buckets.clear();
+    m_rects.clear();
+    m_seen.clear();
+    m_stamp = 0;
+}
+
+void DesktopIconIndex::insert(int id, const QRect &rect) {
+    if (id < 0 || rect.isEmpty()) {
+        return;
+    }
+    if (id >= m_rects.size()) {
+        m_rects.resize(id + 1);
+        m_seen.resize(id + 1);
+    }
+    m_rects[id] = rect;
+
+    const int left = bucketCoordinate(rect.left(), m_bucketSize);
+    const int right = bucketCoordinate(rect.right(), m_bucketSize);
+    const int top = bucketCoordinate(rect.top(), m_bucketSize);
+    const int bottom = bucketCoordinate(rect.bottom(), m_bucketSize);
+    for (int row = top; row <= bottom; ++row) {
+        for (int column = left; column <= right; ++column) {
+            m_buckets[bucketKey(column, row)].append(id);
+        }
+    }
+}
+
+int DesktopIconIndex::itemAt(const QPoint &point) const {
+    const auto bucket = m_buckets.constFind(bucketKey(bucketCoordinate(point.x(), m_bucketSize),
+                                                      bucketCoordinate(point.y(), m_bucketSize)));
+    if (bucket == m_buckets.constEnd()) {
+        return -1;
+    }
+
+    // Later items are drawn on top, so they win
+    for (auto it = bucket->crbegin(); it != bucket->crend(); ++it) {
+        if (m_rects.at(*it).contains(point)) {
+            return *it;
+        }
+    }
+    return -1;
+}
+
+QList<int> DesktopIconIndex::query(const QRegion &region) const {
+    QList<int> items;
+    if (++m_stamp == 0) {
+        m_seen.fill(0);
+        m_stamp = 1;
+    }
+
+    for (const QRect &rect : region) {
+        const int left = bucketCoordinate(rect.left(), m_bucketSize);
+        const int right = bucketCoordinate(rect.right(), m_bucketSize);
+        const int top = bucketCoordinate(rect.top(), m_bucketSize);
+        const int bottom = bucketCoordinate(rect.bottom(), m_bucketSize);
+        for (int row = top; row <= bottom; ++row) {
+            for (int column = left; column <= right; ++column) {
+                const auto bucket = m_buckets.constFind(bucketKey(column, row));
+                if (bucket == m_buckets.constEnd()) {
+                    continue;
+                }
+                for (int id : *bucket) {
+                    if (m_seen.at(id) != m_stamp && m_rects.at(id).intersects(rect)) {
+                        m_seen[id] = m_stamp;
+                        items.append(id);
+                    }
+                }
+            }
+        }
+    }
+    return items;
+}
+
+QList<int> DesktopIconIndex::query(const QRect &rect) const {
+    return query(QRegion(rect));
+}
+
+quint64 DesktopIconIndex::bucketKey(int column, int row) const {
+    return (quint64(quint32(column)) << 32) | quint32(row);
+}
+
+// --- DesktopIconCache ---
+
+DesktopIconCache &DesktopIconCache::instance() {
+    // Owned by the application so the pixmaps go before the GUI does
+    static DesktopIconCache *cache = new DesktopIconCache(qApp);
+    return *cache;
+}
+
+DesktopIconCache::DesktopIconCache(QObject *parent)
+    : QObject(parent), m_previews(kPreviewCacheKiB), m_typeIcons(kTypeIconCacheKiB),
+      m_pendingTimer(new QTimer(this)) {
+    m_pendingTimer->setSingleShot(true);
+    m_pendingTimer->setInterval(0);
+    connect(m_pendingTimer, &QTimer::timeout, this, &DesktopIconCache::loadPendingIcons);
+    connect(&ThumbnailCache::instance(), &ThumbnailCache::thumbnailReady, this, &DesktopIconCache::iconLoaded);
+}
+
+QPixmap DesktopIconCache::icon(const QFileInfo &info, int pixelSize) {
+    if (ThumbnailCache::canThumbnail(info)) {
+        const QString key = QString("%1\n%2\n%3").arg(info.absoluteFilePath())
+                                .arg(info.lastModified().toMSecsSinceEpoch()).arg(pixelSize);
+        if (QPixmap *preview = m_previews.object(key)) {
+            return *preview;
+        }
+
+        // Views only ask while painting, so only visible files jump the queue
+        ThumbnailCache &thumbnails = ThumbnailCache::instance();
+        QImage thumbnail = thumbnails.thumbnail(info);
+        if (!thumbnail.isNull()) {
+            if (thumbnail.width() > pixelSize || thumbnail.height() > pixelSize) {
+                thumbnail = thumbnail.scaled(pixelSize, pixelSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+            }
+            QPixmap preview = QPixmap::fromImage(thumbnail);
+            m_previews.insert(key, new QPixmap(preview), qMax(1, int(thumbnail.sizeInBytes() >> 10)));
+            return preview;
+        }
+        thumbnails.request(info, ThumbnailCache::Visible);
+    }
+    return typeIcon(info, pixelSize);
+}
+
+QPixmap DesktopIconCache::typeIcon(const QFileInfo &info, int pixelSize) {
+    // Executables and shortcuts carry their own icon; other files share their type's
+    const QString suffix = info.suffix().toLower();
+    const bool ownIcon = suffix == "exe" || suffix == "lnk" || suffix == "ico";
+    const QString type = info.isDir() ? QString("/") : ownIcon ? info.absoluteFilePath() : suffix;
+    const QString key = QString("%1@%2").arg(type).arg(pixelSize);
+
+    if (QPixmap *cached = m_typeIcons.object(key)) {
+        return *cached;
+    }
+    if (!ownIcon) {
+        return insertIcon(key, iconProvider().icon(info), pixelSize);
+    }
+
+    // Looked up later, outside the paint; the generic icon stands in meanwhile
+    if (!m_pending.contains(key)) {
+        m_pending.insert(key, PendingIcon{info, pixelSize});
+        m_pendingOrder.append(key);
+        m_pendingTimer->start();
+    }
+    const QString genericKey = QString("*@%1").arg(pixelSize);
+    if (QPixmap *generic = m_typeIcons.object(genericKey)) {
+        return *generic;
+    }
+    return insertIcon(genericKey, iconProvider().icon(QAbstractFileIconProvider::File), pixelSize);
+}
+
+QPixmap DesktopIconCache::insertIcon(const QString &key, const QIcon &icon, int pixelSize) {
+    QPixmap pixmap = icon.pixmap(QSize(pixelSize, pixelSize), 1.0);
+    const qint64 bytes = qint64(pixmap.width()) * pixmap.height() * 4;
+    m_typeIcons.insert(key, new QPixmap(pixmap), qMax(1, int(bytes >> 10)));
+    return pixmap;
+}
+
+void DesktopIconCache::loadPendingIcons() {
+    // QFileIconProvider must stay on the GUI thread, so the lookups are
+    // spread over event loop passes instead of moved to a pool
+    for (int done = 0; done < kIconsPerPass && !m_pendingOrder.isEmpty(); ++done) {
+        const QString key = m_pendingOrder.takeFirst();
+        const PendingIcon pending = m_pending.take(key);
+        insertIcon(key, iconProvider().icon(pending.info), pending.pixelSize);
+        emit iconLoaded(pending.info.absoluteFilePath());
+    }
+    if (!m_pendingOrder.isEmpty()) {
+        m_pendingTimer->start();
+    }
+}
+
+// --- DesktopIconView ---
+
+DesktopIconView::DesktopIconView(QWidget *parent)
+    : QWidget(parent), m_watcher(new QFileSystemWatcher(this)), m_reloadTimer(new QTimer(this)),
+      m_scrollBar(new QScrollBar(Qt::Horizontal, this)), m_scrollX(0),
+      m_rubberBand(new QRubberBand(QRubberBand::Rectangle, this)) {
+    m_scrollBar->setSingleStep(kCellWidth);
+    m_scrollBar->hide();
+    connect(m_scrollBar, &QScrollBar::valueChanged, this, &DesktopIconView::onScrolled);
+
+    // Bursts of changes, such as a copy of many files, coalesce into one listing
+    m_reloadTimer->setSingleShot(true);
+    m_reloadTimer->setInterval(kReloadDelayMs);
+    connect(m_reloadTimer, &QTimer::timeout, this, &DesktopIconView::reload);
+    connect(m_watcher, &QFileSystemWatcher::directoryChanged, m_reloadTimer, qOverload<>(&QTimer::start));
+    connect(&m_lister, &QFutureWatcher<QFileInfoList>::finished, this, &DesktopIconView::onListed);
+    connect(&DesktopIconCache::instance(), &DesktopIconCache::iconLoaded, this, &DesktopIconView::onIconLoaded);
+}
+
+void DesktopIconView::setDirectory(const QString &path) {
+    if (path == m_directory) {
+        return;
+    }
+    if (!m_directory.isEmpty()) {
+        m_watcher->removePath(m_directory);
+    }
+    m_directory = path;
+    if (path.isEmpty()) {
+        reload();
+        return;
+    }
+
+    if (!QDir().mkpath(path)) {
+        qDebug() << "Cannot create desktop directory:" << path;
+    }
+    m_watcher->addPath(path);
+    reload();
+}
+
+QString DesktopIconView::directory() const {
+    return m_directory;
+}
+
+void DesktopIconView::reload() {
+    // One listing at a time; a change seen meanwhile lists again afterwards
+    if (m_lister.isRunning()) {
+        m_reloadTimer->start();
+        return;
+    }
+    m_lister.setFuture(QtConcurrent::run(&DesktopIconView::list, m_directory));
+}
+
+QFileInfoList DesktopIconView::list(const QString &path) {
+    TraceSpan span("DesktopIconView::list", "desktop");
+
+    if (path.isEmpty()) {
+        return QFileInfoList();
+    }
+    QFileInfoList entries = QDir(path).entryInfoList(QDir::AllEntries | QDir::NoDotAndDotDot,
+                                                     QDir::DirsFirst | QDir::Name | QDir::IgnoreCase);
+
+    // Stat here, so the GUI thread reads cached attributes while painting
+    for (const QFileInfo &entry : std::as_const(entries)) {
+        entry.isDir();
+        entry.lastModified();
+    }
+    return entries;
+}
+
+void DesktopIconView::onListed() {
+    const QFileInfoList entries = m_lister.result();
+
+    // Keep the selection across re-reads of the same directory
+    QSet<QString> selectedPaths;
+    for (int id : std::as_const(m_selection)) {
+        selectedPaths.insert(m_icons.at(id).info.absoluteFilePath());
+    }
+
+    m_icons.clear();
+    m_iconByPath.clear();
+    m_selection.clear();
+    m_icons.reserve(entries.size());
+    for (const QFileInfo &entry : entries) {
+        DesktopIcon icon;
+        icon.info = entry;
+        icon.selected = selectedPaths.contains(entry.absoluteFilePath());
+        if (icon.selected) {
+            m_selection.append(m_icons.size());
+        }
+        m_iconByPath.insert(entry.absoluteFilePath(), m_icons.size());
+        m_icons.append(icon);
+    }
+
+    elideLabels();
+    relayout();
+    update();
+}
+
+void DesktopIconView::onIconLoaded(const QString &path) {
+    const int id = m_iconByPath.value(path, -1);
+    if (id >= 0) {
+        update(toView(m_icons.at(id).rect));
+    }
+}
+
+void DesktopIconView::onScrolled(int value) {
+    m_scrollX = value;
+    // A band being dragged keeps its anchor in the content
+    if (m_rubberBand->isVisible()) {
+        const QRect band = QRect(m_pressPos, toContent(mapFromGlobal(QCursor::pos()))).normalized();
+        m_rubberBand->setGeometry(toView(band));
+        selectRubberBand(band);
+    }
+    update();
+}
+
+QPoint DesktopIconView::toContent(const QPoint &point) const {
+    return point + QPoint(m_scrollX, 0);
+}
+
+QRect DesktopIconView::toView(const QRect &rect) const {
+    return rect.translated(-m_scrollX, 0);
+}
+
+void DesktopIconView::elideLabels() {
+    const QFontMetrics metrics(font());
+    for (DesktopIcon &icon : m_icons) {
+        icon.label = metrics.elidedText(icon.info.fileName(), Qt::ElideMiddle, kCellWidth - 8);
+    }
+}
+
+void DesktopIconView::relayout() {
+    // Columns fill top to bottom, then left to right. When they run past the
+    // right edge, the scroll bar takes a strip off the bottom.
+    m_index.clear();
+    int rows = qMax(1, (height() - 2 * kMargin) / kCellHeight);
+    int contentWidth = 2 * kMargin + (m_icons.size() + rows - 1) / rows * kCellWidth;
+    const bool scrolls = contentWidth > width();
+    if (scrolls) {
+        const int barHeight = m_scrollBar->sizeHint().height();
+        rows = qMax(1, (height() - barHeight - 2 * kMargin) / kCellHeight);
+        contentWidth = 2 * kMargin + (m_icons.size() + rows - 1) / rows * kCellWidth;
+        m_scrollBar->setGeometry(0, height() - barHeight, width(), barHeight);
+    }
+    m_scrollBar->setRange(0, qMax(0, contentWidth - width()));
+    m_scrollBar->setPageStep(width());
+    m_scrollBar->setVisible(scrolls);
+    m_scrollX = m_scrollBar->value();
+
+    for (int id = 0; id < m_icons.size(); ++id) {
+        DesktopIcon &icon = m_icons[id];
+        icon.rect = QRect(kMargin + (id / rows) * kCellWidth, kMargin + (id % rows) * kCellHeight,
+                          kCellWidth, kCellHeight);
+        m_index.insert(id, icon.rect);
+    }
+}
+
+void DesktopIconView::paintEvent(QPaintEvent *event) {
+    // The desktop below has already repainted the exposed area from its cache
+    QPainter painter(this);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+
+    const QList<int> exposed = m_index.query(event->region().translated(m_scrollX, 0));
+    painter.translate(-m_scrollX, 0);
+    for (int id : exposed) {
+        paintIcon(painter, m_icons.at(id));
+    }
+}
+
+void DesktopIconView::paintIcon(QPainter &painter, const DesktopIcon &icon) {
+    const QRect cell = icon.rect.adjusted(2, 2, -2, -2);
+    if (icon.selected) {
+        painter.setPen(QColor(255, 255, 255, 140));
+        painter.setBrush(QColor(0, 122, 255, 90));
+        painter.drawRoundedRect(cell, 4, 4);
+    }
+
+    const qreal dpr = devicePixelRatioF();
+    const QPixmap pixmap = DesktopIconCache::instance().icon(icon.info, qRound(kIconSize * dpr));
+    if (!pixmap.isNull()) {
+        // Sized in device pixels; drawn through a source rect so the shared pixmap isn't detached
+        const QSizeF size = QSizeF(pixmap.size()) / dpr;
+        const QRectF target(cell.center().x() - size.width() / 2,
+                            cell.top() + kIconTop + (kIconSize - size.height()) / 2,
+                            size.width(), size.height());
+        painter.drawPixmap(target, pixmap, QRectF(pixmap.rect()));
+    }
+
+    const QRect textRect(cell.left(), cell.top() + kIconTop + kIconSize + 4, cell.width(),
+                         painter.fontMetrics().height());
+    painter.setPen(QColor(0, 0, 0, 160));
+    painter.drawText(textRect.translated(1, 1), Qt::AlignHCenter | Qt::AlignTop, icon.label);
+    painter.setPen(Qt::white);
+    painter.drawText(textRect, Qt::AlignHCenter | Qt::AlignTop, icon.label);
+}
+
+void DesktopIconView::resizeEvent(QResizeEvent *event) {
+    relayout();
+    QWidget::resizeEvent(event);
+}
+
+void DesktopIconView::changeEvent(QEvent *event) {
+    if (event->type() == QEvent::FontChange) {
+        elideLabels();
+        update();
+    }
+    QWidget::changeEvent(event);
+}
+
+void DesktopIconView::mousePressEvent(QMouseEvent *event) {
+    if (event->button() != Qt::LeftButton) {
+        QWidget::mousePressEvent(event);
+        return;
+    }
+
+    const int id = m_index.itemAt(toContent(event->pos()));
+    const bool toggle = event->modifiers() & Qt::ControlModifier;
+    if (id < 0) {
+        // Empty space starts a rubber band; Ctrl adds to the current selection
+        if (!toggle) {
+            clearSelection();
+        }
+        m_pressPos = toContent(event->pos());
+        m_selectionBeforeBand = m_selection;
+        m_rubberBand->setGeometry(QRect(event->pos(), QSize()));
+        m_rubberBand->show();
+        return;
+    }
+
+    if (toggle) {
+        setSelected(id, !m_icons.at(id).selected);
+    } else if (!m_icons.at(id).selected) {
+        clearSelection();
+        setSelected(id, true);
+    }
+}
+
+void DesktopIconView::mouseMoveEvent(QMouseEvent *event) {
+    if (!m_rubberBand->isVisible()) {
+        QWidget::mouseMoveEvent(event);
+        return;
+    }
+    const QRect band = QRect(m_pressPos, toContent(event->pos())).normalized();
+    m_rubberBand->setGeometry(toView(band));
+    selectRubberBand(band);
+}
+
+void DesktopIconView::mouseReleaseEvent(QMouseEvent *event) {
+    if (m_rubberBand->isVisible()) {
+        m_rubberBand->hide();
+        m_selectionBeforeBand.clear();
+    }
+    QWidget::mouseReleaseEvent(event);
+}
+
+void DesktopIconView::mouseDoubleClickEvent(QMouseEvent *event) {
+    const int id = event->button() == Qt::LeftButton ? m_index.itemAt(toContent(event->pos())) : -1;
+    if (id < 0) {
+        QWidget::mouseDoubleClickEvent(event);
+        return;
+    }
+
+    const QString path = m_icons.at(id).info.absoluteFilePath();
+    if (!QDesktopServices::openUrl(QUrl::fromLocalFile(path))) {
+        qDebug() << "Cannot open" << path;
+    }
+}
+
+void DesktopIconView::wheelEvent(QWheelEvent *event) {
+    if (!m_scrollBar->isVisible()) {
+        QWidget::wheelEvent(event);
+        return;
+    }
+    // Either wheel direction scrolls the columns; a notch is one column
+    const QPoint delta = event->angleDelta();
+    const int steps = delta.x() != 0 ? delta.x() : delta.y();
+    m_scrollBar->setValue(m_scrollBar->value() - steps * kCellWidth / 120);
+    event->accept();
+}
+
+void DesktopIconView::setSelected(int id, bool selected) {
+    DesktopIcon &icon = m_icons[id];
+    if (icon.selected == selected) {
+        return;
+    }
+    icon.selected = selected;
+    if (selected) {
+        m_selection.append(id);
+    } else {
+        m_selection.removeOne(id);
+    }
+    update(toView(icon.rect));
+}
+
+void DesktopIconView::clearSelection() {
+    for (int id : std::as_const(m_selection)) {
+        m_icons[id].selected = false;
+        update(toView(m_icons.at(id).rect));
+    }
+    m_selection.clear();
+}
+
+void DesktopIconView::selectRubberBand(const QRect &band) {
+    // Work is proportional to the band and the selection, not to the icon count
+    QSet<int> wanted(m_selectionBeforeBand.cbegin(), m_selectionBeforeBand.cend());
+    const QList<int> covered = m_index.query(band);
+    for (int id : covered) {
+        wanted.insert(id);
+    }
+
+    const QList<int> current = m_selection;
+    for (int id : current) {
+        if (!wanted.contains(id)) {
+            setSelected(id, false);
+        }
+    }
+    for (int id : std::as_const(wanted)) {
+        setSelected(id, true);
+    }
+}
@@ -0,0 +1,162 @@
+#ifndef DESKTOP_ICONS_H
+#define DESKTOP_ICONS_H
+
+#include <QWidget>
+#include <QObject>
+#include <QString>
+#include <QList>
+#include <QHash>
+#include <QRect>
+#include <QRegion>
+#include <QPixmap>
+#include <QImage>
+#include <QCache>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QIcon>
+
+class QFileSystemWatcher;
+class QRubberBand;
+class QScrollBar;
+class QTimer;
+
+// Buckets item rectangles into a uniform grid so hit tests and region
+// queries only look at the items in the touched cells, not at all of them.
+// Ids are the caller's item indices; an item spanning cells is in each.
+class DesktopIconIndex {
+public:
+    explicit DesktopIconIndex(int bucketSize = 128);
+
+    void clear();
+    void insert(int id, const QRect &rect);
+
+    // The item under the point, or -1
+    int itemAt(const QPoint &point) const;
+
+    // Every item intersecting the region, each once
+    QList<int> query(const QRegion &region) const;
+    QList<int> query(const QRect &rect) const;
+
+private:
+    quint64 bucketKey(int column, int row) const;
+
+    int m_bucketSize;
+    QHash<quint64, QList<int>> m_buckets;
+    QList<QRect> m_rects;
+
+    // Items already reported by the running query carry its stamp
+    mutable QList<quint32> m_seen;
+    mutable quint32 m_stamp;
+};
+
+// Icons for desktop and file views, shared by all of them. Image files
+// show their ThumbnailCache thumbnail once it exists; everything else, and
+// images still being thumbnailed, get the icon for their file type.
+// Executables and shortcuts, which carry their own icon, show the generic
+// file icon until theirs is looked up: a few per event loop pass rather
+// than one shell lookup per file in the middle of a paint.
+// Pixmaps at each requested pixel size are kept in bounded caches keyed by
+// path and mtime, or by file type.
+class DesktopIconCache : public QObject {
+    Q_OBJECT
+
+public:
+    static DesktopIconCache &instance();
+
+    // The best icon available right now; a better one may follow through iconLoaded()
+    QPixmap icon(const QFileInfo &info, int pixelSize);
+
+signals:
+    void iconLoaded(const QString &path);
+
+private slots:
+    void loadPendingIcons();
+
+private:
+    struct PendingIcon {
+        QFileInfo info;
+        int pixelSize = 0;
+    };
+
+    explicit DesktopIconCache(QObject *parent = nullptr);
+
+    QPixmap typeIcon(const QFileInfo &info, int pixelSize);
+    QPixmap insertIcon(const QString &key, const QIcon &icon, int pixelSize);
+
+    QCache<QString, QPixmap> m_previews;     // cost in KiB
+    QCache<QString, QPixmap> m_typeIcons;    // cost in KiB
+    QHash<QString, PendingIcon> m_pending;   // per-file icons, by cache key
+    QList<QString> m_pendingOrder;
+    QTimer *m_pendingTimer;
+};
+
+struct DesktopIcon {
+    QFileInfo info;
+    QString label;      // elided to the cell width
+    QRect rect;         // cell in content coordinates, before scrolling
+    bool selected = false;
+};
+
+// The icons for one directory, laid out in columns like a desktop. Painting,
+// clicks and rubber-band selection only touch the icons the spatial index
+// returns for the affected area, so they cost the same with ten files or
+// thousands. Columns that do not fit scroll horizontally, by wheel or by the
+// scroll bar along the bottom; the index stays in content coordinates and
+// view positions are offset by the scroll position. The listing is read off
+// the GUI thread and re-read when the directory changes.
+class DesktopIconView : public QWidget {
+    Q_OBJECT
+
+public:
+    explicit DesktopIconView(QWidget *parent = nullptr);
+
+    void setDirectory(const QString &path);
+    QString directory() const;
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void changeEvent(QEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
+    void mouseDoubleClickEvent(QMouseEvent *event) override;
+    void wheelEvent(QWheelEvent *event) override;
+
+private slots:
+    void reload();
+    void onListed();
+    void onIconLoaded(const QString &path);
+    void onScrolled(int value);
+
+private:
+    QPoint toContent(const QPoint &point) const;
+    QRect toView(const QRect &rect) const;
+    void relayout();
+    void elideLabels();
+    void paintIcon(QPainter &painter, const DesktopIcon &icon);
+    void setSelected(int id, bool selected);
+    void clearSelection();
+    void selectRubberBand(const QRect &band);
+
+    static QFileInfoList list(const QString &path);
+
+    QString m_directory;
+    QList<DesktopIcon> m_icons;
+    QHash<QString, int> m_iconByPath;
+    DesktopIconIndex m_index;
+    QList<int> m_selection;
+
+    QFileSystemWatcher *m_watcher;
+    QTimer *m_reloadTimer;
+    QFutureWatcher<QFileInfoList> m_lister;
+
+    QScrollBar *m_scrollBar;
+    int m_scrollX;
+
+    QRubberBand *m_rubberBand;
+    QPoint m_pressPos;          // content coordinates
+    QList<int> m_selectionBeforeBand;
+};
+
+#endif // DESKTOP_ICONS_H
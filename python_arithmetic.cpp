@@ -0,0 +1,810 @@
+#include "python_arithmetic.h"
+#include <QByteArray>
+#include <QList>
+#include <QLocale>
+#include <cmath>
+#include <limits>
+
+namespace {
+constexpr int kMaxDepth = 64;
+constexpr double kPi = 3.141592653589793;
+constexpr double kE = 2.718281828459045;
+constexpr double kTwoTo53 = 9007199254740992.0;
+constexpr double kTwoTo63 = 9223372036854775808.0;
+
+PythonNumber makeInteger(qint64 value) {
+    PythonNumber number;
+    number.integer = value;
+    return number;
+}
+
+PythonNumber makeReal(double value) {
+    PythonNumber number;
+    number.isInteger = false;
+    number.real = value;
+    return number;
+}
+
+double toDouble(const PythonNumber &number) {
+    return number.isInteger ? static_cast<double>(number.integer) : number.real;
+}
+
+// Python's float -> int conversion; fails for inf, nan and anything past 64 bits
+bool realToInteger(double value, qint64 *result) {
+    if (!std::isfinite(value) || value >= kTwoTo63 || value < -kTwoTo63) {
+        return false;
+    }
+    *result = static_cast<qint64>(value);
+    return true;
+}
+
+// Python's math functions raise instead of returning nan or inf for ordinary inputs
+bool checkedReal(double value, std::initializer_list<double> inputs, PythonNumber *result) {
+    bool anyNan = false;
+    bool allFinite = true;
+    for (double input : inputs) {
+        anyNan = anyNan || std::isnan(input);
+        allFinite = allFinite && std::isfinite(input);
+    }
+    if (std::isnan(value) && !anyNan) {
+        return false;
+    }
+    if (std::isinf(value) && allFinite) {
+        return false;
+    }
+    *result = makeReal(value);
+    return true;
+}
+
+// Exact int/float ordering, like Python's comparison: -1, 0, 1, or 2 when unordered
+int compareNumbers(const PythonNumber &a, const PythonNumber &b) {
+    if (a.isInteger && b.isInteger) {
+        return a.integer < b.integer ? -1 : (a.integer > b.integer ? 1 : 0);
+    }
+    if (!a.isInteger && !b.isInteger) {
+        if (std::isnan(a.real) || std::isnan(b.real)) {
+            return 2;
+        }
+        return a.real < b.real ? -1 : (a.real > b.real ? 1 : 0);
+    }
+    const bool flipped = !a.isInteger;
+    const qint64 integer = flipped ? b.integer : a.integer;
+    const double real = flipped ? a.real : b.real;
+    int order;
+    if (std::isnan(real)) {
+        return 2;
+    } else if (real >= kTwoTo63) {
+        order = -1;
+    } else if (real < -kTwoTo63) {
+        order = 1;
+    } else {
+        const double whole = std::floor(real);
+        const qint64 truncated = static_cast<qint64>(whole);
+        if (integer != truncated) {
+            order = integer < truncated ? -1 : 1;
+        } else {
+            order = whole < real ? -1 : 0;
+        }
+    }
+    return flipped ? -order : order;
+}
+
+bool integerPower(qint64 base, qint64 exponent, qint64 *result) {
+    qint64 value = 1;
+    while (exponent > 0) {
+        if (exponent & 1) {
+            if (__builtin_mul_overflow(value, base, &value)) {
+                return false;
+            }
+        }
+        exponent >>= 1;
+        if (exponent > 0 && __builtin_mul_overflow(base, base, &base)) {
+            return false;
+        }
+    }
+    *result = value;
+    return true;
+}
+
+// float.__divmod__ from CPython's floatobject.c
+bool realDivmod(double a, double b, double *div, double *mod) {
+    if (b == 0.0) {
+        return false;
+    }
+    double m = std::fmod(a, b);
+    double d = (a - m) / b;
+    if (m != 0.0) {
+        if ((b < 0) != (m < 0)) {
+            m += b;
+            d -= 1.0;
+        }
+    } else {
+        m = std::copysign(0.0, b);
+    }
+    double floordiv;
+    if (d != 0.0) {
+        floordiv = std::floor(d);
+        if (d - floordiv > 0.5) {
+            floordiv += 1.0;
+        }
+    } else {
+        floordiv = std::copysign(0.0, a / b);
+    }
+    *div = floordiv;
+    *mod = m;
+    return true;
+}
+
+bool power(const PythonNumber &a, const PythonNumber &b, PythonNumber *result) {
+    if (a.isInteger && b.isInteger && b.integer >= 0) {
+        qint64 value;
+        if (!integerPower(a.integer, b.integer, &value)) {
+            return false;
+        }
+        *result = makeInteger(value);
+        return true;
+    }
+    const double x = toDouble(a);
+    const double y = toDouble(b);
+    if (x == 0.0 && y < 0.0) {
+        return false;
+    }
+    // 0 ** -1 raises ZeroDivisionError, (-8) ** (1/3) is complex, and an
+    // overflowing float power raises OverflowError
+    return checkedReal(std::pow(x, y), {x, y}, result);
+}
+
+bool applyBinary(char op, const PythonNumber &a, const PythonNumber &b, PythonNumber *result) {
+    if (a.isInteger && b.isInteger) {
+        const qint64 x = a.integer;
+        const qint64 y = b.integer;
+        qint64 value;
+        switch (op) {
+        case '+':
+            if (__builtin_add_overflow(x, y, &value)) {
+                return false;
+            }
+            *result = makeInteger(value);
+            return true;
+        case '-':
+            if (__builtin_sub_overflow(x, y, &value)) {
+                return false;
+            }
+            *result = makeInteger(value);
+            return true;
+        case '*':
+            if (__builtin_mul_overflow(x, y, &value)) {
+                return false;
+            }
+            *result = makeInteger(value);
+            return true;
+        case '/':
+            // Python divides ints exactly before rounding; only small operands
+            // convert to double without losing that
+            if (y == 0 || std::abs(static_cast<double>(x)) > kTwoTo53
+                || std::abs(static_cast<double>(y)) > kTwoTo53) {
+                return false;
+            }
+            *result = makeReal(static_cast<double>(x) / static_cast<double>(y));
+            return true;
+        case 'f':
+        case '%': {
+            if (y == 0 || (x == std::numeric_limits<qint64>::min() && y == -1)) {
+                return false;
+            }
+            qint64 quotient = x / y;
+            qint64 remainder = x % y;
+            if (remainder != 0 && ((remainder < 0) != (y < 0))) {
+                quotient -= 1;
+                remainder += y;
+            }
+            *result = makeInteger(op == 'f' ? quotient : remainder);
+            return true;
+        }
+        }
+        return false;
+    }
+
+    const double x = toDouble(a);
+    const double y = toDouble(b);
+    switch (op) {
+    case '+':
+        *result = makeReal(x + y);
+        return true;
+    case '-':
+        *result = makeReal(x - y);
+        return true;
+    case '*':
+        *result = makeReal(x * y);
+        return true;
+    case '/':
+        if (y == 0.0) {
+            return false;
+        }
+        *result = makeReal(x / y);
+        return true;
+    case 'f':
+    case '%': {
+        double div;
+        double mod;
+        if (!realDivmod(x, y, &div, &mod)) {
+            return false;
+        }
+        *result = makeReal(op == 'f' ? div : mod);
+        return true;
+    }
+    }
+    return false;
+}
+
+// round(float) from CPython: round half away from zero, then back to even
+bool roundHalfEven(double value, PythonNumber *result) {
+    double rounded = std::round(value);
+    if (std::fabs(value - rounded) == 0.5) {
+        rounded = 2.0 * std::round(value / 2.0);
+    }
+    qint64 integer;
+    if (!realToInteger(rounded, &integer)) {
+        return false;
+    }
+    *result = makeInteger(integer);
+    return true;
+}
+
+bool callBuiltin(const QByteArray &name, const QList<PythonNumber> &args, PythonNumber *result) {
+    const int count = args.size();
+    if (name == "abs" && count == 1) {
+        const PythonNumber &x = args.first();
+        if (x.isInteger) {
+            if (x.integer == std::numeric_limits<qint64>::min()) {
+                return false;
+            }
+            *result = makeInteger(x.integer < 0 ? -x.integer : x.integer);
+        } else {
+            *result = makeReal(std::fabs(x.real));
+        }
+        return true;
+    }
+    if (name == "round") {
+        if (count == 1) {
+            if (args.first().isInteger) {
+                *result = args.first();
+                return true;
+            }
+            return roundHalfEven(args.first().real, result);
+        }
+        // round(float, n) rounds through the decimal string; leave that to Python
+        if (count == 2 && args[0].isInteger && args[1].isInteger && args[1].integer >= 0) {
+            *result = args[0];
+            return true;
+        }
+        return false;
+    }
+    if ((name == "min" || name == "max") && count >= 2) {
+        // Like Python: the first of equal items wins, and nan never replaces it
+        const int wanted = name == "min" ? -1 : 1;
+        PythonNumber best = args.first();
+        for (int i = 1; i < count; ++i) {
+            if (compareNumbers(args[i], best) == wanted) {
+                best = args[i];
+            }
+        }
+        *result = best;
+        return true;
+    }
+    if (name == "pow" && count == 2) {
+        return power(args[0], args[1], result);
+    }
+    if (name == "int" && count == 1) {
+        if (args.first().isInteger) {
+            *result = args.first();
+            return true;
+        }
+        qint64 integer;
+        if (!realToInteger(std::trunc(args.first().real), &integer)) {
+            return false;
+        }
+        *result = makeInteger(integer);
+        return true;
+    }
+    if (name == "float" && count == 1) {
+        *result = makeReal(toDouble(args.first()));
+        return true;
+    }
+    return false;
+}
+
+bool callMath(const QByteArray &name, const QList<PythonNumber> &args, PythonNumber *result) {
+    const int count = args.size();
+    if (count == 1) {
+        const PythonNumber &arg = args.first();
+        const double x = toDouble(arg);
+        if (name == "floor" || name == "ceil" || name == "trunc") {
+            if (arg.isInteger) {
+                *result = arg;
+                return true;
+            }
+            const double whole = name == "floor" ? std::floor(x) : (name == "ceil" ? std::ceil(x) : std::trunc(x));
+            qint64 integer;
+            if (!realToInteger(whole, &integer)) {
+                return false;
+            }
+            *result = makeInteger(integer);
+            return true;
+        }
+        double value;
+        if (name == "sqrt") {
+            value = std::sqrt(x);
+        } else if (name == "exp") {
+            value = std::exp(x);
+        } else if (name == "log") {
+            value = std::log(x);
+        } else if (name == "log2") {
+            value = std::log2(x);
+        } else if (name == "log10") {
+            value = std::log10(x);
+        } else if (name == "sin") {
+            value = std::sin(x);
+        } else if (name == "cos") {
+            value = std::cos(x);
+        } else if (name == "tan") {
+            value = std::tan(x);
+        } else if (name == "asin") {
+            value = std::asin(x);
+        } else if (name == "acos") {
+            value = std::acos(x);
+        } else if (name == "atan") {
+            value = std::atan(x);
+        } else if (name == "sinh") {
+            value = std::sinh(x);
+        } else if (name == "cosh") {
+            value = std::cosh(x);
+        } else if (name == "tanh") {
+            value = std::tanh(x);
+        } else if (name == "fabs") {
+            value = std::fabs(x);
+        } else if (name == "degrees") {
+            value = x * (180.0 / kPi);
+        } else if (name == "radians") {
+            value = x * (kPi / 180.0);
+        } else {
+            return false;
+        }
+        return checkedReal(value, {x}, result);
+    }
+    if (count == 2) {
+        const double x = toDouble(args[0]);
+        const double y = toDouble(args[1]);
+        if (name == "log") {
+            PythonNumber numerator;
+            PythonNumber denominator;
+            if (!checkedReal(std::log(x), {x}, &numerator) || !checkedReal(std::log(y), {y}, &denominator)
+                || denominator.real == 0.0) {
+                return false;
+            }
+            *result = makeReal(numerator.real / denominator.real);
+            return true;
+        }
+        if (name == "pow") {
+            return checkedReal(std::pow(x, y), {x, y}, result);
+        }
+        if (name == "atan2") {
+            return checkedReal(std::atan2(x, y), {x, y}, result);
+        }
+        if (name == "fmod") {
+            return checkedReal(std::fmod(x, y), {x, y}, result);
+        }
+        if (name == "copysign") {
+            *result = makeReal(std::copysign(x, y));
+            return true;
+        }
+    }
+    return false;
+}
+
+bool mathConstant(const QByteArray &name, PythonNumber *result) {
+    if (name == "pi") {
+        *result = makeReal(kPi);
+    } else if (name == "e") {
+        *result = makeReal(kE);
+    } else if (name == "tau") {
+        *result = makeReal(2 * kPi);
+    } else if (name == "inf") {
+        *result = makeReal(std::numeric_limits<double>::infinity());
+    } else if (name == "nan") {
+        *result = makeReal(std::numeric_limits<double>::quiet_NaN());
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+bool isNameChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || isDigit(c);
+}
+
+// Recursive descent over Python's grammar for the subset it accepts:
+//   sum    := term (('+' | '-') term)*
+//   term   := factor (('*' | '/' | '//' | '%') factor)*
+//   factor := ('+' | '-') factor | power
+//   power  := atom ['**' factor]
+class ArithmeticParser {
+public:
+    ArithmeticParser(const QByteArray &text, bool allowCalls)
+        : m_text(text), m_allowCalls(allowCalls) {}
+
+    bool parse(PythonNumber *result) {
+        // Python compiles " 1+2" to an IndentationError; leave that to it
+        if (peek() == ' ' || peek() == '\t' || !parseSum(result)) {
+            return false;
+        }
+        skipSpaces();
+        return m_pos == m_text.size();
+    }
+
+private:
+    char peek(int offset = 0) const {
+        const int index = m_pos + offset;
+        return index < m_text.size() ? m_text.at(index) : '\0';
+    }
+
+    void skipSpaces() {
+        while (peek() == ' ' || peek() == '\t') {
+            ++m_pos;
+        }
+    }
+
+    bool parseSum(PythonNumber *result) {
+        if (!parseTerm(result)) {
+            return false;
+        }
+        for (;;) {
+            skipSpaces();
+            const char op = peek();
+            if (op != '+' && op != '-') {
+                return true;
+            }
+            ++m_pos;
+            PythonNumber rhs;
+            if (!parseTerm(&rhs) || !applyBinary(op, *result, rhs, result)) {
+                return false;
+            }
+        }
+    }
+
+    bool parseTerm(PythonNumber *result) {
+        if (!parseFactor(result)) {
+            return false;
+        }
+        for (;;) {
+            skipSpaces();
+            char op = peek();
+            if (op == '/' && peek(1) == '/') {
+                op = 'f';
+                m_pos += 2;
+            } else if ((op == '*' && peek(1) != '*') || op == '/' || op == '%') {
+                ++m_pos;
+            } else {
+                return true;
+            }
+            PythonNumber rhs;
+            if (!parseFactor(&rhs) || !applyBinary(op, *result, rhs, result)) {
+                return false;
+            }
+        }
+    }
+
+    bool parseFactor(PythonNumber *result) {
+        if (++m_depth > kMaxDepth) {
+            return false;
+        }
+        skipSpaces();
+        const char op = peek();
+        bool ok;
+        if (op == '+' || op == '-') {
+            ++m_pos;
+            ok = parseFactor(result);
+            if (ok && op == '-') {
+                if (result->isInteger) {
+                    ok = result->integer != std::numeric_limits<qint64>::min();
+                    result->integer = -result->integer;
+                } else {
+                    result->real = -result->real;
+                }
+            }
+        } else {
+            ok = parsePower(result);
+        }
+        --m_depth;
+        return ok;
+    }
+
+    bool parsePower(PythonNumber *result) {
+        if (!parseAtom(result)) {
+            return false;
+        }
+        skipSpaces();
+        if (peek() != '*' || peek(1) != '*') {
+            return true;
+        }
+        m_pos += 2;
+        PythonNumber exponent;
+        return parseFactor(&exponent) && power(*result, exponent, result);
+    }
+
+    bool parseAtom(PythonNumber *result) {
+        skipSpaces();
+        const char c = peek();
+        if (c == '(') {
+            ++m_pos;
+            if (++m_depth > kMaxDepth || !parseSum(result)) {
+                return false;
+            }
+            --m_depth;
+            skipSpaces();
+            if (peek() != ')') {
+                return false;
+            }
+            ++m_pos;
+            return true;
+        }
+        if (isDigit(c) || (c == '.' && isDigit(peek(1)))) {
+            return parseNumber(result);
+        }
+        if (m_allowCalls && isNameChar(c)) {
+            return parseName(result);
+        }
+        return false;
+    }
+
+    // Python's numeric literal rules: underscores only between digits, no
+    // leading zeros on decimal ints, and no suffix glued to the literal
+    bool parseNumber(PythonNumber *result) {
+        if (peek() == '0' && (peek(1) == 'x' || peek(1) == 'X' || peek(1) == 'o' || peek(1) == 'O'
+                              || peek(1) == 'b' || peek(1) == 'B')) {
+            return parseRadixInteger(result);
+        }
+
+        QByteArray digits;
+        bool isReal = false;
+        if (isDigit(peek()) && !takeDigits(&digits)) {
+            return false;
+        }
+        if (peek() == '.') {
+            isReal = true;
+            digits.append('.');
+            ++m_pos;
+            if (isDigit(peek()) && !takeDigits(&digits)) {
+                return false;
+            }
+        }
+        if (peek() == 'e' || peek() == 'E') {
+            isReal = true;
+            digits.append('e');
+            ++m_pos;
+            if (peek() == '+' || peek() == '-') {
+                digits.append(peek());
+                ++m_pos;
+            }
+            if (!takeDigits(&digits)) {
+                return false;
+            }
+        }
+        // 1j, 1if, 1.real and 1__0 all belong to Python
+        if (isNameChar(peek()) || peek() == '.') {
+            return false;
+        }
+
+        bool ok = false;
+        if (isReal) {
+            const double value = digits.toDouble(&ok);
+            *result = makeReal(value);
+            return ok;
+        }
+        if (digits.size() > 1 && digits.at(0) == '0' && digits.count('0') != digits.size()) {
+            return false;
+        }
+        *result = makeInteger(digits.toLongLong(&ok));
+        return ok;
+    }
+
+    bool parseRadixInteger(PythonNumber *result) {
+        const char prefix = peek(1) | 0x20;
+        const int base = prefix == 'x' ? 16 : (prefix == 'o' ? 8 : 2);
+        m_pos += 2;
+        QByteArray digits;
+        bool needDigit = true;
+        for (;;) {
+            const char c = peek();
+            if (c == '_' && !needDigit) {
+                needDigit = true;
+                ++m_pos;
+                continue;
+            }
+            const int value = isDigit(c) ? c - '0'
+                : ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') ? (c | 0x20) - 'a' + 10 : -1;
+            if (value < 0 || value >= base) {
+                break;
+            }
+            digits.append(c);
+            needDigit = false;
+            ++m_pos;
+        }
+        // 0x_1 is fine in Python, so an underscore right after the prefix is allowed
+        if (digits.isEmpty() || needDigit || isNameChar(peek()) || peek() == '.') {
+            return false;
+        }
+        bool ok = false;
+        const qulonglong value = digits.toULongLong(&ok, base);
+        if (!ok || value > static_cast<qulonglong>(std::numeric_limits<qint64>::max())) {
+            return false;
+        }
+        *result = makeInteger(static_cast<qint64>(value));
+        return true;
+    }
+
+    bool takeDigits(QByteArray *digits) {
+        if (!isDigit(peek())) {
+            return false;
+        }
+        while (isDigit(peek())) {
+            digits->append(peek());
+            ++m_pos;
+            if (peek() == '_') {
+                ++m_pos;
+                if (!isDigit(peek())) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    QByteArray takeName() {
+        const int start = m_pos;
+        while (isNameChar(peek())) {
+            ++m_pos;
+        }
+        return m_text.mid(start, m_pos - start);
+    }
+
+    bool parseName(PythonNumber *result) {
+        const QByteArray name = takeName();
+        skipSpaces();
+        if (name == "math" && peek() == '.') {
+            ++m_pos;
+            skipSpaces();
+            const QByteArray attribute = takeName();
+            skipSpaces();
+            if (peek() != '(') {
+                return mathConstant(attribute, result);
+            }
+            QList<PythonNumber> args;
+            return parseArguments(&args) && callMath(attribute, args, result);
+        }
+        if (peek() != '(') {
+            return false;
+        }
+        QList<PythonNumber> args;
+        return parseArguments(&args) && callBuiltin(name, args, result);
+    }
+
+    bool parseArguments(QList<PythonNumber> *args) {
+        ++m_pos;
+        if (++m_depth > kMaxDepth) {
+            return false;
+        }
+        skipSpaces();
+        if (peek() == ')') {
+            ++m_pos;
+            --m_depth;
+            return true;
+        }
+        for (;;) {
+            PythonNumber arg;
+            if (!parseSum(&arg)) {
+                return false;
+            }
+            args->append(arg);
+            skipSpaces();
+            if (peek() == ')') {
+                ++m_pos;
+                --m_depth;
+                return true;
+            }
+            if (peek() != ',') {
+                return false;
+            }
+            ++m_pos;
+        }
+    }
+
+    const QByteArray m_text;
+    const bool m_allowCalls;
+    int m_pos = 0;
+    int m_depth = 0;
+};
+}
+
+bool evaluateArithmetic(const QString &expression, bool allowCalls, PythonNumber *result) {
+    // Strings, comparisons, names and anything non-ASCII go straight to Python
+    for (const QChar c : expression) {
+        const ushort code = c.unicode();
+        if (code >= 0x80 || code == '\n' || code == '\r' || code == '\'' || code == '"'
+            || code == '=' || code == '<' || code == '>') {
+            return false;
+        }
+    }
+    if (expression.trimmed().isEmpty()) {
+        return false;
+    }
+    ArithmeticParser parser(expression.toLatin1(), allowCalls);
+    return parser.parse(result);
+}
+
+const QList<QByteArray> &arithmeticBuiltinNames() {
+    static const QList<QByteArray> names = {"abs", "round", "min", "max", "pow", "int", "float"};
+    return names;
+}
+
+const QList<QByteArray> &arithmeticMathNames() {
+    static const QList<QByteArray> names = {
+        "floor", "ceil", "trunc", "sqrt", "exp", "log", "log2", "log10", "sin", "cos", "tan",
+        "asin", "acos", "atan", "sinh", "cosh", "tanh", "fabs", "degrees", "radians",
+        "pow", "atan2", "fmod", "copysign", "pi", "e", "tau", "inf", "nan"};
+    return names;
+}
+
+QString pythonNumberToString(const PythonNumber &number) {
+    if (number.isInteger) {
+        return QString::number(number.integer);
+    }
+
+    const double value = number.real;
+    if (std::isnan(value)) {
+        return QStringLiteral("nan");
+    }
+    if (std::isinf(value)) {
+        return value < 0 ? QStringLiteral("-inf") : QStringLiteral("inf");
+    }
+
+    // Shortest round-trip digits, laid out the way float.__repr__ does:
+    // positional for exponents -4..15, scientific with a 2-digit exponent otherwise
+    const QString scientific = QString::number(value, 'e', QLocale::FloatingPointShortest);
+    const int ePos = scientific.indexOf('e');
+    QString mantissa = scientific.left(ePos);
+    const int exponent = scientific.mid(ePos + 1).toInt();
+    const bool negative = mantissa.startsWith('-');
+    if (negative) {
+        mantissa.remove(0, 1);
+    }
+    QString digits = mantissa;
+    digits.remove('.');
+
+    QString text;
+    if (exponent < -4 || exponent >= 16) {
+        text = digits.left(1);
+        if (digits.size() > 1) {
+            text += '.' + digits.mid(1);
+        }
+        text += QString("e%1%2").arg(exponent < 0 ? '-' : '+').arg(std::abs(exponent), 2, 10, QChar('0'));
+    } else if (exponent < 0) {
+        text = "0." + QString(-exponent - 1, '0') + digits;
+    } else if (digits.size() <= exponent + 1) {
+        text = digits + QString(exponent + 1 - digits.size(), '0') + ".0";
+    } else {
+        text = digits.left(exponent + 1) + '.' + digits.mid(exponent + 1);
+    }
+    return negative ? '-' + text : text;
+}
+
+QVariant pythonNumberToVariant(const PythonNumber &number) {
+    if (number.isInteger) {
+        return QVariant(static_cast<qlonglong>(number.integer));
+    }
+    return QVariant(number.real);
+}
@@ -0,0 +1,36 @@
+#ifndef PYTHON_ARITHMETIC_H
+#define PYTHON_ARITHMETIC_H
+
+#include <QString>
+#include <QByteArray>
+#include <QList>
+#include <QVariant>
+
+// An int or float result, as Python would have produced it
+struct PythonNumber {
+    bool isInteger = true;
+    qint64 integer = 0;
+    double real = 0;
+};
+
+// Evaluates plain arithmetic without entering Python: int and float literals,
+// + - * / // % **, unary +/-, parentheses, and with allowCalls the builtins
+// abs, round, min, max, pow, int, float plus math.<function> and math.pi/e/tau.
+// Follows Python's int/float semantics. Returns false for anything it does
+// not handle, including every case where Python would raise (division by
+// zero, domain errors, overflow past 64-bit ints, leading indentation); the
+// caller then runs the expression through Python to get the same result or
+// error as before.
+bool evaluateArithmetic(const QString &expression, bool allowCalls, PythonNumber *result);
+
+// The builtins and math attributes allowCalls stands in for. Once a script
+// rebinds any of them, the caller has to stop allowing calls.
+const QList<QByteArray> &arithmeticBuiltinNames();
+const QList<QByteArray> &arithmeticMathNames();
+
+// str() of the number, e.g. "13.5", "1e-05", "27"
+QString pythonNumberToString(const PythonNumber &number);
+// Same QVariant types as pythonToVariant()
+QVariant pythonNumberToVariant(const PythonNumber &number);
+
+#endif // PYTHON_ARITHMETIC_H
@@ -0,0 +1,418 @@
+#include "python_bridge.h"
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QDebug>
+#include <memory>
+#include <vector>
+
+// Undefine slots before including Python headers to avoid conflicts
+#ifdef slots
+#undef slots
+#endif
+
+// Include Python headers
+#include <Python.h>
+
+// Redefine slots for Qt after Python headers
+#ifndef slots
+#define slots Q_SLOTS
+#endif
+
+namespace {
+// Memory exported to Python. Whatever owns the bytes (an implicitly shared
+// QByteArray or QImage, or a mapped file) lives here, so views outlive unshare().
+struct BufferHolder {
+    QByteArray bytes;
+    QImage image;
+    std::unique_ptr<QFile> file;
+
+    char *data = nullptr;
+    Py_ssize_t size = 0;
+    bool readOnly = true;
+    bool contiguous = true;
+    QByteArray format = "B";
+    Py_ssize_t itemSize = 1;
+    std::vector<Py_ssize_t> shape;
+    std::vector<Py_ssize_t> strides;
+};
+
+using HolderPointer = std::shared_ptr<BufferHolder>;
+
+struct Registry {
+    QMutex mutex;
+    QHash<QString, HolderPointer> shared;
+    QHash<QString, HolderPointer> results;
+};
+
+Registry &registry() {
+    static Registry instance;
+    return instance;
+}
+
+char g_emptyBuffer[1] = {0};
+
+void setFlatLayout(BufferHolder *holder) {
+    holder->shape = {holder->size / holder->itemSize};
+    holder->strides = {holder->itemSize};
+}
+
+// --- zoraperl.Buffer: exports a BufferHolder through the buffer protocol ---
+
+struct BufferObject {
+    PyObject_HEAD
+    HolderPointer *holder;
+};
+
+PyObject *g_bufferType = nullptr;
+
+void bufferDealloc(PyObject *self) {
+    PyTypeObject *type = Py_TYPE(self);
+    delete reinterpret_cast<BufferObject *>(self)->holder;
+    type->tp_free(self);
+    Py_DECREF(type);
+}
+
+int bufferGetBuffer(PyObject *self, Py_buffer *view, int flags) {
+    const BufferHolder &holder = **reinterpret_cast<BufferObject *>(self)->holder;
+
+    if ((flags & PyBUF_WRITABLE) == PyBUF_WRITABLE && holder.readOnly) {
+        PyErr_SetString(PyExc_BufferError, "zoraperl buffer is read-only");
+        view->obj = nullptr;
+        return -1;
+    }
+    if ((flags & PyBUF_STRIDES) != PyBUF_STRIDES && !holder.contiguous) {
+        PyErr_SetString(PyExc_BufferError, "zoraperl buffer has padded rows; request strides");
+        view->obj = nullptr;
+        return -1;
+    }
+
+    Py_INCREF(self);
+    view->obj = self;
+    view->buf = holder.data;
+    view->len = holder.size;
+    view->readonly = holder.readOnly;
+    view->itemsize = holder.itemSize;
+    view->format = (flags & PyBUF_FORMAT) ? const_cast<char *>(holder.format.constData()) : nullptr;
+    if ((flags & PyBUF_ND) == PyBUF_ND) {
+        view->ndim = static_cast<int>(holder.shape.size());
+        view->shape = const_cast<Py_ssize_t *>(holder.shape.data());
+    } else {
+        view->ndim = 1;
+        view->shape = nullptr;
+    }
+    view->strides = ((flags & PyBUF_STRIDES) == PyBUF_STRIDES) ? const_cast<Py_ssize_t *>(holder.strides.data()) : nullptr;
+    view->suboffsets = nullptr;
+    view->internal = nullptr;
+    return 0;
+}
+
+PyType_Slot kBufferSlots[] = {
+    {Py_tp_dealloc, reinterpret_cast<void *>(bufferDealloc)},
+    {Py_tp_doc, const_cast<char *>("Memory shared by the ZoraPerl desktop.")},
+    {Py_bf_getbuffer, reinterpret_cast<void *>(bufferGetBuffer)},
+    {0, nullptr}
+};
+
+PyType_Spec kBufferSpec = {
+    "zoraperl.Buffer",
+    sizeof(BufferObject),
+    0,
+    Py_TPFLAGS_DEFAULT,
+    kBufferSlots
+};
+
+// Returns a memoryview over the holder, or nullptr with an exception set
+PyObject *memoryViewOf(const HolderPointer &holder) {
+    PyObject *object = PyType_GenericAlloc(reinterpret_cast<PyTypeObject *>(g_bufferType), 0);
+    if (!object) {
+        return nullptr;
+    }
+    reinterpret_cast<BufferObject *>(object)->holder = new HolderPointer(holder);
+
+    PyObject *view = PyMemoryView_FromObject(object);
+    Py_DECREF(object);
+    return view;
+}
+
+// --- module functions ---
+
+PyObject *zoraperlBuffer(PyObject *, PyObject *args) {
+    const char *name = nullptr;
+    if (!PyArg_ParseTuple(args, "s:buffer", &name)) {
+        return nullptr;
+    }
+
+    HolderPointer holder;
+    {
+        Registry &r = registry();
+        QMutexLocker locker(&r.mutex);
+        holder = r.shared.value(QString::fromUtf8(name));
+    }
+    if (!holder) {
+        PyErr_Format(PyExc_KeyError, "no shared buffer named '%s'", name);
+        return nullptr;
+    }
+    return memoryViewOf(holder);
+}
+
+PyObject *zoraperlNames(PyObject *, PyObject *) {
+    QStringList names = PythonBridge::sharedNames();
+    PyObject *list = PyList_New(0);
+    for (const QString &name : std::as_const(names)) {
+        PyObject *item = list ? PyUnicode_FromString(name.toUtf8().constData()) : nullptr;
+        if (!item || PyList_Append(list, item) != 0) {
+            Py_XDECREF(item);
+            Py_XDECREF(list);
+            return nullptr;
+        }
+        Py_DECREF(item);
+    }
+    return list;
+}
+
+PyObject *zoraperlCreateResult(PyObject *, PyObject *args) {
+    const char *name = nullptr;
+    Py_ssize_t size = 0;
+    const char *format = "B";
+    if (!PyArg_ParseTuple(args, "sn|s:create_result", &name, &size, &format)) {
+        return nullptr;
+    }
+
+    Py_ssize_t itemSize = PyBuffer_SizeFromFormat(format);
+    if (itemSize <= 0) {
+        return nullptr;
+    }
+    if (size < 0 || size % itemSize != 0) {
+        PyErr_SetString(PyExc_ValueError, "size must be a non-negative multiple of the item size");
+        return nullptr;
+    }
+
+    auto holder = std::make_shared<BufferHolder>();
+    holder->bytes = QByteArray(size, Qt::Uninitialized);
+    holder->data = size > 0 ? holder->bytes.data() : g_emptyBuffer;
+    holder->size = size;
+    holder->readOnly = false;
+    holder->format = format;
+    holder->itemSize = itemSize;
+    setFlatLayout(holder.get());
+
+    {
+        Registry &r = registry();
+        QMutexLocker locker(&r.mutex);
+        r.results.insert(QString::fromUtf8(name), holder);
+    }
+    return memoryViewOf(holder);
+}
+
+PyObject *zoraperlSetResult(PyObject *, PyObject *args) {
+    const char *name = nullptr;
+    PyObject *object = nullptr;
+    if (!PyArg_ParseTuple(args, "sO:set_result", &name, &object)) {
+        return nullptr;
+    }
+
+    Py_buffer view;
+    if (PyObject_GetBuffer(object, &view, PyBUF_FULL_RO) != 0) {
+        return nullptr;
+    }
+
+    auto holder = std::make_shared<BufferHolder>();
+    holder->bytes = QByteArray(view.len, Qt::Uninitialized);
+    if (view.len > 0 && PyBuffer_ToContiguous(holder->bytes.data(), &view, view.len, 'C') != 0) {
+        PyBuffer_Release(&view);
+        return nullptr;
+    }
+    holder->data = view.len > 0 ? holder->bytes.data() : g_emptyBuffer;
+    holder->size = view.len;
+    holder->format = view.format ? view.format : "B";
+    holder->itemSize = view.itemsize;
+    if (view.ndim > 0 && view.shape) {
+        holder->shape.assign(view.shape, view.shape + view.ndim);
+    } else {
+        setFlatLayout(holder.get());
+    }
+    PyBuffer_Release(&view);
+
+    {
+        Registry &r = registry();
+        QMutexLocker locker(&r.mutex);
+        r.results.insert(QString::fromUtf8(name), holder);
+    }
+    Py_RETURN_NONE;
+}
+
+PyMethodDef kModuleMethods[] = {
+    {"buffer", zoraperlBuffer, METH_VARARGS, "buffer(name) -> read-only memoryview of data shared by the desktop."},
+    {"names", zoraperlNames, METH_NOARGS, "names() -> names of the shared buffers."},
+    {"create_result", zoraperlCreateResult, METH_VARARGS,
+     "create_result(name, nbytes, format='B') -> writable memoryview the desktop reads back without copying."},
+    {"set_result", zoraperlSetResult, METH_VARARGS, "set_result(name, obj) -> hand any buffer object back to the desktop."},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+PyModuleDef kModuleDef = {
+    PyModuleDef_HEAD_INIT,
+    "zoraperl",
+    "Zero-copy data exchange with the ZoraPerl desktop.",
+    -1,
+    kModuleMethods,
+    nullptr, nullptr, nullptr, nullptr
+};
+
+PyObject *initZoraperlModule() {
+    PyObject *module = PyModule_Create(&kModuleDef);
+    if (!module) {
+        return nullptr;
+    }
+
+#ifdef Py_GIL_DISABLED
+    // The registry has its own lock; don't make free-threaded builds re-enable the GIL
+    PyUnstable_Module_SetGIL(module, Py_MOD_GIL_NOT_USED);
+#endif
+
+    if (!g_bufferType) {
+        g_bufferType = PyType_FromSpec(&kBufferSpec);
+        if (!g_bufferType) {
+            Py_DECREF(module);
+            return nullptr;
+        }
+    }
+
+    Py_INCREF(g_bufferType);
+    if (PyModule_AddObject(module, "Buffer", g_bufferType) != 0) {
+        Py_DECREF(g_bufferType);
+        Py_DECREF(module);
+        return nullptr;
+    }
+    return module;
+}
+
+void share(const QString &name, const HolderPointer &holder) {
+    Registry &r = registry();
+    QMutexLocker locker(&r.mutex);
+    r.shared.insert(name, holder);
+}
+}
+
+bool PythonBridge::registerModule() {
+    if (Py_IsInitialized()) {
+        qDebug() << "zoraperl module must be registered before Python is initialized";
+        return false;
+    }
+    return PyImport_AppendInittab("zoraperl", &initZoraperlModule) == 0;
+}
+
+void PythonBridge::shareBytes(const QString &name, const QByteArray &data) {
+    auto holder = std::make_shared<BufferHolder>();
+    holder->bytes = data;
+    holder->data = data.isEmpty() ? g_emptyBuffer : const_cast<char *>(holder->bytes.constData());
+    holder->size = data.size();
+    setFlatLayout(holder.get());
+    share(name, holder);
+}
+
+void PythonBridge::shareImage(const QString &name, const QImage &image) {
+    auto holder = std::make_shared<BufferHolder>();
+    holder->image = image;
+
+    // constBits() never detaches, so this is the caller's pixel memory
+    const uchar *bits = holder->image.constBits();
+    holder->data = bits ? const_cast<char *>(reinterpret_cast<const char *>(bits)) : g_emptyBuffer;
+    holder->size = bits ? holder->image.sizeInBytes() : 0;
+
+    Py_ssize_t height = holder->image.height();
+    Py_ssize_t width = holder->image.width();
+    Py_ssize_t bytesPerLine = holder->image.bytesPerLine();
+    int depth = holder->image.depth();
+
+    if (bits && depth >= 8 && depth % 8 == 0) {
+        // (rows, columns, channel bytes); rows may be padded
+        Py_ssize_t pixelBytes = depth / 8;
+        holder->shape = {height, width, pixelBytes};
+        holder->strides = {bytesPerLine, pixelBytes, 1};
+        holder->contiguous = (bytesPerLine == width * pixelBytes);
+        // len is the size of the logical array, without the row padding
+        holder->size = height * width * pixelBytes;
+    } else {
+        holder->shape = {height, bytesPerLine};
+        holder->strides = {bytesPerLine, 1};
+    }
+
+    share(name, holder);
+}
+
+bool PythonBridge::shareFile(const QString &name, const QString &path) {
+    auto holder = std::make_shared<BufferHolder>();
+    holder->file = std::make_unique<QFile>(path);
+    if (!holder->file->open(QIODevice::ReadOnly)) {
+        qDebug() << "Cannot open file to share with Python:" << path;
+        return false;
+    }
+
+    qint64 size = holder->file->size();
+    if (size > 0) {
+        uchar *mapped = holder->file->map(0, size);
+        if (!mapped) {
+            qDebug() << "Cannot map file to share with Python:" << path;
+            return false;
+        }
+        holder->data = reinterpret_cast<char *>(mapped);
+    } else {
+        holder->data = g_emptyBuffer;
+    }
+    holder->size = size;
+    setFlatLayout(holder.get());
+
+    share(name, holder);
+    return true;
+}
+
+void PythonBridge::unshare(const QString &name) {
+    Registry &r = registry();
+    QMutexLocker locker(&r.mutex);
+    r.shared.remove(name);
+}
+
+QStringList PythonBridge::sharedNames() {
+    Registry &r = registry();
+    QMutexLocker locker(&r.mutex);
+    return r.shared.keys();
+}
+
+bool PythonBridge::hasResult(const QString &name) {
+    Registry &r = registry();
+    QMutexLocker locker(&r.mutex);
+    return r.results.contains(name);
+}
+
+PythonBuffer PythonBridge::takeResult(const QString &name) {
+    HolderPointer holder;
+    {
+        Registry &r = registry();
+        QMutexLocker locker(&r.mutex);
+        holder = r.results.take(name);
+    }
+
+    PythonBuffer result;
+    if (!holder) {
+        return result;
+    }
+
+    // Shares the bytes with any view the script still holds; take results
+    // after the script finished writing
+    result.data = holder->bytes;
+    result.format = holder->format;
+    result.itemSize = holder->itemSize;
+    for (Py_ssize_t extent : holder->shape) {
+        result.shape.append(extent);
+    }
+    return result;
+}
+
+void PythonBridge::clearResults() {
+    Registry &r = registry();
+    QMutexLocker locker(&r.mutex);
+    r.results.clear();
+}
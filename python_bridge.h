@@ -0,0 +1,46 @@
+#ifndef PYTHON_BRIDGE_H
+#define PYTHON_BRIDGE_H
+
+#include <QByteArray>
+#include <QImage>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+// A result handed back by a script, with the layout Python described it with
+struct PythonBuffer {
+    QByteArray data;
+    QByteArray format;      // struct module syntax, "B" for plain bytes
+    qsizetype itemSize = 1;
+    QList<qsizetype> shape;
+
+    bool isValid() const { return !shape.isEmpty(); }
+};
+
+// The built-in zoraperl module. C++ shares data under a name, and scripts see
+// it as a read-only memoryview over the same memory:
+//
+//   import zoraperl
+//   pixels = zoraperl.buffer("wallpaper")        # shape (height, width, 4)
+//   out = zoraperl.create_result("mask", 1024)   # writable, lives in C++
+//   zoraperl.set_result("stats", array)          # any buffer, copied once
+//
+// All functions are thread-safe and never need the GIL.
+class PythonBridge {
+public:
+    // Must run before the interpreter is initialized
+    static bool registerModule();
+
+    // Views stay valid in Python even after unshare(); they keep the data alive
+    static void shareBytes(const QString &name, const QByteArray &data);
+    static void shareImage(const QString &name, const QImage &image);
+    static bool shareFile(const QString &name, const QString &path);
+    static void unshare(const QString &name);
+    static QStringList sharedNames();
+
+    static bool hasResult(const QString &name);
+    static PythonBuffer takeResult(const QString &name);
+    static void clearResults();
+};
+
+#endif // PYTHON_BRIDGE_H
@@ -0,0 +1,280 @@
+#include "python_code_cache.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QMutexLocker>
+#include <QDebug>
+#include <cstring>
+
+// Undefine slots before including Python headers to avoid conflicts
+#ifdef slots
+#undef slots
+#endif
+
+// Include Python headers
+#include <Python.h>
+#include <marshal.h>
+
+// Redefine slots for Qt after Python headers
+#ifndef slots
+#define slots Q_SLOTS
+#endif
+
+PythonCodeCache::PythonCodeCache(int capacity)
+    : m_capacity(capacity), m_diskBytes(0), m_diskCapacityBytes(16LL * 1024 * 1024),
+      m_hits(0), m_diskHits(0), m_misses(0), m_evictions(0) {
+    bool ok = false;
+    qint64 capacityMb = qEnvironmentVariable("ZORAPERL_PYCODE_CACHE_MB").toLongLong(&ok);
+    if (ok && capacityMb > 0) {
+        m_diskCapacityBytes = capacityMb * 1024 * 1024;
+    }
+}
+
+PyObject *PythonCodeCache::compile(const QString &source, int mode, const char *filename) {
+    QByteArray utf8 = source.toUtf8();
+    QByteArray key = cacheKey(utf8, mode, filename);
+
+    if (PyObject *code = lookup(key)) {
+        ++m_hits;
+        return code;
+    }
+
+    bool persist = persists(filename);
+    if (PyObject *code = persist ? loadFromDisk(key) : nullptr) {
+        ++m_diskHits;
+        insert(key, code);
+        return code;
+    }
+
+    ++m_misses;
+    PyObject *code = Py_CompileString(utf8.constData(), filename, mode);
+    if (!code) {
+        return nullptr;
+    }
+
+    if (persist) {
+        storeToDisk(key, code);
+    }
+    insert(key, code);
+    return code;
+}
+
+void PythonCodeCache::clear() {
+    QMutexLocker locker(&m_mutex);
+    for (const Entry &entry : std::as_const(m_entries)) {
+        Py_DECREF(entry.code);
+    }
+    m_entries.clear();
+    m_lru.clear();
+}
+
+void PythonCodeCache::setCapacity(int capacity) {
+    QMutexLocker locker(&m_mutex);
+    m_capacity = qMax(0, capacity);
+    evictToCapacity();
+}
+
+void PythonCodeCache::setDiskCacheDirectory(const QString &path) {
+    QMutexLocker locker(&m_mutex);
+    m_diskCacheDirectory = path;
+    m_diskBytes = 0;
+    if (path.isEmpty()) {
+        return;
+    }
+    if (!QDir().mkpath(path)) {
+        qDebug() << "Cannot create Python code cache directory:" << path;
+        m_diskCacheDirectory.clear();
+        return;
+    }
+
+    const QFileInfoList files = QDir(path).entryInfoList({"*.marshal"}, QDir::Files);
+    for (const QFileInfo &file : files) {
+        m_diskBytes += file.size();
+    }
+}
+
+QString PythonCodeCache::diskCacheDirectory() const {
+    QMutexLocker locker(&m_mutex);
+    return m_diskCacheDirectory;
+}
+
+PythonCodeCacheStats PythonCodeCache::stats() const {
+    PythonCodeCacheStats stats;
+    stats.hits = m_hits;
+    stats.diskHits = m_diskHits;
+    stats.misses = m_misses;
+    stats.evictions = m_evictions;
+
+    QMutexLocker locker(&m_mutex);
+    stats.size = m_entries.size();
+    stats.capacity = m_capacity;
+    return stats;
+}
+
+void PythonCodeCache::resetStats() {
+    m_hits = 0;
+    m_diskHits = 0;
+    m_misses = 0;
+    m_evictions = 0;
+}
+
+QByteArray PythonCodeCache::cacheKey(const QByteArray &source, int mode, const char *filename) const {
+    // The filename and compile mode are baked into the code object
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QByteArray::number(mode));
+    hash.addData(QByteArray(filename));
+    hash.addData(QByteArray(1, '\0'));
+    hash.addData(source);
+    return hash.result();
+}
+
+bool PythonCodeCache::persists(const char *filename) {
+    // Expressions and console lines are rarely repeated across restarts;
+    // writing each one out would only fill the directory
+    return std::strcmp(filename, "<expression>") != 0 && std::strcmp(filename, "<console>") != 0;
+}
+
+PyObject *PythonCodeCache::lookup(const QByteArray &key) {
+    QMutexLocker locker(&m_mutex);
+    auto it = m_entries.find(key);
+    if (it == m_entries.end()) {
+        return nullptr;
+    }
+
+    // Move to the front of the LRU list
+    m_lru.splice(m_lru.begin(), m_lru, it->lruPosition);
+    Py_INCREF(it->code);
+    return it->code;
+}
+
+void PythonCodeCache::insert(const QByteArray &key, PyObject *code) {
+    QMutexLocker locker(&m_mutex);
+    if (m_capacity == 0 || m_entries.contains(key)) {
+        return;
+    }
+
+    m_lru.push_front(key);
+    Py_INCREF(code);
+    m_entries.insert(key, Entry{code, m_lru.begin()});
+    evictToCapacity();
+}
+
+void PythonCodeCache::evictToCapacity() {
+    // Called with m_mutex held
+    while (m_entries.size() > m_capacity && !m_lru.empty()) {
+        auto it = m_entries.find(m_lru.back());
+        if (it != m_entries.end()) {
+            Py_DECREF(it->code);
+            m_entries.erase(it);
+        }
+        m_lru.pop_back();
+        ++m_evictions;
+    }
+}
+
+PyObject *PythonCodeCache::loadFromDisk(const QByteArray &key) {
+    QString directory;
+    {
+        QMutexLocker locker(&m_mutex);
+        directory = m_diskCacheDirectory;
+    }
+    if (directory.isEmpty()) {
+        return nullptr;
+    }
+
+    QFile file(QDir(directory).absoluteFilePath(QString::fromLatin1(key.toHex()) + ".marshal"));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return nullptr;
+    }
+
+    QByteArray data = file.readAll();
+    file.close();
+
+    // Entries written by a different interpreter version are ignored
+    long magic = PyImport_GetMagicNumber();
+    if (data.size() <= static_cast<int>(sizeof(magic)) || std::memcmp(data.constData(), &magic, sizeof(magic)) != 0) {
+        return nullptr;
+    }
+
+    PyObject *code = PyMarshal_ReadObjectFromString(data.constData() + sizeof(magic), data.size() - sizeof(magic));
+    if (!code || !PyCode_Check(code)) {
+        Py_XDECREF(code);
+        PyErr_Clear();
+        qDebug() << "Ignoring corrupt Python code cache entry:" << file.fileName();
+        return nullptr;
+    }
+
+    return code;
+}
+
+void PythonCodeCache::storeToDisk(const QByteArray &key, PyObject *code) {
+    QString directory;
+    {
+        QMutexLocker locker(&m_mutex);
+        directory = m_diskCacheDirectory;
+    }
+    if (directory.isEmpty()) {
+        return;
+    }
+
+    PyObject *marshalled = PyMarshal_WriteObjectToString(code, Py_MARSHAL_VERSION);
+    if (!marshalled) {
+        PyErr_Clear();
+        return;
+    }
+
+    long magic = PyImport_GetMagicNumber();
+    qint64 written = 0;
+    QSaveFile file(QDir(directory).absoluteFilePath(QString::fromLatin1(key.toHex()) + ".marshal"));
+    if (file.open(QIODevice::WriteOnly)) {
+        file.write(reinterpret_cast<const char *>(&magic), sizeof(magic));
+        file.write(PyBytes_AS_STRING(marshalled), PyBytes_GET_SIZE(marshalled));
+        if (file.commit()) {
+            written = sizeof(magic) + PyBytes_GET_SIZE(marshalled);
+        }
+    }
+
+    Py_DECREF(marshalled);
+
+    bool overCapacity = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_diskBytes += written;
+        overCapacity = m_diskBytes > m_diskCapacityBytes;
+    }
+    if (overCapacity) {
+        trimDisk(directory);
+    }
+}
+
+void PythonCodeCache::trimDisk(const QString &directory) {
+    // Oldest first; trims to three quarters so the next few stores do not
+    // each rescan the directory
+    const QFileInfoList files = QDir(directory).entryInfoList({"*.marshal"}, QDir::Files,
+                                                              QDir::Time | QDir::Reversed);
+    qint64 total = 0;
+    for (const QFileInfo &file : files) {
+        total += file.size();
+    }
+
+    qint64 target = 0;
+    {
+        QMutexLocker locker(&m_mutex);
+        target = m_diskCapacityBytes / 4 * 3;
+    }
+    for (const QFileInfo &file : files) {
+        if (total <= target) {
+            break;
+        }
+        if (QFile::remove(file.absoluteFilePath())) {
+            total -= file.size();
+        }
+    }
+
+    QMutexLocker locker(&m_mutex);
+    if (m_diskCacheDirectory == directory) {
+        m_diskBytes = total;
+    }
+}
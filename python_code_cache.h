@@ -0,0 +1,74 @@
+#ifndef PYTHON_CODE_CACHE_H
+#define PYTHON_CODE_CACHE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <atomic>
+#include <list>
+
+// Same declaration as in Python.h, so this header does not need the Python headers
+typedef struct _object PyObject;
+
+struct PythonCodeCacheStats {
+    quint64 hits = 0;
+    quint64 diskHits = 0;
+    quint64 misses = 0;
+    quint64 evictions = 0;
+    int size = 0;
+    int capacity = 0;
+};
+
+// LRU of compiled code objects keyed by a hash of the source and compile mode,
+// with an optional marshal cache on disk that survives restarts. One-off
+// <expression> and <console> snippets stay in memory only, and the oldest
+// files are removed once the directory exceeds ZORAPERL_PYCODE_CACHE_MB
+// (16 by default).
+// compile(), clear() and shrinking a populated cache need the GIL held.
+class PythonCodeCache {
+public:
+    explicit PythonCodeCache(int capacity = 256);
+
+    // Returns a new reference, or nullptr with the Python error set
+    PyObject *compile(const QString &source, int mode, const char *filename);
+    void clear();
+
+    void setCapacity(int capacity);
+    void setDiskCacheDirectory(const QString &path);
+    QString diskCacheDirectory() const;
+
+    PythonCodeCacheStats stats() const;
+    void resetStats();
+
+private:
+    struct Entry {
+        PyObject *code;
+        std::list<QByteArray>::iterator lruPosition;
+    };
+
+    QByteArray cacheKey(const QByteArray &source, int mode, const char *filename) const;
+    static bool persists(const char *filename);
+    PyObject *lookup(const QByteArray &key);
+    void insert(const QByteArray &key, PyObject *code);
+    void evictToCapacity();
+
+    PyObject *loadFromDisk(const QByteArray &key);
+    void storeToDisk(const QByteArray &key, PyObject *code);
+    void trimDisk(const QString &directory);
+
+    mutable QMutex m_mutex;
+    QHash<QByteArray, Entry> m_entries;
+    std::list<QByteArray> m_lru;
+    int m_capacity;
+    QString m_diskCacheDirectory;
+    qint64 m_diskBytes;
+    qint64 m_diskCapacityBytes;
+
+    std::atomic<quint64> m_hits;
+    std::atomic<quint64> m_diskHits;
+    std::atomic<quint64> m_misses;
+    std::atomic<quint64> m_evictions;
+};
+
+#endif // PYTHON_CODE_CACHE_H
@@ -0,0 +1,214 @@
+#include "python_console.h"
+#include "python_manager.h"
+#include "python_output.h"
+#include <QFontDatabase>
+#include <QHBoxLayout>
+#include <QKeyEvent>
+#include <QLabel>
+#include <QLineEdit>
+#include <QPlainTextEdit>
+#include <QPushButton>
+#include <QScrollBar>
+#include <QTextCursor>
+#include <QTimer>
+#include <QVBoxLayout>
+
+namespace {
+// One drain per frame, and never more than this much text per frame, so a
+// flood of output is spread over frames instead of blocking the event loop
+const int kDrainIntervalMs = 16;
+const qsizetype kBytesPerFrame = 256 << 10;
+const int kScrollbackLines = 5000;
+const int kHistorySize = 200;
+}
+
+PythonConsole::PythonConsole(PythonManager *pythonManager, QWidget *parent)
+    : QWidget(parent, Qt::Window), m_pythonManager(pythonManager), m_attached(false),
+      m_stdoutDecoder(QStringConverter::Utf8), m_stderrDecoder(QStringConverter::Utf8),
+      m_historyIndex(0), m_lastJobId(0) {
+    setWindowTitle("Python Console");
+    resize(820, 520);
+    setStyleSheet("PythonConsole { background-color: rgb(24, 24, 24); }"
+                  "QPlainTextEdit, QLineEdit { background-color: rgb(24, 24, 24); color: rgb(220, 220, 220); border: none; }"
+                  "QLabel { color: rgb(120, 170, 255); }");
+
+    const QFont font = QFontDatabase::systemFont(QFontDatabase::FixedFont);
+
+    m_output = new QPlainTextEdit;
+    m_output->setReadOnly(true);
+    m_output->setUndoRedoEnabled(false);
+    m_output->setMaximumBlockCount(kScrollbackLines);
+    m_output->setFont(font);
+
+    m_prompt = new QLabel(">>>");
+    m_prompt->setFont(font);
+    m_input = new QLineEdit;
+    m_input->setFont(font);
+    m_input->installEventFilter(this);
+    connect(m_input, &QLineEdit::returnPressed, this, &PythonConsole::submitLine);
+
+    QPushButton *interruptButton = new QPushButton("Interrupt");
+    QPushButton *clearButton = new QPushButton("Clear");
+    connect(interruptButton, &QPushButton::clicked, this, &PythonConsole::interrupt);
+    connect(clearButton, &QPushButton::clicked, this, &PythonConsole::clear);
+
+    QHBoxLayout *inputLayout = new QHBoxLayout;
+    inputLayout->addWidget(m_prompt);
+    inputLayout->addWidget(m_input, 1);
+    inputLayout->addWidget(interruptButton);
+    inputLayout->addWidget(clearButton);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(6, 6, 6, 6);
+    layout->addWidget(m_output, 1);
+    layout->addLayout(inputLayout);
+
+    m_stderrFormat.setForeground(QColor(255, 110, 110));
+    m_inputFormat.setForeground(QColor(120, 170, 255));
+    m_noticeFormat.setForeground(QColor(150, 150, 150));
+    m_noticeFormat.setFontItalic(true);
+
+    m_drainTimer = new QTimer(this);
+    m_drainTimer->setInterval(kDrainIntervalMs);
+    connect(m_drainTimer, &QTimer::timeout, this, &PythonConsole::drainOutput);
+
+    if (!PythonOutputCapture::instance().isInstalled()) {
+        appendText("Python output is not captured yet; it appears here once the interpreter is ready.\n",
+                   m_noticeFormat);
+    }
+}
+
+PythonConsole::~PythonConsole() {
+    if (m_attached) {
+        PythonOutputCapture::instance().detachReader();
+    }
+}
+
+void PythonConsole::showEvent(QShowEvent *event) {
+    // Writers only wait for a reader that is actually draining
+    if (!m_attached) {
+        PythonOutputCapture::instance().attachReader();
+        m_attached = true;
+    }
+    m_drainTimer->start();
+    drainOutput();
+    m_input->setFocus();
+    QWidget::showEvent(event);
+}
+
+void PythonConsole::hideEvent(QHideEvent *event) {
+    m_drainTimer->stop();
+    if (m_attached) {
+        PythonOutputCapture::instance().detachReader();
+        m_attached = false;
+    }
+    QWidget::hideEvent(event);
+}
+
+bool PythonConsole::eventFilter(QObject *watched, QEvent *event) {
+    if (watched == m_input && event->type() == QEvent::KeyPress) {
+        QKeyEvent *keyEvent = static_cast<QKeyEvent *>(event);
+        if (keyEvent->key() == Qt::Key_Up) {
+            showHistoryEntry(m_historyIndex - 1);
+            return true;
+        }
+        if (keyEvent->key() == Qt::Key_Down) {
+            showHistoryEntry(m_historyIndex + 1);
+            return true;
+        }
+    }
+    return QWidget::eventFilter(watched, event);
+}
+
+void PythonConsole::drainOutput() {
+    quint64 dropped = 0;
+    const QList<PythonOutputChunk> chunks = PythonOutputCapture::instance().drain(kBytesPerFrame, &dropped);
+
+    if (dropped > 0) {
+        appendText(QString("\n[%1 bytes of output dropped]\n").arg(dropped), m_noticeFormat);
+    }
+    for (const PythonOutputChunk &chunk : chunks) {
+        // The decoders keep state, so characters split across chunks survive
+        if (chunk.stream == PythonOutputChunk::Stderr) {
+            appendText(m_stderrDecoder.decode(chunk.data), m_stderrFormat);
+        } else {
+            appendText(m_stdoutDecoder.decode(chunk.data), m_stdoutFormat);
+        }
+    }
+}
+
+void PythonConsole::submitLine() {
+    const QString line = m_input->text();
+    m_input->clear();
+
+    // Earlier output belongs above the echoed input
+    drainOutput();
+    appendText(QString("%1 %2\n").arg(m_prompt->text(), line), m_inputFormat);
+
+    if (!line.trimmed().isEmpty()) {
+        m_history.removeAll(line);
+        m_history.append(line);
+        while (m_history.size() > kHistorySize) {
+            m_history.removeFirst();
+        }
+    }
+    m_historyIndex = m_history.size();
+
+    // A block opened with ':' continues until an empty line, as in the REPL
+    const bool opensBlock = line.trimmed().endsWith(':');
+    if (opensBlock || (!m_pendingLines.isEmpty() && !line.trimmed().isEmpty())) {
+        m_pendingLines.append(line);
+        m_prompt->setText("...");
+        return;
+    }
+
+    QString code = line;
+    if (!m_pendingLines.isEmpty()) {
+        code = m_pendingLines.join('\n') + '\n';
+        m_pendingLines.clear();
+        m_prompt->setText(">>>");
+    }
+    if (code.trimmed().isEmpty()) {
+        return;
+    }
+
+    m_pythonManager->submitInteractive(code, &m_lastJobId);
+}
+
+void PythonConsole::interrupt() {
+    m_pendingLines.clear();
+    m_prompt->setText(">>>");
+    if (m_lastJobId != 0 && m_pythonManager->cancelJob(m_lastJobId)) {
+        appendText("[interrupt requested]\n", m_noticeFormat);
+    }
+}
+
+void PythonConsole::clear() {
+    m_output->clear();
+}
+
+void PythonConsole::appendText(const QString &text, const QTextCharFormat &format) {
+    if (text.isEmpty()) {
+        return;
+    }
+
+    // Follow the output only while the view is scrolled to the bottom
+    QScrollBar *scrollBar = m_output->verticalScrollBar();
+    const bool following = scrollBar->value() == scrollBar->maximum();
+
+    QTextCursor cursor(m_output->document());
+    cursor.movePosition(QTextCursor::End);
+    cursor.insertText(text, format);
+
+    if (following) {
+        scrollBar->setValue(scrollBar->maximum());
+    }
+}
+
+void PythonConsole::showHistoryEntry(int index) {
+    if (m_history.isEmpty()) {
+        return;
+    }
+    m_historyIndex = qBound(0, index, int(m_history.size()));
+    m_input->setText(m_historyIndex < m_history.size() ? m_history.at(m_historyIndex) : QString());
+}
@@ -0,0 +1,61 @@
+#ifndef PYTHON_CONSOLE_H
+#define PYTHON_CONSOLE_H
+
+#include <QWidget>
+#include <QStringDecoder>
+#include <QStringList>
+#include <QTextCharFormat>
+
+class QLabel;
+class QLineEdit;
+class QPlainTextEdit;
+class QTimer;
+class PythonManager;
+
+// Interactive Python prompt for developer machines. Input runs on the
+// interpreter thread through PythonManager::submitInteractive; output is
+// pulled from PythonOutputCapture once per frame, a bounded batch at a time,
+// and the scrollback keeps the most recent lines only.
+class PythonConsole : public QWidget {
+    Q_OBJECT
+
+public:
+    explicit PythonConsole(PythonManager *pythonManager, QWidget *parent = nullptr);
+    ~PythonConsole();
+
+protected:
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private slots:
+    void drainOutput();
+    void submitLine();
+    void interrupt();
+    void clear();
+
+private:
+    void appendText(const QString &text, const QTextCharFormat &format);
+    void showHistoryEntry(int index);
+
+    PythonManager *m_pythonManager;
+    QPlainTextEdit *m_output;
+    QLabel *m_prompt;
+    QLineEdit *m_input;
+    QTimer *m_drainTimer;
+    bool m_attached;
+
+    QStringDecoder m_stdoutDecoder;
+    QStringDecoder m_stderrDecoder;
+    QTextCharFormat m_stdoutFormat;
+    QTextCharFormat m_stderrFormat;
+    QTextCharFormat m_inputFormat;
+    QTextCharFormat m_noticeFormat;
+
+    QStringList m_pendingLines;    // an unfinished block, shown with "..."
+    QStringList m_history;
+    int m_historyIndex;
+    quint64 m_lastJobId;
+};
+
+#endif // PYTHON_CONSOLE_H
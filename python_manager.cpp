@@ -1,10 +1,23 @@
 #include "python_manager.h"
+#include "startup_trace.h"
+#include "zora_layout.h"
+#include "python_worker.h"
+#include "python_bridge.h"
+#include "python_variant.h"
+#include "python_arithmetic.h"
+#include "python_output.h"
+#include "python_module_index.h"
+#include "python_memory_tracker.h"
+#include "python_zygote.h"
 #include <QDebug>
 #include <QDir>
 #include <QCoreApplication>
 #include <QProcess>
 #include <QFileInfo>
 #include <QStandardPaths>
+#include <QThread>
+#include <QMutexLocker>
+#include <QtConcurrent>
 
 // Undefine slots before including Python headers to avoid conflicts
 #ifdef slots
@@ -19,24 +32,412 @@
 #define slots Q_SLOTS
 #endif
 
+namespace {
+// Result of a job submitted from another thread, or the fallback if it never ran
+template <typename T>
+T futureResult(QFuture<T> future, const T &fallback) {
+    future.waitForFinished();
+    if (future.isCanceled() || future.resultCount() == 0) {
+        return fallback;
+    }
+    return future.result();
+}
+
+// Python version the binary is linked against, e.g. "3.12", or "3.13t" for
+// the free-threaded build whose stdlib lives in lib/python3.13t
+QString pythonVersionTag(bool abiSuffix) {
+    QString tag = QString("%1.%2").arg(PY_MAJOR_VERSION).arg(PY_MINOR_VERSION);
+#ifdef Py_GIL_DISABLED
+    if (abiSuffix) {
+        tag += "t";
+    }
+#else
+    Q_UNUSED(abiSuffix);
+#endif
+    return tag;
+}
+
+#ifndef ZORAPERL_PYTHON_OPTIMIZE_LEVEL
+#define ZORAPERL_PYTHON_OPTIMIZE_LEVEL 0
+#endif
+
+// Build default, overridable with ZORAPERL_PYTHON_OPTIMIZE=0..2 (like python -O/-OO)
+int pythonOptimizationLevel() {
+    bool ok = false;
+    int level = qEnvironmentVariableIntValue("ZORAPERL_PYTHON_OPTIMIZE", &ok);
+    return qBound(0, ok ? level : ZORAPERL_PYTHON_OPTIMIZE_LEVEL, 2);
+}
+
+// pythonXY.zip next to the binary (see tools/build_python_bundle.py), or empty
+QString stdlibBundlePath() {
+    if (qEnvironmentVariable("ZORAPERL_PYTHON_BUNDLE") == "0") {
+        return QString();
+    }
+    QString name = QString("python%1%2.zip").arg(PY_MAJOR_VERSION).arg(PY_MINOR_VERSION);
+    QString path = QDir(QCoreApplication::applicationDirPath()).absoluteFilePath(name);
+    return QFileInfo::exists(path) ? path : QString();
+}
+
+struct PythonInstallation {
+    QString executable;
+    QString home;
+    QString stdlib;
+    QString dynload;
+    QString sitePackages;
+};
+
+PythonInstallation describeInstallation(const QString &executable) {
+    PythonInstallation install;
+    install.executable = executable;
+    QDir binDir = QFileInfo(executable).dir();
+    
+#ifdef Q_OS_WIN
+    install.home = binDir.absolutePath();
+    if (QFileInfo::exists(install.home + "/Lib/os.py")) {
+        // python.org layout
+        install.stdlib = install.home + "/Lib";
+        install.dynload = install.home + "/DLLs";
+        install.sitePackages = install.stdlib + "/site-packages";
+        return install;
+    }
+    // MSYS2 layout: bin/python.exe next to lib/python3.x
+    install.stdlib = QDir::cleanPath(install.home + "/../lib/python" + pythonVersionTag(true));
+#else
+    // <prefix>/bin/python3.x with the stdlib in <prefix>/lib/python3.x
+    install.home = QDir::cleanPath(binDir.absolutePath() + "/..");
+    install.stdlib = install.home + "/lib/python" + pythonVersionTag(true);
+#endif
+    install.dynload = install.stdlib + "/lib-dynload";
+    install.sitePackages = install.stdlib + "/site-packages";
+    return install;
+}
+
+// First interpreter of the linked version whose stdlib is present
+bool findPythonInstallation(PythonInstallation *install) {
+    QStringList candidates;
+    QString tag = pythonVersionTag(true);
+    
+    QString overrideHome = qEnvironmentVariable("ZORAPERL_PYTHON_HOME");
+    if (!overrideHome.isEmpty()) {
+#ifdef Q_OS_WIN
+        candidates << overrideHome + "/python.exe";
+#else
+        candidates << overrideHome + "/bin/python" + tag;
+#endif
+    }
+    
+#ifdef ZORAPERL_PYTHON_EXECUTABLE
+    // The interpreter CMake found at configure time
+    candidates << QString::fromUtf8(ZORAPERL_PYTHON_EXECUTABLE);
+#endif
+    
+#ifdef Q_OS_WIN
+    candidates << "C:/msys64/ucrt64/bin/python.exe"
+               << "C:/msys64/mingw64/bin/python.exe"
+               << QString("C:/Python%1%2/python.exe").arg(PY_MAJOR_VERSION).arg(PY_MINOR_VERSION);
+#else
+    QString onPath = QStandardPaths::findExecutable("python" + tag);
+    if (!onPath.isEmpty()) {
+        candidates << onPath;
+    }
+    candidates << "/usr/local/bin/python" + tag << "/usr/bin/python" + tag;
+#endif
+    
+    for (const QString& candidate : std::as_const(candidates)) {
+        QFileInfo info(candidate);
+        if (!info.exists()) {
+            continue;
+        }
+        
+        // Resolve bin/python3 -> ../lib/... through symlinks such as /usr/bin/python3.12
+        QString executable = info.canonicalFilePath();
+        PythonInstallation found = describeInstallation(executable);
+        if (QFileInfo::exists(found.stdlib)) {
+            qDebug() << "Found Python at:" << executable;
+            *install = found;
+            return true;
+        }
+    }
+    
+    return false;
+}
+}
+
 PythonManager::PythonManager(QObject *parent) 
-    : QObject(parent), m_initialized(false) {
+    : QObject(parent), m_initialized(false), m_concurrent(false), m_warmupStarted(false),
+      m_worker(new PythonWorker(this)), m_watchdog(new PythonWatchdog(m_worker, this)),
+      m_pool(new PythonSubinterpreterPool(this)), m_zygote(new PythonZygote(this)),
+      m_moduleIndex(new PythonModuleIndex(this)), m_evalNamespace(nullptr),
+      m_evalNamespaceClean(true), m_nativeNames(nullptr), m_nativeNamesIntact(true) {
+    if (qEnvironmentVariable("ZORAPERL_PYTHON_PROFILE") == "1") {
+        m_profiler.setEnabled(true);
+    }
+    m_worker->setWatchdog(m_watchdog);
+    connect(m_watchdog, &PythonWatchdog::jobOverran, this, &PythonManager::scriptOverran);
 }
 
 PythonManager::~PythonManager() {
+    // Queued jobs capture this; drain the interpreter threads first. The
+    // watchdog outlives the worker so a stuck job cannot hang shutdown.
+    m_zygote->stop();
+    m_pool->stop();
+    m_worker->stop();
+    m_watchdog->stop();
     cleanup();
 }
 
 bool PythonManager::initialize() {
+    if (!m_worker->isCurrentThread()) {
+        return futureResult(initializeAsync(), false);
+    }
+    return initializeInterpreter();
+}
+
+QFuture<bool> PythonManager::initializeAsync() {
+    QMutexLocker locker(&m_warmupMutex);
+    if (!m_warmupStarted) {
+        qDebug() << "Warming up Python interpreter on the interpreter thread";
+        m_warmupStarted = true;
+        // Startup cost is not a script overrun
+        m_warmupFuture = m_worker->submit<bool>([this]() {
+            TraceSpan span("python warm-up", "python");
+            return initializeInterpreter();
+        }, nullptr, "python warm-up", 0);
+    }
+    return m_warmupFuture;
+}
+
+bool PythonManager::waitUntilReady() {
+    QFuture<bool> future;
+    {
+        QMutexLocker locker(&m_warmupMutex);
+        if (!m_warmupStarted) {
+            return m_initialized;
+        }
+        future = m_warmupFuture;
+    }
+    
+    // Jobs queued behind warm-up never need to wait for it
+    if (m_worker->isCurrentThread()) {
+        return m_initialized;
+    }
+    
+    if (!future.isFinished()) {
+        qDebug() << "Waiting for Python warm-up to finish...";
+        TraceSpan span("PythonManager::waitUntilReady", "python");
+    }
+    
+    return futureResult(future, false);
+}
+
+QFuture<bool> PythonManager::submitString(const QString &code, quint64 *jobId, int timeoutMs) {
+    if (m_concurrent) {
+        if (jobId) {
+            *jobId = 0;
+        }
+        return QtConcurrent::run([this, code]() { return executeString(code); });
+    }
+    return m_worker->submit<bool>([this, code]() { return executeString(code); },
+                                  jobId, pythonScriptLabel("<string>", code), timeoutMs);
+}
+
+QFuture<bool> PythonManager::submitInteractive(const QString &code, quint64 *jobId) {
+    if (m_concurrent) {
+        if (jobId) {
+            *jobId = 0;
+        }
+        return QtConcurrent::run([this, code]() { return executeInteractive(code); });
+    }
+    return m_worker->submit<bool>([this, code]() { return executeInteractive(code); },
+                                  jobId, pythonScriptLabel("<console>", code));
+}
+
+QFuture<bool> PythonManager::submitFile(const QString &filename, quint64 *jobId, int timeoutMs) {
+    if (m_concurrent) {
+        if (jobId) {
+            *jobId = 0;
+        }
+        return QtConcurrent::run([this, filename]() { return executeFile(filename); });
+    }
+    return m_worker->submit<bool>([this, filename]() { return executeFile(filename); },
+                                  jobId, pythonScriptLabel(filename, QString()), timeoutMs);
+}
+
+QFuture<QString> PythonManager::submitExpression(const QString &expression, quint64 *jobId) {
+    noteExpression(expression);
+    if (m_concurrent) {
+        if (jobId) {
+            *jobId = 0;
+        }
+        return QtConcurrent::run([this, expression]() { return evaluateExpression(expression); });
+    }
+    return m_worker->submit<QString>([this, expression]() { return evaluateExpression(expression); },
+                                     jobId, pythonScriptLabel("<expression>", expression));
+}
+
+QFuture<PythonEvalResult> PythonManager::submitEvaluate(const QString &expression, quint64 *jobId) {
+    noteExpression(expression);
+    if (m_concurrent) {
+        if (jobId) {
+            *jobId = 0;
+        }
+        return QtConcurrent::run([this, expression]() { return evaluate(expression); });
+    }
+    return m_worker->submit<PythonEvalResult>([this, expression]() { return evaluate(expression); },
+                                              jobId, pythonScriptLabel("<expression>", expression));
+}
+
+bool PythonManager::cancelJob(quint64 jobId) {
+    return m_worker->cancel(jobId);
+}
+
+bool PythonManager::isInterpreterThread() const {
+    return m_worker->isCurrentThread();
+}
+
+void PythonManager::setScriptTimeout(int ms) {
+    m_watchdog->setDefaultTimeout(ms);
+}
+
+int PythonManager::scriptTimeout() const {
+    return m_watchdog->defaultTimeout();
+}
+
+QList<PythonOverrun> PythonManager::scriptOverruns() const {
+    return m_watchdog->overruns();
+}
+
+bool PythonManager::isFreeThreadedBuild() {
+#ifdef Py_GIL_DISABLED
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool PythonManager::runsConcurrently() const {
+    return m_concurrent;
+}
+
+bool PythonManager::runsOnCallingThread() const {
+    return m_concurrent || m_worker->isCurrentThread();
+}
+
+bool PythonManager::detectConcurrentExecution() {
+#ifdef Py_GIL_DISABLED
+    if (qEnvironmentVariable("ZORAPERL_PYTHON_CONCURRENT") == "0") {
+        qDebug() << "Free-threaded Python, concurrent execution disabled by environment";
+        return false;
+    }
+    
+    // A 3.13t build re-enables the GIL when it imports an extension that is
+    // not marked free-threading safe, or with PYTHON_GIL=1
+    bool gilEnabled = true;
+    PyGILState_STATE gstate = PyGILState_Ensure();
+    PyObject* sysModule = PyImport_ImportModule("sys");
+    PyObject* result = sysModule ? PyObject_CallMethod(sysModule, "_is_gil_enabled", nullptr) : nullptr;
+    if (result) {
+        gilEnabled = PyObject_IsTrue(result);
+    } else {
+        PyErr_Clear();
+    }
+    Py_XDECREF(result);
+    Py_XDECREF(sysModule);
+    
+    // Created up front so concurrent evaluateExpression calls never race on it
+    evaluationNamespace();
+    PyGILState_Release(gstate);
+    
+    qDebug() << "Free-threaded Python, GIL enabled at runtime:" << gilEnabled;
+    return !gilEnabled;
+#else
+    return false;
+#endif
+}
+
+bool PythonManager::startSubinterpreterPool(int size) {
+    if (!PythonSubinterpreterPool::isSupported()) {
+        qDebug() << "Subinterpreters with their own GIL need Python 3.12+";
+        return false;
+    }
+    
+    // Subinterpreters are created from the main interpreter once it is up
+    if (!waitUntilReady()) {
+        qDebug() << "Python not initialized for subinterpreter pool";
+        return false;
+    }
+    
+    return m_pool->start(size);
+}
+
+void PythonManager::stopSubinterpreterPool() {
+    m_pool->stop();
+}
+
+QFuture<PythonPoolResult> PythonManager::submitIsolated(const QString &code) {
+    if (m_pool->size() > 0) {
+        return m_pool->submit(code);
+    }
+    
+    return m_worker->submit<PythonPoolResult>([this, code]() {
+        PythonPoolResult result;
+        if (!Py_IsInitialized()) {
+            result.error = "Error: Python not initialized";
+            return result;
+        }
+        
+        // The fresh namespace still shares builtins and math with evaluateExpression
+        PyGILState_STATE gstate = PyGILState_Ensure();
+        result = PythonSubinterpreterPool::runInCurrentInterpreter(code);
+        checkNativeNames();
+        PyGILState_Release(gstate);
+        return result;
+    });
+}
+
+bool PythonManager::startZygote() {
+    TraceSpan span("PythonManager::startZygote", "python");
+    return m_zygote->start();
+}
+
+void PythonManager::stopZygote() {
+    m_zygote->stop();
+}
+
+bool PythonManager::hasZygote() const {
+    return m_zygote->isRunning();
+}
+
+QFuture<PythonPoolResult> PythonManager::submitForked(const QString &code, int timeoutMs) {
+    if (m_zygote->isRunning()) {
+        return m_zygote->submit(code, timeoutMs < 0 ? scriptTimeout() : timeoutMs);
+    }
+    return submitIsolated(code);
+}
+
+int PythonManager::runZygoteServer(const QString &shmName) {
+    // The loop forks from the interpreter thread, which owns the interpreter
+    QFuture<int> future = m_worker->submit<int>([shmName]() {
+        PyGILState_STATE gstate = PyGILState_Ensure();
+        int status = PythonZygote::serveRequests(shmName);
+        PyGILState_Release(gstate);
+        return status;
+    }, nullptr, "python zygote", 0);
+    return futureResult(future, 1);
+}
+
+bool PythonManager::initializeInterpreter() {
     if (m_initialized) {
         return true;
     }
     
     qDebug() << "Initializing Python interpreter...";
+    TraceSpan span("PythonManager::initialize", "python");
     
     try {
         // Check if Python is already initialized
-        if (!Py_IsInitialized()) {
+        bool ownsInterpreter = !Py_IsInitialized();
+        if (ownsInterpreter) {
             // Configure Python using modern initialization API
             if (!initializePythonModern()) {
                 qDebug() << "Failed to initialize Python with modern API";
@@ -46,6 +447,11 @@ bool PythonManager::initialize() {
             qDebug() << "Python interpreter initialized successfully";
         }
         
+        // Compiled scripts can persist across restarts (opt-in)
+        if (m_codeCache.diskCacheDirectory().isEmpty() && qEnvironmentVariable("ZORAPERL_PYCODE_CACHE") == "1") {
+            m_codeCache.setDiskCacheDirectory(ZoraLayout::path("system/cache/pycode"));
+        }
+        
         // For Python 3.7+, GIL is automatically initialized
         // No need for deprecated PyEval_InitThreads()
         qDebug() << "GIL is automatically initialized in Python 3.7+";
@@ -61,6 +467,15 @@ bool PythonManager::initialize() {
             return false;
         }
         
+        // Script output goes to the console's ring buffer (and still to stdout)
+        if (qEnvironmentVariable("ZORAPERL_PYTHON_CAPTURE") != "0") {
+            PyGILState_STATE gstate = PyGILState_Ensure();
+            if (!PythonOutputCapture::instance().install()) {
+                qDebug() << "Python output stays on the process streams";
+            }
+            PyGILState_Release(gstate);
+        }
+        
         // Test basic functionality
         if (!testPythonBasics()) {
             qDebug() << "Python basic functionality test failed";
@@ -68,10 +483,31 @@ bool PythonManager::initialize() {
             return false;
         }
         
+        // Before any script runs, so later rebinding shows up as a difference
+        if (!m_nativeNames) {
+            PyGILState_STATE gstate = PyGILState_Ensure();
+            PyObject* math = PyImport_ImportModule("math");
+            if (!math) {
+                PyErr_Clear();
+            }
+            Py_XDECREF(math);
+            m_nativeNames = nativeNameValues();
+            PyGILState_Release(gstate);
+        }
+        
+        m_concurrent = detectConcurrentExecution();
         m_initialized = true;
         qDebug() << "Python manager fully initialized";
         qDebug() << "Python version:" << getVersion();
         
+        // The interpreter thread holds the GIL from here on (on free-threaded
+        // builds: is attached to the interpreter). Release it once;
+        // each job takes it with PyGILState_Ensure. Apart from subinterpreter
+        // pool threads briefly taking it at creation, nothing contends for it.
+        if (ownsInterpreter) {
+            PyEval_SaveThread();
+        }
+        
         return true;
         
     } catch (...) {
@@ -82,44 +518,50 @@ bool PythonManager::initialize() {
 }
 
 bool PythonManager::initializePythonModern() {
+    TraceSpan span("PythonManager::initializePythonModern", "python");
+    
     // Use the new PyConfig API for Python 3.8+
     PyStatus status;
     PyConfig config;
     
+    // The tracked allocator puts a header on every block, so it has to be in
+    // place before the interpreter allocates anything. That header costs
+    // memory on every allocation, so it is only installed when asked for or
+    // when a script limit is configured.
+    if (qEnvironmentVariable("ZORAPERL_PYTHON_MEMORY_TRACKING") == "1"
+        || PythonMemoryTracker::instance().scriptLimit() > 0) {
+        PyPreConfig preConfig;
+        PyPreConfig_InitPythonConfig(&preConfig);
+        status = Py_PreInitialize(&preConfig);
+        if (PyStatus_Exception(status)) {
+            qDebug() << "Failed to pre-initialize Python";
+            return false;
+        }
+        PythonMemoryTracker::instance().install();
+    }
+    
     // Initialize config with default values
     PyConfig_InitPythonConfig(&config);
     
     // Find Python installation
-    QString pythonExecutable;
-    QString pythonHome;
-    
-    QStringList possiblePythonPaths = {
-        "C:/msys64/ucrt64/bin/python.exe",
-        "C:/msys64/mingw64/bin/python.exe",
-        "C:/Python39/python.exe",
-        "C:/Python310/python.exe",
-        "C:/Python311/python.exe",
-        "C:/Python312/python.exe"
-    };
+    PythonInstallation install;
+    QString bundle = stdlibBundlePath();
+    bool haveInstallation = findPythonInstallation(&install);
     
-    // Find valid Python executable
-    for (const QString& path : possiblePythonPaths) {
-        if (QFileInfo::exists(path)) {
-            pythonExecutable = path;
-            pythonHome = QFileInfo(path).dir().absolutePath();
-            qDebug() << "Found Python at:" << pythonExecutable;
-            break;
-        }
-    }
-    
-    if (pythonExecutable.isEmpty()) {
+    if (!haveInstallation && bundle.isEmpty()) {
         qDebug() << "Could not find Python executable";
         PyConfig_Clear(&config);
         return false;
     }
     
+    if (!haveInstallation) {
+        // Self-contained deployment: the bundle next to the binary is the stdlib
+        install.executable = QCoreApplication::applicationFilePath();
+        install.home = QCoreApplication::applicationDirPath();
+    }
+    
     // Set program name
-    std::wstring programNameWide = pythonExecutable.toStdWString();
+    std::wstring programNameWide = install.executable.toStdWString();
     status = PyConfig_SetString(&config, &config.program_name, programNameWide.c_str());
     if (PyStatus_Exception(status)) {
         qDebug() << "Failed to set program name";
@@ -128,7 +570,7 @@ bool PythonManager::initializePythonModern() {
     }
     
     // Set Python home
-    std::wstring pythonHomeWide = pythonHome.toStdWString();
+    std::wstring pythonHomeWide = install.home.toStdWString();
     status = PyConfig_SetString(&config, &config.home, pythonHomeWide.c_str());
     if (PyStatus_Exception(status)) {
         qDebug() << "Failed to set Python home";
@@ -139,11 +581,19 @@ bool PythonManager::initializePythonModern() {
     // Configure module search paths
     QStringList pythonPaths;
     
-    // Add standard library paths for MSYS2
-    if (pythonHome.contains("msys64")) {
-        pythonPaths << pythonHome + "/../lib/python3.12";
-        pythonPaths << pythonHome + "/../lib/python3.12/lib-dynload";
-        pythonPaths << pythonHome + "/../lib/python3.12/site-packages";
+    // The bundle replaces the loose stdlib tree: one zip directory read
+    // instead of a stat/open per probed file. Extension modules can't be
+    // loaded from a zip, so lib-dynload stays on the path either way.
+    if (!bundle.isEmpty()) {
+        qDebug() << "Using bundled standard library:" << bundle;
+        pythonPaths << bundle;
+    } else if (!install.stdlib.isEmpty()) {
+        pythonPaths << install.stdlib;
+    }
+    for (const QString& path : {install.dynload, install.sitePackages}) {
+        if (!path.isEmpty() && QFileInfo::exists(path)) {
+            pythonPaths << path;
+        }
     }
     
     // Add current working directory and application directory
@@ -163,13 +613,21 @@ bool PythonManager::initializePythonModern() {
     config.module_search_paths_set = 1;
     
     // Set other configuration options
-    config.optimization_level = 0;  // No optimization for debugging
+    config.optimization_level = pythonOptimizationLevel();
     config.use_environment = 1;     // Use environment variables
     config.user_site_directory = 1; // Enable user site directory
     config.isolated = 0;            // Don't isolate Python
     
+    // Built-in zoraperl module for zero-copy data exchange
+    if (!PythonBridge::registerModule()) {
+        qDebug() << "Failed to register the zoraperl module";
+    }
+    
     // Initialize Python with the configuration
-    status = Py_InitializeFromConfig(&config);
+    {
+        TraceSpan initSpan("Py_InitializeFromConfig", "python");
+        status = Py_InitializeFromConfig(&config);
+    }
     
     // Clean up configuration
     PyConfig_Clear(&config);
@@ -189,11 +647,17 @@ bool PythonManager::initializePythonModern() {
 
 bool PythonManager::isInitialized() const {
     bool pyInitialized = Py_IsInitialized();
-    qDebug() << "isInitialized() check - m_initialized:" << m_initialized << "Py_IsInitialized():" << pyInitialized;
+    qDebug() << "isInitialized() check - m_initialized:" << m_initialized.load() << "Py_IsInitialized():" << pyInitialized;
     return m_initialized && pyInitialized;
 }
 
 bool PythonManager::executeString(const QString &code) {
+    // All Python work runs on the interpreter thread, behind warm-up, unless
+    // the GIL is gone and callers can run it in parallel
+    if (!runsOnCallingThread()) {
+        return futureResult(submitString(code), false);
+    }
+    
     qDebug() << "executeString called - isInitialized():" << isInitialized();
     
     if (!Py_IsInitialized()) {
@@ -203,14 +667,28 @@ bool PythonManager::executeString(const QString &code) {
     
     qDebug() << "Executing Python code:" << code.left(100) + (code.length() > 100 ? "..." : "");
     
-    // Acquire GIL
+    // Acquire GIL. Free-threaded builds have no lock to take but still need
+    // this thread attached to the interpreter, so the call stays.
     PyGILState_STATE gstate = PyGILState_Ensure();
     
     bool success = false;
     try {
-        // Execute the code
-        int result = PyRun_SimpleString(code.toUtf8().constData());
-        success = (result == 0);
+        PythonMemoryScope memory("<string>", code);
+        PythonProfileScope profile(m_profiler, "<string>", code);
+        
+        // Execute the code in __main__, like PyRun_SimpleString, but reuse the
+        // compiled code object when the same source runs again
+        PyObject* mainModule = PyImport_AddModule("__main__");
+        PyObject* globals = mainModule ? PyModule_GetDict(mainModule) : nullptr;
+        PyObject* compiled = globals ? m_codeCache.compile(code, Py_file_input, "<string>") : nullptr;
+        
+        if (compiled) {
+            PyObject* result = PyEval_EvalCode(compiled, globals, globals);
+            success = (result != nullptr);
+            Py_XDECREF(result);
+            Py_DECREF(compiled);
+        }
+        checkNativeNames();
         
         if (!success) {
             qDebug() << "Python execution failed";
@@ -234,7 +712,53 @@ bool PythonManager::executeString(const QString &code) {
     return success;
 }
 
+bool PythonManager::executeInteractive(const QString &code) {
+    if (!runsOnCallingThread()) {
+        return futureResult(submitInteractive(code), false);
+    }
+    
+    if (!Py_IsInitialized()) {
+        return false;
+    }
+    
+    PyGILState_STATE gstate = PyGILState_Ensure();
+    
+    // Like the interactive interpreter: runs in __main__, and expression
+    // statements print their value through sys.displayhook
+    bool success = false;
+    {
+        PythonMemoryScope memory("<console>", code);
+        PythonProfileScope profile(m_profiler, "<console>", code);
+        PyObject* mainModule = PyImport_AddModule("__main__");
+        PyObject* globals = mainModule ? PyModule_GetDict(mainModule) : nullptr;
+        PyObject* compiled = globals ? m_codeCache.compile(code, Py_single_input, "<console>") : nullptr;
+        if (compiled) {
+            PyObject* result = PyEval_EvalCode(compiled, globals, globals);
+            success = (result != nullptr);
+            Py_XDECREF(result);
+            Py_DECREF(compiled);
+        }
+        checkNativeNames();
+    }
+    
+    // The traceback goes to sys.stderr, which is the console when captured.
+    // PyErr_Print would exit the process on SystemExit, so exit() is ignored.
+    if (!success && PyErr_ExceptionMatches(PyExc_SystemExit)) {
+        PyErr_Clear();
+        PySys_WriteStderr("SystemExit ignored: the console cannot exit the desktop\n");
+    } else if (!success && PyErr_Occurred()) {
+        PyErr_Print();
+    }
+    
+    PyGILState_Release(gstate);
+    return success;
+}
+
 bool PythonManager::executeFile(const QString &filename) {
+    if (!runsOnCallingThread()) {
+        return futureResult(submitFile(filename), false);
+    }
+    
     if (!Py_IsInitialized()) {
         qDebug() << "Python not initialized";
         return false;
@@ -255,6 +779,9 @@ bool PythonManager::executeFile(const QString &filename) {
     FILE* file = nullptr;
     
     try {
+        PythonMemoryScope memory(filename, QString());
+        PythonProfileScope profile(m_profiler, filename, QString());
+        
         // Open file
 #ifdef _WIN32
         if (fopen_s(&file, filename.toLocal8Bit().constData(), "r") != 0) {
@@ -268,6 +795,7 @@ bool PythonManager::executeFile(const QString &filename) {
             // Execute file
             int result = PyRun_SimpleFile(file, filename.toLocal8Bit().constData());
             success = (result == 0);
+            checkNativeNames();
             
             if (!success) {
                 if (PyErr_Occurred()) {
@@ -295,6 +823,10 @@ bool PythonManager::executeFile(const QString &filename) {
 }
 
 bool PythonManager::addToPath(const QString &path) {
+    if (!m_worker->isCurrentThread()) {
+        return futureResult(m_worker->submit<bool>([this, path]() { return addToPath(path); }), false);
+    }
+    
     if (!Py_IsInitialized()) {
         qDebug() << "Python not initialized for addToPath";
         return false;
@@ -307,23 +839,17 @@ bool PythonManager::addToPath(const QString &path) {
     
     bool success = false;
     try {
-        // Get sys module
-        PyObject* sysModule = PyImport_ImportModule("sys");
-        if (sysModule) {
-            // Get sys.path
-            PyObject* sysPath = PyObject_GetAttrString(sysModule, "path");
-            if (sysPath && PyList_Check(sysPath)) {
-                // Create Python string from path
-                PyObject* pathString = PyUnicode_FromString(path.toUtf8().constData());
-                if (pathString) {
-                    // Append to sys.path
-                    int result = PyList_Append(sysPath, pathString);
-                    success = (result == 0);
-                    Py_DECREF(pathString);
-                }
-                Py_DECREF(sysPath);
+        // sys.path, borrowed straight from the sys module without an import
+        PyObject* sysPath = PySys_GetObject("path");
+        if (sysPath && PyList_Check(sysPath)) {
+            // Create Python string from path
+            PyObject* pathString = PyUnicode_FromString(path.toUtf8().constData());
+            if (pathString) {
+                // Append to sys.path
+                int result = PyList_Append(sysPath, pathString);
+                success = (result == 0);
+                Py_DECREF(pathString);
             }
-            Py_DECREF(sysModule);
         }
         
         if (PyErr_Occurred()) {
@@ -351,6 +877,16 @@ QString PythonManager::getVersion() const {
 }
 
 QString PythonManager::evaluateExpression(const QString &expression) {
+    // Plain arithmetic is computed natively, without the GIL or a thread hop
+    PythonNumber number;
+    if (evaluateNatively(expression, &number)) {
+        return pythonNumberToString(number);
+    }
+    
+    if (!runsOnCallingThread()) {
+        return futureResult(submitExpression(expression), QString("Error: Python job cancelled"));
+    }
+    
     if (!Py_IsInitialized()) {
         return "Error: Python not initialized";
     }
@@ -361,17 +897,18 @@ QString PythonManager::evaluateExpression(const QString &expression) {
     QString result = "Error: Failed to evaluate expression";
     
     try {
-        // Create a new dictionary for local variables
-        PyObject* globals = PyDict_New();
-        PyObject* locals = PyDict_New();
+        PythonMemoryScope memory("<expression>", expression);
+        PythonProfileScope profile(m_profiler, "<expression>", expression);
         
-        if (globals && locals) {
-            // Add builtins to globals
-            PyDict_SetItemString(globals, "__builtins__", PyEval_GetBuiltins());
-            
+        // Reuse one namespace and the cached code object instead of building
+        // fresh dicts and recompiling on every call
+        PyObject* globals = evaluationNamespace();
+        PyObject* compiled = globals ? m_codeCache.compile(expression, Py_eval_input, "<expression>") : nullptr;
+        
+        if (compiled) {
             // Evaluate expression
-            PyObject* pyResult = PyRun_String(expression.toUtf8().constData(), 
-                                            Py_eval_input, globals, locals);
+            PyObject* pyResult = PyEval_EvalCode(compiled, globals, globals);
+            Py_DECREF(compiled);
             
             if (pyResult) {
                 // Convert result to string
@@ -384,16 +921,13 @@ QString PythonManager::evaluateExpression(const QString &expression) {
                     Py_DECREF(strResult);
                 }
                 Py_DECREF(pyResult);
-            } else {
-                if (PyErr_Occurred()) {
-                    PyErr_Print();
-                    PyErr_Clear();
-                }
             }
         }
         
-        if (globals) Py_DECREF(globals);
-        if (locals) Py_DECREF(locals);
+        if (PyErr_Occurred()) {
+            PyErr_Print();
+            PyErr_Clear();
+        }
         
     } catch (...) {
         qDebug() << "Exception occurred during expression evaluation";
@@ -406,6 +940,272 @@ QString PythonManager::evaluateExpression(const QString &expression) {
     return result;
 }
 
+PythonEvalResult PythonManager::evaluate(const QString &expression) {
+    PythonNumber number;
+    if (evaluateNatively(expression, &number)) {
+        PythonEvalResult result;
+        result.success = true;
+        result.value = pythonNumberToVariant(number);
+        return result;
+    }
+    
+    if (!runsOnCallingThread()) {
+        PythonEvalResult cancelled;
+        cancelled.error = "Python job cancelled";
+        return futureResult(submitEvaluate(expression), cancelled);
+    }
+    
+    PythonEvalResult result;
+    if (!Py_IsInitialized()) {
+        result.error = "Python not initialized";
+        return result;
+    }
+    
+    PyGILState_STATE gstate = PyGILState_Ensure();
+    
+    // Same namespace and code cache as evaluateExpression, but the value is
+    // converted in one pass and errors go to result.error, not stderr
+    PyObject* pyResult = nullptr;
+    {
+        PythonMemoryScope memory("<expression>", expression);
+        PythonProfileScope profile(m_profiler, "<expression>", expression);
+        PyObject* globals = evaluationNamespace();
+        PyObject* compiled = globals ? m_codeCache.compile(expression, Py_eval_input, "<expression>") : nullptr;
+        pyResult = compiled ? PyEval_EvalCode(compiled, globals, globals) : nullptr;
+        Py_XDECREF(compiled);
+    }
+    
+    if (pyResult) {
+        result.success = true;
+        result.value = pythonToVariant(pyResult);
+        Py_DECREF(pyResult);
+    } else {
+        result.error = takePythonError();
+        if (result.error.isEmpty()) {
+            result.error = "Failed to evaluate expression";
+        }
+    }
+    
+    PyGILState_Release(gstate);
+    return result;
+}
+
+PyObject* PythonManager::evaluationNamespace() {
+    // Called with the GIL held
+    if (!m_evalNamespace) {
+        m_evalNamespace = PyDict_New();
+        populateEvaluationNamespace();
+    }
+    return m_evalNamespace;
+}
+
+void PythonManager::populateEvaluationNamespace() {
+    // Called with the GIL held. math is bound up front so that math.sqrt(2)
+    // means the same thing on the native path and in Python.
+    if (!m_evalNamespace) {
+        return;
+    }
+    PyDict_SetItemString(m_evalNamespace, "__builtins__", PyEval_GetBuiltins());
+    PyObject* math = PyImport_ImportModule("math");
+    if (math) {
+        PyDict_SetItemString(m_evalNamespace, "math", math);
+        Py_DECREF(math);
+    } else {
+        PyErr_Clear();
+    }
+}
+
+bool PythonManager::evaluateNatively(const QString &expression, PythonNumber *number) {
+    // Calls to abs(), math.sqrt() and friends are only safe while nothing
+    // evaluated or executed through Python can have rebound those names
+    if (evaluateArithmetic(expression, m_evalNamespaceClean && m_nativeNamesIntact, number)) {
+        return true;
+    }
+    noteExpression(expression);
+    return false;
+}
+
+void PythonManager::noteExpression(const QString &expression) {
+    // Eval-mode code only binds names through := or by reaching the namespace
+    // or builtins directly; anything else leaves them as populated
+    static const char *const rebinding[] = {":=", "__", "globals", "locals", "vars",
+                                            "exec", "eval", "setattr", "delattr"};
+    for (const char *token : rebinding) {
+        if (expression.contains(QLatin1String(token))) {
+            m_evalNamespaceClean = false;
+            return;
+        }
+    }
+}
+
+PyObject* PythonManager::nativeNameValues() const {
+    // Called with the GIL held. The math module followed by whatever each
+    // name is bound to right now, None where it is missing. Borrowed lookups
+    // only, so nothing in a script gets to run.
+    const QList<QByteArray> &builtinNames = arithmeticBuiltinNames();
+    const QList<QByteArray> &mathNames = arithmeticMathNames();
+    PyObject* values = PyTuple_New(1 + builtinNames.size() + mathNames.size());
+    if (!values) {
+        PyErr_Clear();
+        return nullptr;
+    }
+    
+    // sys.modules only: importing could run a script's import hooks
+    PyObject* mathName = PyUnicode_InternFromString("math");
+    PyObject* math = mathName ? PyImport_GetModule(mathName) : nullptr;
+    Py_XDECREF(mathName);
+    if (!math) {
+        PyErr_Clear();
+    }
+    PyObject* builtins = PyEval_GetBuiltins();
+    PyObject* mathDict = math ? PyModule_GetDict(math) : nullptr;
+    
+    Py_ssize_t index = 0;
+    auto add = [&](PyObject* value) {
+        value = value ? value : Py_None;
+        Py_INCREF(value);
+        PyTuple_SET_ITEM(values, index++, value);
+    };
+    add(math);
+    for (const QByteArray &name : builtinNames) {
+        add(builtins ? PyDict_GetItemString(builtins, name.constData()) : nullptr);
+    }
+    for (const QByteArray &name : mathNames) {
+        add(mathDict ? PyDict_GetItemString(mathDict, name.constData()) : nullptr);
+    }
+    Py_XDECREF(math);
+    return values;
+}
+
+void PythonManager::checkNativeNames() {
+    // Called with the GIL held after each script. Identity, not equality:
+    // a rebound name may compare equal and still behave differently.
+    if (!m_nativeNames || !m_nativeNamesIntact) {
+        return;
+    }
+    PyObject* current = nativeNameValues();
+    bool intact = current && PyTuple_GET_SIZE(current) == PyTuple_GET_SIZE(m_nativeNames);
+    for (Py_ssize_t i = 0; intact && i < PyTuple_GET_SIZE(current); ++i) {
+        intact = PyTuple_GET_ITEM(current, i) == PyTuple_GET_ITEM(m_nativeNames, i);
+    }
+    Py_XDECREF(current);
+    
+    if (!intact) {
+        qDebug() << "A script rebound builtins or math; calls in expressions now go through Python";
+        m_nativeNamesIntact = false;
+    }
+}
+
+void PythonManager::resetNamespace() {
+    if (!m_worker->isCurrentThread()) {
+        futureResult(m_worker->submit<bool>([this]() { resetNamespace(); return true; }), false);
+        return;
+    }
+    
+    if (!Py_IsInitialized()) {
+        return;
+    }
+    
+    PyGILState_STATE gstate = PyGILState_Ensure();
+    if (m_evalNamespace) {
+        PyDict_Clear(m_evalNamespace);
+        populateEvaluationNamespace();
+    }
+    m_evalNamespaceClean = true;
+    PyGILState_Release(gstate);
+}
+
+PythonMemoryStats PythonManager::memoryUsage() const {
+    return PythonMemoryTracker::instance().total();
+}
+
+QList<PythonMemoryStats> PythonManager::scriptMemoryStats() const {
+    return PythonMemoryTracker::instance().scripts();
+}
+
+void PythonManager::setScriptMemoryLimit(qint64 bytes) {
+    if (bytes > 0 && !PythonMemoryTracker::instance().isInstalled()) {
+        qDebug() << "Script memory limit has no effect: memory tracking was not enabled at startup";
+    }
+    PythonMemoryTracker::instance().setScriptLimit(bytes);
+}
+
+qint64 PythonManager::scriptMemoryLimit() const {
+    return PythonMemoryTracker::instance().scriptLimit();
+}
+
+void PythonManager::setProfilingEnabled(bool enabled) {
+    m_profiler.setEnabled(enabled);
+}
+
+bool PythonManager::isProfilingEnabled() const {
+    return m_profiler.isEnabled();
+}
+
+PythonProfileReport PythonManager::profileReport() const {
+    return m_profiler.report();
+}
+
+QString PythonManager::profileCollapsedStacks() const {
+    return m_profiler.collapsedStacks();
+}
+
+void PythonManager::resetProfile() {
+    if (!m_worker->isCurrentThread()) {
+        futureResult(m_worker->submit<bool>([this]() { resetProfile(); return true; }), false);
+        return;
+    }
+    
+    if (!Py_IsInitialized()) {
+        return;
+    }
+    
+    // Releases the code objects the profiler keeps for its name cache
+    PyGILState_STATE gstate = PyGILState_Ensure();
+    m_profiler.reset();
+    PyGILState_Release(gstate);
+}
+
+PythonCodeCacheStats PythonManager::codeCacheStats() const {
+    return m_codeCache.stats();
+}
+
+void PythonManager::setCodeCacheCapacity(int capacity) {
+    if (!Py_IsInitialized()) {
+        m_codeCache.setCapacity(capacity);
+        return;
+    }
+    
+    // Shrinking evicts entries, which releases code objects
+    if (!m_worker->isCurrentThread()) {
+        futureResult(m_worker->submit<bool>([this, capacity]() { setCodeCacheCapacity(capacity); return true; }), false);
+        return;
+    }
+    
+    PyGILState_STATE gstate = PyGILState_Ensure();
+    m_codeCache.setCapacity(capacity);
+    PyGILState_Release(gstate);
+}
+
+void PythonManager::setCodeCacheDirectory(const QString &path) {
+    m_codeCache.setDiskCacheDirectory(path);
+}
+
+void PythonManager::clearCodeCache() {
+    if (!m_worker->isCurrentThread()) {
+        futureResult(m_worker->submit<bool>([this]() { clearCodeCache(); return true; }), false);
+        return;
+    }
+    
+    if (!Py_IsInitialized()) {
+        return;
+    }
+    
+    PyGILState_STATE gstate = PyGILState_Ensure();
+    m_codeCache.clear();
+    PyGILState_Release(gstate);
+}
+
 void PythonManager::cleanup() {
     if (m_initialized) {
         qDebug() << "Cleaning up Python interpreter...";
@@ -418,31 +1218,50 @@ void PythonManager::cleanup() {
 }
 
 bool PythonManager::setupPythonPath() {
+    TraceSpan span("PythonManager::setupPythonPath", "python");
     qDebug() << "Setting up Python path...";
     
-    // Add current directory
     QString currentDir = QDir::currentPath();
+    QString appDir = QCoreApplication::applicationDirPath();
+    
+    // Common Python script directories
+    QStringList scriptDirs;
+    for (const QString& dir : {QString("scripts"), QString("python"), QString("py")}) {
+        QString fullPath = QDir(appDir).absoluteFilePath(dir);
+        if (QDir(fullPath).exists()) {
+            scriptDirs << fullPath;
+        }
+    }
+    
+    // Index the directories once and answer imports from the index
+    if (qEnvironmentVariable("ZORAPERL_MODULE_INDEX") != "0") {
+        m_moduleIndex->setDirectories(QStringList{currentDir, appDir} + scriptDirs);
+        
+        PyGILState_STATE gstate = PyGILState_Ensure();
+        bool installed = m_moduleIndex->install();
+        PyGILState_Release(gstate);
+        
+        if (installed) {
+            qDebug() << "Python path setup completed with module index";
+            return true;
+        }
+        qDebug() << "Module index unavailable, falling back to sys.path";
+    }
+    
+    // Add current directory
     if (!addToPath(currentDir)) {
         qDebug() << "Failed to add current directory to Python path";
         return false;
     }
     
     // Add application directory
-    QString appDir = QCoreApplication::applicationDirPath();
     if (!addToPath(appDir)) {
         qDebug() << "Failed to add application directory to Python path";
         return false;
     }
     
-    // Add common Python script directories
-    QStringList scriptDirs;
-    scriptDirs << "scripts" << "python" << "py";
-    
-    for (const QString& dir : scriptDirs) {
-        QString fullPath = QDir(appDir).absoluteFilePath(dir);
-        if (QDir(fullPath).exists()) {
-            addToPath(fullPath);
-        }
+    for (const QString& fullPath : std::as_const(scriptDirs)) {
+        addToPath(fullPath);
     }
     
     qDebug() << "Python path setup completed";
@@ -450,6 +1269,7 @@ bool PythonManager::setupPythonPath() {
 }
 
 bool PythonManager::testPythonBasics() {
+    TraceSpan span("PythonManager::testPythonBasics", "python");
     qDebug() << "Testing Python basics...";
     
     // Test basic Python functionality
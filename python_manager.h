@@ -3,6 +3,28 @@
 
 #include <QObject>
 #include <QString>
+#include <QFuture>
+#include <QMutex>
+#include <QVariant>
+#include <atomic>
+#include "python_code_cache.h"
+#include "python_profiler.h"
+#include "python_memory_tracker.h"
+#include "python_subinterpreter_pool.h"
+#include "python_watchdog.h"
+#include "python_arithmetic.h"
+
+class PythonWorker;
+class PythonModuleIndex;
+class PythonZygote;
+
+// Typed result of evaluate(): value holds None/bool/int/float/str/bytes as
+// the matching QVariant type, list/tuple as QVariantList, dict as QVariantMap
+struct PythonEvalResult {
+    bool success = false;
+    QVariant value;
+    QString error;  // "ZeroDivisionError: division by zero"; empty on success
+};
 
 class PythonManager : public QObject
 {
@@ -15,22 +37,144 @@ public:
     bool initialize();
     bool isInitialized() const;
     
+    // Lazy mode: warm the interpreter up on the interpreter thread. Entry points
+    // called before warm-up finishes queue behind it instead of failing.
+    QFuture<bool> initializeAsync();
+    bool waitUntilReady();
+    
+    // Asynchronous entry points. Every job runs on the dedicated interpreter
+    // thread; the synchronous calls below queue there too and block for the
+    // result. A running job can be interrupted with cancelJob().
+    // timeoutMs sets a deadline for one script (-1: the script timeout, which
+    // is off unless configured; 0: unbounded).
+    QFuture<bool> submitString(const QString &code, quint64 *jobId = nullptr, int timeoutMs = -1);
+    QFuture<bool> submitFile(const QString &filename, quint64 *jobId = nullptr, int timeoutMs = -1);
+    QFuture<QString> submitExpression(const QString &expression, quint64 *jobId = nullptr);
+    QFuture<PythonEvalResult> submitEvaluate(const QString &expression, quint64 *jobId = nullptr);
+    bool cancelJob(quint64 jobId);
+    bool isInterpreterThread() const;
+    
+    // Jobs on the interpreter thread that run past their timeout are
+    // interrupted, and abandoned if they ignore it. There is no default
+    // deadline: callers opt in per call through timeoutMs, or for every job
+    // with setScriptTimeout or ZORAPERL_PYTHON_TIMEOUT_MS (0 disables it).
+    // An abandoned job keeps running on its own thread while a fresh
+    // interpreter thread serves later jobs, so one runaway script does not
+    // block the rest. Code stuck in C with the GIL held stalls the new thread
+    // as well; only submitForked can kill such a script.
+    // Jobs run concurrently are not watched.
+    void setScriptTimeout(int ms);
+    int scriptTimeout() const;
+    QList<PythonOverrun> scriptOverruns() const;
+    
+    // Free-threaded CPython (3.13t) with the GIL off at runtime: executeString,
+    // executeFile and evaluateExpression run on the calling thread, and the
+    // submit* calls on the global thread pool, so they execute in parallel.
+    // Such jobs report id 0 and cannot be cancelled.
+    static bool isFreeThreadedBuild();
+    bool runsConcurrently() const;
+    
+    // Independent scripts in isolated subinterpreters, one GIL each, so they
+    // run in parallel. Without a pool (or before Python 3.12) submitIsolated
+    // runs the script in a fresh namespace on the interpreter thread instead.
+    bool startSubinterpreterPool(int size);
+    void stopSubinterpreterPool();
+    QFuture<PythonPoolResult> submitIsolated(const QString &code);
+    
+    // Scripts in separate processes forked from a pre-warmed zygote (POSIX).
+    // Same contract as submitIsolated, which submitForked falls back to when
+    // the zygote is not running. Forked children past timeoutMs (-1: the
+    // script timeout) are killed and their slot freed.
+    bool startZygote();
+    void stopZygote();
+    bool hasZygote() const;
+    QFuture<PythonPoolResult> submitForked(const QString &code, int timeoutMs = -1);
+    // In the zygote process only: serves fork requests until stdin closes
+    int runZygoteServer(const QString &shmName);
+    
     bool executeString(const QString &code);
+    // One console entry, compiled like the interactive prompt: the value of an
+    // expression statement is printed. Output reaches PythonOutputCapture.
+    bool executeInteractive(const QString &code);
+    QFuture<bool> submitInteractive(const QString &code, quint64 *jobId = nullptr);
     bool executeFile(const QString &filename);
     bool addToPath(const QString &path);
     
     QString getVersion() const;
+    // Plain arithmetic (numbers, + - * / // % **, parentheses, abs/round/min/
+    // max/pow/int/float and math.*) is computed natively with the same result;
+    // everything else runs in Python. The namespace has math imported.
     QString evaluateExpression(const QString &expression);
+    PythonEvalResult evaluate(const QString &expression);
+    
+    // Clears names left in the namespace shared by evaluateExpression calls
+    void resetNamespace();
+    
+    // Compiled code cache used by executeString and evaluateExpression. Setting
+    // a directory (or ZORAPERL_PYCODE_CACHE=1) keeps compiled scripts on disk.
+    PythonCodeCacheStats codeCacheStats() const;
+    void setCodeCacheCapacity(int capacity);
+    void setCodeCacheDirectory(const QString &path);
+    void clearCodeCache();
+    
+    // Python heap usage, overall and per script, when the tracked allocator
+    // is installed (ZORAPERL_PYTHON_MEMORY_TRACKING=1, or a limit set through
+    // ZORAPERL_PYTHON_SCRIPT_MEMORY_MB; it adds 16 bytes to every block).
+    // A script going over the limit gets MemoryError; 0 means no limit.
+    PythonMemoryStats memoryUsage() const;
+    QList<PythonMemoryStats> scriptMemoryStats() const;
+    void setScriptMemoryLimit(qint64 bytes);
+    qint64 scriptMemoryLimit() const;
+    
+    // Opt-in profiling of everything run through executeString, executeFile,
+    // evaluateExpression and evaluate (also on with ZORAPERL_PYTHON_PROFILE=1)
+    void setProfilingEnabled(bool enabled);
+    bool isProfilingEnabled() const;
+    PythonProfileReport profileReport() const;
+    QString profileCollapsedStacks() const;
+    void resetProfile();
     
     void cleanup();
 
+signals:
+    void scriptOverran(const PythonOverrun &overrun);
+
 private:
+    bool initializeInterpreter();
     bool initializePythonModern();
     bool configurePythonPaths(); // Deprecated, kept for compatibility
     bool setupPythonPath();
     bool testPythonBasics();
+    PyObject *evaluationNamespace();
+    void populateEvaluationNamespace();
+    bool evaluateNatively(const QString &expression, PythonNumber *number);
+    void noteExpression(const QString &expression);
+    PyObject *nativeNameValues() const;
+    void checkNativeNames();
+    bool detectConcurrentExecution();
+    bool runsOnCallingThread() const;
+    
+    std::atomic<bool> m_initialized;
+    std::atomic<bool> m_concurrent;
+    
+    QMutex m_warmupMutex;
+    QFuture<bool> m_warmupFuture;
+    bool m_warmupStarted;
+    PythonWorker *m_worker;
+    PythonWatchdog *m_watchdog;
+    PythonSubinterpreterPool *m_pool;
+    PythonZygote *m_zygote;
+    PythonModuleIndex *m_moduleIndex;
     
-    bool m_initialized;
+    PythonCodeCache m_codeCache;
+    PythonProfiler m_profiler;
+    PyObject *m_evalNamespace;
+    // False once an expression may have rebound builtins or math
+    std::atomic<bool> m_evalNamespaceClean;
+    // What the builtins and math names the native path implements were bound
+    // to at startup; calls go through Python once a script rebinds one
+    PyObject *m_nativeNames;
+    std::atomic<bool> m_nativeNamesIntact;
 };
 
 #endif // PYTHON_MANAGER_H
\ No newline at end of file
@@ -0,0 +1,370 @@
+#include "python_memory_tracker.h"
+#include "python_profiler.h"
+#include <QMutexLocker>
+#include <QDebug>
+#include <chrono>
+#include <vector>
+
+// Undefine slots before including Python headers to avoid conflicts
+#ifdef slots
+#undef slots
+#endif
+
+// Include Python headers
+#include <Python.h>
+
+// Redefine slots for Qt after Python headers
+#ifndef slots
+#define slots Q_SLOTS
+#endif
+
+// Counters of one running (or recently finished) script. Blocks carry the
+// script's sequence number; once the slot is reused for a later script, frees
+// of older blocks only update the totals.
+struct PythonMemoryTracker::Slot {
+    std::atomic<quint32> sequence{0};
+    std::atomic<qint64> live{0};
+    std::atomic<qint64> peak{0};
+    std::atomic<quint64> allocations{0};
+    std::atomic<qint64> allocatedBytes{0};
+    std::atomic<qint64> limit{0};
+    std::atomic<qint64> grace{0};       // headroom while a refusal unwinds
+    std::atomic<bool> exceeded{false};
+
+    // Guarded by the tracker mutex
+    QString label;
+    qint64 startNs = 0;
+    bool running = false;
+};
+
+namespace {
+const int kSlotCount = 64;
+const quint32 kMagic = 0x5a4f5241;  // "ZORA"
+const qint64 kMinimumGrace = 1024 * 1024;
+
+// 16 bytes keeps the alignment the wrapped allocators guarantee
+struct alignas(16) BlockHeader {
+    size_t size;
+    quint32 sequence;
+    quint32 magic;
+};
+static_assert(sizeof(BlockHeader) == 16, "block header must preserve 16-byte alignment");
+
+struct Domain {
+    PyMemAllocatorDomain domain;
+    PyMemAllocatorEx original;
+};
+
+Domain g_domains[2] = {{PYMEM_DOMAIN_MEM, {}}, {PYMEM_DOMAIN_OBJ, {}}};
+PythonMemoryTracker::Slot g_slots[kSlotCount];
+std::atomic<qint64> g_totalLive(0);
+std::atomic<qint64> g_totalPeak(0);
+std::atomic<quint64> g_totalAllocations(0);
+std::atomic<qint64> g_totalAllocated(0);
+
+// The script this thread is running, if any
+thread_local PythonMemoryTracker::Slot *t_slot = nullptr;
+thread_local quint32 t_sequence = 0;
+thread_local std::vector<std::pair<PythonMemoryTracker::Slot *, quint32>> t_outer;
+
+qint64 nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void raisePeak(std::atomic<qint64> &peak, qint64 value) {
+    qint64 current = peak.load(std::memory_order_relaxed);
+    while (value > current && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+PythonMemoryTracker::Slot *slotFor(quint32 sequence) {
+    if (sequence == 0) {
+        return nullptr;
+    }
+    PythonMemoryTracker::Slot *slot = &g_slots[sequence % kSlotCount];
+    return slot->sequence.load(std::memory_order_relaxed) == sequence ? slot : nullptr;
+}
+
+// False when the running script would go over its limit; the allocation then
+// fails and Python raises MemoryError in the script. The refusal grants one
+// round of headroom so the exception can unwind; it is withdrawn once the
+// script is back under its limit, so catching MemoryError in a loop never
+// lets it grow past limit + grace.
+bool admit(size_t size) {
+    PythonMemoryTracker::Slot *slot = t_slot;
+    if (!slot) {
+        return true;
+    }
+    qint64 limit = slot->limit.load(std::memory_order_relaxed);
+    if (limit <= 0) {
+        return true;
+    }
+    qint64 wanted = slot->live.load(std::memory_order_relaxed) + static_cast<qint64>(size);
+    qint64 grace = slot->grace.load(std::memory_order_relaxed);
+    if (wanted <= limit) {
+        if (grace != 0) {
+            slot->grace.store(0, std::memory_order_relaxed);
+        }
+        return true;
+    }
+    if (grace != 0 && wanted <= limit + grace) {
+        return true;
+    }
+
+    if (grace == 0) {
+        slot->grace.store(qMax(limit / 8, kMinimumGrace), std::memory_order_relaxed);
+    }
+    if (!slot->exceeded.exchange(true)) {
+        qDebug() << "Python script exceeded its memory limit of" << limit << "bytes";
+    }
+    return false;
+}
+
+void account(size_t size, quint32 sequence) {
+    qint64 bytes = static_cast<qint64>(size);
+    raisePeak(g_totalPeak, g_totalLive.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+    g_totalAllocations.fetch_add(1, std::memory_order_relaxed);
+    g_totalAllocated.fetch_add(bytes, std::memory_order_relaxed);
+
+    if (PythonMemoryTracker::Slot *slot = slotFor(sequence)) {
+        raisePeak(slot->peak, slot->live.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+        slot->allocations.fetch_add(1, std::memory_order_relaxed);
+        slot->allocatedBytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+}
+
+void release(size_t size, quint32 sequence) {
+    qint64 bytes = static_cast<qint64>(size);
+    g_totalLive.fetch_sub(bytes, std::memory_order_relaxed);
+    if (PythonMemoryTracker::Slot *slot = slotFor(sequence)) {
+        slot->live.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+}
+
+void *finishBlock(void *raw, size_t size) {
+    BlockHeader *header = static_cast<BlockHeader *>(raw);
+    header->size = size;
+    header->sequence = t_sequence;
+    header->magic = kMagic;
+    account(size, t_sequence);
+    return header + 1;
+}
+
+void *trackedMalloc(void *context, size_t size) {
+    if (size > PY_SSIZE_T_MAX - sizeof(BlockHeader) || !admit(size)) {
+        return nullptr;
+    }
+    PyMemAllocatorEx &original = static_cast<Domain *>(context)->original;
+    void *raw = original.malloc(original.ctx, size + sizeof(BlockHeader));
+    return raw ? finishBlock(raw, size) : nullptr;
+}
+
+void *trackedCalloc(void *context, size_t count, size_t elementSize) {
+    if (elementSize != 0 && count > (PY_SSIZE_T_MAX - sizeof(BlockHeader)) / elementSize) {
+        return nullptr;
+    }
+    size_t size = count * elementSize;
+    if (!admit(size)) {
+        return nullptr;
+    }
+    PyMemAllocatorEx &original = static_cast<Domain *>(context)->original;
+    void *raw = original.calloc(original.ctx, 1, size + sizeof(BlockHeader));
+    return raw ? finishBlock(raw, size) : nullptr;
+}
+
+void *trackedRealloc(void *context, void *pointer, size_t size) {
+    if (!pointer) {
+        return trackedMalloc(context, size);
+    }
+    if (size > PY_SSIZE_T_MAX - sizeof(BlockHeader)) {
+        return nullptr;
+    }
+
+    BlockHeader *header = static_cast<BlockHeader *>(pointer) - 1;
+    size_t oldSize = header->size;
+    quint32 oldSequence = header->sequence;
+    if (size > oldSize && !admit(size - oldSize)) {
+        return nullptr;
+    }
+
+    PyMemAllocatorEx &original = static_cast<Domain *>(context)->original;
+    void *raw = original.realloc(original.ctx, header, size + sizeof(BlockHeader));
+    if (!raw) {
+        return nullptr;
+    }
+
+    // The block now belongs to whoever resized it
+    release(oldSize, oldSequence);
+    return finishBlock(raw, size);
+}
+
+void trackedFree(void *context, void *pointer) {
+    if (!pointer) {
+        return;
+    }
+    BlockHeader *header = static_cast<BlockHeader *>(pointer) - 1;
+    Q_ASSERT(header->magic == kMagic);
+    release(header->size, header->sequence);
+
+    PyMemAllocatorEx &original = static_cast<Domain *>(context)->original;
+    original.free(original.ctx, header);
+}
+
+PythonMemoryStats snapshot(const PythonMemoryTracker::Slot &slot, qint64 now) {
+    PythonMemoryStats stats;
+    stats.label = slot.label;
+    stats.liveBytes = slot.live.load();
+    stats.peakBytes = slot.peak.load();
+    stats.allocations = slot.allocations.load();
+    stats.allocatedBytes = slot.allocatedBytes.load();
+    stats.limitExceeded = slot.exceeded.load();
+    stats.running = slot.running;
+
+    qint64 elapsed = now - slot.startNs;
+    stats.durationMs = elapsed / 1000000;
+    stats.bytesPerSecond = elapsed > 0 ? stats.allocatedBytes * 1e9 / elapsed : 0;
+    return stats;
+}
+}
+
+PythonMemoryTracker &PythonMemoryTracker::instance() {
+    static PythonMemoryTracker tracker;
+    return tracker;
+}
+
+PythonMemoryTracker::PythonMemoryTracker()
+    : m_installed(false), m_scriptLimit(0), m_nextSequence(0) {
+    bool ok = false;
+    qint64 limitMb = qEnvironmentVariable("ZORAPERL_PYTHON_SCRIPT_MEMORY_MB").toLongLong(&ok);
+    if (ok && limitMb > 0) {
+        m_scriptLimit = limitMb * 1024 * 1024;
+    }
+}
+
+bool PythonMemoryTracker::install() {
+    if (m_installed) {
+        return true;
+    }
+    if (Py_IsInitialized()) {
+        qDebug() << "Memory tracker must be installed before Python is initialized";
+        return false;
+    }
+#ifdef Py_GIL_DISABLED
+    qDebug() << "Memory tracking is not available on free-threaded Python";
+    return false;
+#else
+    for (Domain &domain : g_domains) {
+        PyMem_GetAllocator(domain.domain, &domain.original);
+        PyMemAllocatorEx tracked = {&domain, trackedMalloc, trackedCalloc, trackedRealloc, trackedFree};
+        PyMem_SetAllocator(domain.domain, &tracked);
+    }
+    m_installed = true;
+    qDebug() << "Python memory tracking installed, script limit:" << m_scriptLimit.load() << "bytes";
+    return true;
+#endif
+}
+
+bool PythonMemoryTracker::isInstalled() const {
+    return m_installed;
+}
+
+void PythonMemoryTracker::setScriptLimit(qint64 bytes) {
+    m_scriptLimit = qMax<qint64>(0, bytes);
+}
+
+qint64 PythonMemoryTracker::scriptLimit() const {
+    return m_scriptLimit;
+}
+
+PythonMemoryStats PythonMemoryTracker::total() const {
+    PythonMemoryStats stats;
+    stats.label = "total";
+    stats.liveBytes = g_totalLive.load();
+    stats.peakBytes = g_totalPeak.load();
+    stats.allocations = g_totalAllocations.load();
+    stats.allocatedBytes = g_totalAllocated.load();
+    return stats;
+}
+
+QList<PythonMemoryStats> PythonMemoryTracker::scripts() const {
+    qint64 now = nowNs();
+    QMutexLocker locker(&m_mutex);
+
+    QList<PythonMemoryStats> result;
+    for (int i = 0; i < kSlotCount; ++i) {
+        if (g_slots[i].running) {
+            result.append(snapshot(g_slots[i], now));
+        }
+    }
+    result.append(m_finished);
+    return result;
+}
+
+void PythonMemoryTracker::beginScript(const QString &label) {
+    quint32 sequence = ++m_nextSequence;
+    if (sequence == 0) {
+        sequence = ++m_nextSequence;
+    }
+    Slot *slot = &g_slots[sequence % kSlotCount];
+
+    {
+        QMutexLocker locker(&m_mutex);
+        slot->sequence.store(sequence);
+        slot->live = 0;
+        slot->peak = 0;
+        slot->allocations = 0;
+        slot->allocatedBytes = 0;
+        slot->limit = m_scriptLimit.load();
+        slot->grace = 0;
+        slot->exceeded = false;
+        slot->label = label;
+        slot->startNs = nowNs();
+        slot->running = true;
+    }
+
+    t_outer.emplace_back(t_slot, t_sequence);
+    t_slot = slot;
+    t_sequence = sequence;
+}
+
+void PythonMemoryTracker::endScript() {
+    Slot *slot = t_slot;
+    if (!slot) {
+        return;
+    }
+
+    if (!t_outer.empty()) {
+        t_slot = t_outer.back().first;
+        t_sequence = t_outer.back().second;
+        t_outer.pop_back();
+    } else {
+        t_slot = nullptr;
+        t_sequence = 0;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    slot->running = false;
+    PythonMemoryStats stats = snapshot(*slot, nowNs());
+    if (stats.limitExceeded) {
+        qDebug() << "Python script over memory limit:" << stats.label << "peak" << stats.peakBytes << "bytes";
+    }
+
+    m_finished.prepend(stats);
+    while (m_finished.size() > kSlotCount) {
+        m_finished.removeLast();
+    }
+}
+
+PythonMemoryScope::PythonMemoryScope(const QString &kind, const QString &text)
+    : m_active(PythonMemoryTracker::instance().isInstalled()) {
+    if (m_active) {
+        PythonMemoryTracker::instance().beginScript(pythonScriptLabel(kind, text));
+    }
+}
+
+PythonMemoryScope::~PythonMemoryScope() {
+    if (m_active) {
+        PythonMemoryTracker::instance().endScript();
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef PYTHON_MEMORY_TRACKER_H
+#define PYTHON_MEMORY_TRACKER_H
+
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <atomic>
+
+struct PythonMemoryStats {
+    QString label;              // the script, or "total"
+    qint64 liveBytes = 0;       // for a finished script: still held when it ended
+    qint64 peakBytes = 0;
+    quint64 allocations = 0;
+    qint64 allocatedBytes = 0;
+    qint64 durationMs = 0;
+    double bytesPerSecond = 0;
+    bool limitExceeded = false;
+    bool running = false;
+};
+
+// Wraps the PYMEM and OBJECT allocators with a small size header so live
+// bytes can be attributed to the script that allocated them. A script over
+// the soft limit gets MemoryError from the allocation that crossed it, then
+// some headroom so it can still unwind.
+//
+// The header means it must be installed before the interpreter starts.
+// Free-threaded builds are not supported: their GC walks the mimalloc heaps.
+class PythonMemoryTracker {
+public:
+    static PythonMemoryTracker &instance();
+
+    // After Py_PreInitialize, before Py_InitializeFromConfig
+    bool install();
+    bool isInstalled() const;
+
+    // Per-script soft limit in bytes; 0 disables it
+    void setScriptLimit(qint64 bytes);
+    qint64 scriptLimit() const;
+
+    PythonMemoryStats total() const;
+    // Running scripts first, then the most recently finished
+    QList<PythonMemoryStats> scripts() const;
+
+    // Attributes this thread's allocations to a script until endScript()
+    void beginScript(const QString &label);
+    void endScript();
+
+    struct Slot;
+
+private:
+    PythonMemoryTracker();
+
+    std::atomic<bool> m_installed;
+    std::atomic<qint64> m_scriptLimit;
+    std::atomic<quint32> m_nextSequence;
+
+    mutable QMutex m_mutex;
+    QList<PythonMemoryStats> m_finished;
+};
+
+class PythonMemoryScope {
+public:
+    PythonMemoryScope(const QString &kind, const QString &text);
+    ~PythonMemoryScope();
+
+private:
+    bool m_active;
+};
+
+#endif // PYTHON_MEMORY_TRACKER_H
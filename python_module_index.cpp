@@ -0,0 +1,551 @@
+#include "python_module_index.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QSet>
+#include <QDebug>
+
+// Undefine slots before including Python headers to avoid conflicts
+#ifdef slots
+#undef slots
+#endif
+
+// Include Python headers
+#include <Python.h>
+
+// Redefine slots for Qt after Python headers
+#ifndef slots
+#define slots Q_SLOTS
+#endif
+
+namespace {
+const char *kCapsuleName = "zoraperl.module_index";
+
+bool isIdentifier(const QString &name) {
+    if (name.isEmpty() || name.at(0).isDigit()) {
+        return false;
+    }
+    for (QChar c : name) {
+        if (!c.isLetterOrNumber() && c != QLatin1Char('_')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+QString normalizedDirectory(const QString &path) {
+    return QDir::cleanPath(QDir(path).absolutePath());
+}
+
+PyObject *unicode(const QString &text) {
+    return PyUnicode_FromString(text.toUtf8().constData());
+}
+
+qint64 directoryMtime(const QString &directory) {
+    return QFileInfo(directory).lastModified().toMSecsSinceEpoch();
+}
+}
+
+PythonModuleIndex::PythonModuleIndex(QObject *parent)
+    : QObject(parent), m_watcher(new QFileSystemWatcher(this)),
+      m_specFromFileLocation(nullptr), m_moduleSpec(nullptr),
+      m_self(new std::atomic<PythonModuleIndex *>(this)) {
+    connect(m_watcher, &QFileSystemWatcher::directoryChanged, this, &PythonModuleIndex::rescanDirectory);
+}
+
+PythonModuleIndex::~PythonModuleIndex() {
+    // The finders stay in sys.path_importer_cache and Python is never
+    // finalized, so imports can still reach them. Detaching needs no GIL: from
+    // now on they find nothing. The cached importlib callables and m_self are
+    // deliberately not released.
+    m_self->store(nullptr);
+}
+
+void PythonModuleIndex::setDirectories(const QStringList &directories) {
+    QStringList normalized;
+    for (const QString &directory : directories) {
+        QString path = normalizedDirectory(directory);
+        if (QFileInfo(path).isDir() && !normalized.contains(path)) {
+            normalized << path;
+        }
+    }
+
+    // The mtime is taken before listing, so a change during the scan still
+    // triggers a rescan on the next miss
+    QHash<QString, DirectoryEntries> scanned;
+    QHash<QString, qint64> mtimes;
+    for (const QString &directory : std::as_const(normalized)) {
+        mtimes.insert(directory, directoryMtime(directory));
+        scanned.insert(directory, scanDirectory(directory));
+    }
+
+    {
+        QWriteLocker locker(&m_lock);
+        m_directories = normalized;
+        m_byDirectory = scanned;
+        m_scannedMtime = mtimes;
+        rebuildMerged();
+    }
+
+    // The watcher belongs to the thread this object lives on
+    QMetaObject::invokeMethod(this, [this, normalized]() {
+        if (!m_watcher->directories().isEmpty()) {
+            m_watcher->removePaths(m_watcher->directories());
+        }
+        m_watcher->addPaths(normalized);
+    });
+}
+
+QStringList PythonModuleIndex::directories() const {
+    QReadLocker locker(&m_lock);
+    return m_directories;
+}
+
+int PythonModuleIndex::moduleCount() const {
+    QReadLocker locker(&m_lock);
+    return m_modules.size();
+}
+
+void PythonModuleIndex::rescanDirectory(const QString &directory) {
+    QString path = normalizedDirectory(directory);
+    {
+        QReadLocker locker(&m_lock);
+        if (!m_directories.contains(path)) {
+            return;
+        }
+    }
+
+    qint64 modified = directoryMtime(path);
+    DirectoryEntries entries = scanDirectory(path);
+
+    QWriteLocker locker(&m_lock);
+    m_byDirectory.insert(path, entries);
+    m_scannedMtime.insert(path, modified);
+    rebuildMerged();
+    qDebug() << "Module index updated for" << path << "-" << m_modules.size() << "modules";
+}
+
+PythonModuleIndex::DirectoryEntries PythonModuleIndex::scanDirectory(const QString &directory) const {
+    QStringList extensionSuffixes;
+    {
+        QReadLocker locker(&m_lock);
+        extensionSuffixes = m_extensionSuffixes;
+    }
+
+    DirectoryEntries entries;
+    auto offer = [&entries](const QString &name, const Entry &entry) {
+        // Same preference as the path finder within one directory:
+        // package, then extension module, then source, then namespace portion
+        auto it = entries.find(name);
+        if (it == entries.end() || entry.kind < it->kind) {
+            entries.insert(name, entry);
+        }
+    };
+
+    const QFileInfoList infos = QDir(directory).entryInfoList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QFileInfo &info : infos) {
+        QString fileName = info.fileName();
+
+        if (info.isDir()) {
+            if (!isIdentifier(fileName)) {
+                continue;
+            }
+            Entry entry;
+            QString init = info.absoluteFilePath() + "/__init__.py";
+            if (QFileInfo::exists(init)) {
+                entry.kind = Package;
+                entry.path = init;
+            } else {
+                entry.kind = Namespace;
+                entry.path = info.absoluteFilePath();
+                entry.portions << entry.path;
+            }
+            offer(fileName, entry);
+            continue;
+        }
+
+        Entry entry;
+        entry.path = info.absoluteFilePath();
+        QString name;
+        for (const QString &suffix : std::as_const(extensionSuffixes)) {
+            if (fileName.endsWith(suffix)) {
+                entry.kind = Extension;
+                name = fileName.chopped(suffix.size());
+                break;
+            }
+        }
+        if (name.isEmpty() && fileName.endsWith(".py")) {
+            entry.kind = Source;
+            name = fileName.chopped(3);
+        }
+        if (isIdentifier(name)) {
+            offer(name, entry);
+        }
+    }
+
+    return entries;
+}
+
+void PythonModuleIndex::rebuildMerged() {
+    // Called with m_lock held for writing
+    m_modules.clear();
+    for (const QString &directory : std::as_const(m_directories)) {
+        const DirectoryEntries &entries = m_byDirectory.value(directory);
+        for (auto it = entries.cbegin(); it != entries.cend(); ++it) {
+            auto existing = m_modules.find(it.key());
+            if (existing == m_modules.end()) {
+                m_modules.insert(it.key(), it.value());
+            } else if (existing->kind == Namespace) {
+                // A regular module anywhere beats namespace portions; portions merge
+                if (it->kind == Namespace) {
+                    existing->portions << it->portions;
+                } else {
+                    *existing = it.value();
+                }
+            }
+        }
+    }
+}
+
+bool PythonModuleIndex::lookup(const QString &directory, const QString &name, Entry *entry) const {
+    QReadLocker locker(&m_lock);
+    auto directoryIt = m_byDirectory.constFind(directory);
+    if (directoryIt == m_byDirectory.constEnd()) {
+        return false;
+    }
+    auto it = directoryIt->constFind(name);
+    if (it == directoryIt->constEnd()) {
+        return false;
+    }
+    *entry = it.value();
+    return true;
+}
+
+bool PythonModuleIndex::rescanIfChanged(const QString &directory) {
+    // One stat, the same check FileFinder makes before trusting its listing
+    qint64 modified = directoryMtime(directory);
+    {
+        QReadLocker locker(&m_lock);
+        auto it = m_scannedMtime.constFind(directory);
+        if (it != m_scannedMtime.constEnd() && it.value() == modified) {
+            return false;
+        }
+    }
+    rescanDirectory(directory);
+    return true;
+}
+
+bool PythonModuleIndex::install() {
+    if (m_specFromFileLocation) {
+        return true;
+    }
+
+    PyObject *util = PyImport_ImportModule("importlib.util");
+    PyObject *machinery = PyImport_ImportModule("importlib.machinery");
+    PyObject *types = PyImport_ImportModule("types");
+    PyObject *os = PyImport_ImportModule("os");
+    PyObject *specFromFileLocation = util ? PyObject_GetAttrString(util, "spec_from_file_location") : nullptr;
+    PyObject *moduleSpec = machinery ? PyObject_GetAttrString(machinery, "ModuleSpec") : nullptr;
+    PyObject *suffixes = machinery ? PyObject_GetAttrString(machinery, "EXTENSION_SUFFIXES") : nullptr;
+    PyObject *simpleNamespace = types ? PyObject_GetAttrString(types, "SimpleNamespace") : nullptr;
+    // '' on sys.path is the working directory, cached under os.getcwd()
+    PyObject *cwd = os ? PyObject_CallMethod(os, "getcwd", nullptr) : nullptr;
+    Py_XDECREF(util);
+    Py_XDECREF(machinery);
+    Py_XDECREF(types);
+    Py_XDECREF(os);
+
+    PyObject *sysPath = PySys_GetObject("path");
+    PyObject *importerCache = PySys_GetObject("path_importer_cache");
+    if (!specFromFileLocation || !moduleSpec || !suffixes || !simpleNamespace || !cwd
+        || !sysPath || !PyList_Check(sysPath) || !importerCache || !PyDict_Check(importerCache)) {
+        qDebug() << "Failed to install the module index finder";
+        PyErr_Print();
+        PyErr_Clear();
+        Py_XDECREF(specFromFileLocation);
+        Py_XDECREF(moduleSpec);
+        Py_XDECREF(suffixes);
+        Py_XDECREF(simpleNamespace);
+        Py_XDECREF(cwd);
+        return false;
+    }
+
+    m_specFromFileLocation = specFromFileLocation;
+    m_moduleSpec = moduleSpec;
+
+    // Extension modules are recognized by the interpreter's own suffixes
+    QStringList extensionSuffixes;
+    if (PyList_Check(suffixes)) {
+        for (Py_ssize_t i = 0; i < PyList_GET_SIZE(suffixes); ++i) {
+            const char *suffix = PyUnicode_AsUTF8(PyList_GET_ITEM(suffixes, i));
+            if (suffix) {
+                extensionSuffixes << QString::fromUtf8(suffix);
+            }
+        }
+    }
+    PyErr_Clear();
+    Py_DECREF(suffixes);
+
+    QStringList indexed;
+    {
+        QWriteLocker locker(&m_lock);
+        m_extensionSuffixes = extensionSuffixes;
+        indexed = m_directories;
+    }
+    setDirectories(indexed);
+
+    QHash<QString, PyObject *> finders;
+    for (const QString &directory : std::as_const(indexed)) {
+        if (PyObject *finder = createFinder(directory, simpleNamespace)) {
+            finders.insert(directory, finder);
+        }
+    }
+    Py_DECREF(simpleNamespace);
+
+    // Entries already on sys.path keep their place; the path finder now asks
+    // the index instead of probing them
+    QSet<QString> onPath;
+    for (Py_ssize_t i = 0; i < PyList_GET_SIZE(sysPath); ++i) {
+        PyObject *item = PyList_GET_ITEM(sysPath, i);
+        const char *entry = PyUnicode_Check(item) ? PyUnicode_AsUTF8(item) : nullptr;
+        if (!entry) {
+            continue;
+        }
+        PyObject *key = *entry ? item : cwd;
+        const char *keyPath = PyUnicode_AsUTF8(key);
+        QString directory = keyPath ? normalizedDirectory(QString::fromUtf8(keyPath)) : QString();
+        if (PyObject *finder = finders.value(directory)) {
+            PyDict_SetItem(importerCache, key, finder);
+            onPath.insert(directory);
+        }
+    }
+
+    // The rest go at the end, where addToPath would have put them
+    for (auto it = finders.cbegin(); it != finders.cend(); ++it) {
+        if (onPath.contains(it.key())) {
+            continue;
+        }
+        PyObject *item = unicode(QDir::toNativeSeparators(it.key()));
+        if (item && PyList_Append(sysPath, item) == 0) {
+            PyDict_SetItem(importerCache, item, it.value());
+        }
+        Py_XDECREF(item);
+    }
+    PyErr_Clear();
+
+    for (PyObject *finder : std::as_const(finders)) {
+        Py_DECREF(finder);
+    }
+    Py_DECREF(cwd);
+
+    qDebug() << "Module index installed:" << moduleCount() << "modules in" << finders.size() << "directories";
+    return true;
+}
+
+PyObject *PythonModuleIndex::createFinder(const QString &directory, PyObject *simpleNamespace) {
+    // A plain namespace object whose methods are builtins bound to this index
+    // and directory, shaped like the FileFinder it replaces
+    static PyMethodDef findSpecDef = {
+        "find_spec", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(&PythonModuleIndex::findSpecTrampoline)),
+        METH_VARARGS | METH_KEYWORDS,
+        "find_spec(fullname, target=None) -> spec from the ZoraPerl module index, or None."
+    };
+    static PyMethodDef iterModulesDef = {
+        "iter_modules", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(&PythonModuleIndex::iterModulesTrampoline)),
+        METH_VARARGS | METH_KEYWORDS,
+        "iter_modules(prefix='') -> [(name, ispkg)] for pkgutil."
+    };
+    static PyMethodDef invalidateCachesDef = {
+        "invalidate_caches", &PythonModuleIndex::invalidateCachesTrampoline, METH_NOARGS,
+        "invalidate_caches() -> rescan the directory on the next miss."
+    };
+
+    PyObject *capsule = PyCapsule_New(m_self, kCapsuleName, nullptr);
+    PyObject *path = unicode(directory);
+    PyObject *self = capsule && path ? PyTuple_Pack(2, capsule, path) : nullptr;
+    Py_XDECREF(capsule);
+
+    PyObject *finder = nullptr;
+    PyObject *findSpec = self ? PyCFunction_New(&findSpecDef, self) : nullptr;
+    PyObject *iterModules = self ? PyCFunction_New(&iterModulesDef, self) : nullptr;
+    PyObject *invalidateCaches = self ? PyCFunction_New(&invalidateCachesDef, self) : nullptr;
+    PyObject *kwargs = findSpec && iterModules && invalidateCaches ? PyDict_New() : nullptr;
+    PyObject *noArgs = kwargs ? PyTuple_New(0) : nullptr;
+    if (noArgs && PyDict_SetItemString(kwargs, "path", path) == 0
+        && PyDict_SetItemString(kwargs, "find_spec", findSpec) == 0
+        && PyDict_SetItemString(kwargs, "iter_modules", iterModules) == 0
+        && PyDict_SetItemString(kwargs, "invalidate_caches", invalidateCaches) == 0) {
+        finder = PyObject_Call(simpleNamespace, noArgs, kwargs);
+    }
+    Py_XDECREF(noArgs);
+    Py_XDECREF(kwargs);
+    Py_XDECREF(invalidateCaches);
+    Py_XDECREF(iterModules);
+    Py_XDECREF(findSpec);
+    Py_XDECREF(self);
+    Py_XDECREF(path);
+
+    if (!finder) {
+        qDebug() << "Failed to create the module index finder for" << directory;
+        PyErr_Clear();
+    }
+    return finder;
+}
+
+bool PythonModuleIndex::unpackSelf(PyObject *self, PythonModuleIndex **index, QString *directory) {
+    // self is the (capsule, directory) tuple the finder's methods are bound to
+    if (!PyTuple_Check(self) || PyTuple_GET_SIZE(self) != 2) {
+        PyErr_SetString(PyExc_TypeError, "module index finder is not bound");
+        return false;
+    }
+    auto *target = static_cast<std::atomic<PythonModuleIndex *> *>(
+        PyCapsule_GetPointer(PyTuple_GET_ITEM(self, 0), kCapsuleName));
+    const char *path = target ? PyUnicode_AsUTF8(PyTuple_GET_ITEM(self, 1)) : nullptr;
+    if (!path) {
+        return false;
+    }
+    *index = target->load();
+    *directory = QString::fromUtf8(path);
+    return true;
+}
+
+PyObject *PythonModuleIndex::findSpecTrampoline(PyObject *self, PyObject *args, PyObject *kwargs) {
+    PythonModuleIndex *index = nullptr;
+    QString directory;
+    if (!unpackSelf(self, &index, &directory)) {
+        return nullptr;
+    }
+    if (!index) {
+        Py_RETURN_NONE;
+    }
+    return index->findSpec(directory, args, kwargs);
+}
+
+PyObject *PythonModuleIndex::iterModulesTrampoline(PyObject *self, PyObject *args, PyObject *kwargs) {
+    PythonModuleIndex *index = nullptr;
+    QString directory;
+    if (!unpackSelf(self, &index, &directory)) {
+        return nullptr;
+    }
+    return index ? index->iterModules(directory, args, kwargs) : PyList_New(0);
+}
+
+PyObject *PythonModuleIndex::invalidateCachesTrampoline(PyObject *self, PyObject *) {
+    PythonModuleIndex *index = nullptr;
+    QString directory;
+    if (!unpackSelf(self, &index, &directory)) {
+        return nullptr;
+    }
+    if (index) {
+        index->invalidateCaches(directory);
+    }
+    Py_RETURN_NONE;
+}
+
+PyObject *PythonModuleIndex::findSpec(const QString &directory, PyObject *args, PyObject *kwargs) {
+    static const char *keywords[] = {"fullname", "target", nullptr};
+    PyObject *fullname = nullptr;
+    PyObject *target = Py_None;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "U|O:find_spec", const_cast<char **>(keywords),
+                                     &fullname, &target)) {
+        return nullptr;
+    }
+
+    // Like FileFinder, only the last component names something in this directory
+    const char *utf8 = PyUnicode_AsUTF8(fullname);
+    if (!utf8) {
+        return nullptr;
+    }
+    QString name = QString::fromUtf8(utf8);
+    name = name.mid(name.lastIndexOf(QLatin1Char('.')) + 1);
+
+    // A miss may be a module written since the last scan
+    Entry entry;
+    if (!lookup(directory, name, &entry) && !(rescanIfChanged(directory) && lookup(directory, name, &entry))) {
+        Py_RETURN_NONE;
+    }
+
+    PyObject *spec = nullptr;
+    PyObject *callArgs = nullptr;
+    PyObject *specKwargs = PyDict_New();
+    if (!specKwargs) {
+        return nullptr;
+    }
+
+    if (entry.kind == Namespace) {
+        // No loader: the path finder collects the portion and moves on
+        PyDict_SetItemString(specKwargs, "is_package", Py_True);
+        callArgs = Py_BuildValue("(OO)", fullname, Py_None);
+        spec = callArgs ? PyObject_Call(m_moduleSpec, callArgs, specKwargs) : nullptr;
+        PyObject *locations = spec ? PyObject_GetAttrString(spec, "submodule_search_locations") : nullptr;
+        for (const QString &portion : std::as_const(entry.portions)) {
+            PyObject *item = locations ? unicode(portion) : nullptr;
+            if (item) {
+                PyList_Append(locations, item);
+                Py_DECREF(item);
+            }
+        }
+        Py_XDECREF(locations);
+    } else {
+        PyObject *file = unicode(entry.path);
+        callArgs = file ? Py_BuildValue("(OO)", fullname, file) : nullptr;
+        Py_XDECREF(file);
+        if (entry.kind == Package) {
+            PyObject *packageDirectory = unicode(QFileInfo(entry.path).absolutePath());
+            PyObject *locations = packageDirectory ? Py_BuildValue("[O]", packageDirectory) : nullptr;
+            if (locations) {
+                PyDict_SetItemString(specKwargs, "submodule_search_locations", locations);
+            }
+            Py_XDECREF(locations);
+            Py_XDECREF(packageDirectory);
+        }
+        spec = callArgs ? PyObject_Call(m_specFromFileLocation, callArgs, specKwargs) : nullptr;
+    }
+
+    Py_XDECREF(callArgs);
+    Py_DECREF(specKwargs);
+    return spec;
+}
+
+PyObject *PythonModuleIndex::iterModules(const QString &directory, PyObject *args, PyObject *kwargs) {
+    static const char *keywords[] = {"prefix", nullptr};
+    const char *prefixUtf8 = "";
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|s:iter_modules", const_cast<char **>(keywords), &prefixUtf8)) {
+        return nullptr;
+    }
+    QString prefix = QString::fromUtf8(prefixUtf8);
+
+    rescanIfChanged(directory);
+    DirectoryEntries entries;
+    {
+        QReadLocker locker(&m_lock);
+        entries = m_byDirectory.value(directory);
+    }
+    QStringList names = entries.keys();
+    names.sort();
+
+    // pkgutil lists modules and regular packages, not namespace portions
+    PyObject *modules = PyList_New(0);
+    for (const QString &name : std::as_const(names)) {
+        Kind kind = entries.value(name).kind;
+        if (!modules || kind == Namespace) {
+            continue;
+        }
+        PyObject *item = Py_BuildValue("(NO)", unicode(prefix + name), kind == Package ? Py_True : Py_False);
+        if (!item || PyList_Append(modules, item) != 0) {
+            Py_XDECREF(item);
+            Py_CLEAR(modules);
+            break;
+        }
+        Py_DECREF(item);
+    }
+    return modules;
+}
+
+void PythonModuleIndex::invalidateCaches(const QString &directory) {
+    // importlib.invalidate_caches(): a file written within the mtime
+    // granularity would otherwise stay invisible until the watcher fires
+    QWriteLocker locker(&m_lock);
+    m_scannedMtime.remove(directory);
+}
@@ -0,0 +1,374 @@
+#include "python_output.h"
+#include <QElapsedTimer>
+#include <QThread>
+#include <QDebug>
+#include <cstdio>
+#include <cstring>
+
+// Undefine slots before including Python headers to avoid conflicts
+#ifdef slots
+#undef slots
+#endif
+
+// Include Python headers
+#include <Python.h>
+
+// Redefine slots for Qt after Python headers
+#ifndef slots
+#define slots Q_SLOTS
+#endif
+
+namespace {
+const qsizetype kDefaultCapacity = 1 << 20;
+const qsizetype kMinimumCapacity = 64 << 10;
+const int kReaderWaitMs = 100;
+
+// Every record is a header followed by the payload, wrapping at the ring end
+struct RecordHeader {
+    quint32 size;
+    quint8 stream;
+    quint8 reserved[3];
+};
+
+// --- Writer objects that stand in for sys.stdout and sys.stderr ---
+
+struct WriterObject {
+    PyObject_HEAD
+    int stream;
+};
+
+PyObject *g_writerType = nullptr;
+
+PythonOutputChunk::Stream writerStream(PyObject *self) {
+    return static_cast<PythonOutputChunk::Stream>(reinterpret_cast<WriterObject *>(self)->stream);
+}
+
+PyObject *writerWrite(PyObject *self, PyObject *text) {
+    if (!PyUnicode_Check(text)) {
+        PyErr_Format(PyExc_TypeError, "write() argument must be str, not %.100s", Py_TYPE(text)->tp_name);
+        return nullptr;
+    }
+
+    // Lone surrogates can't be UTF-8; write them escaped instead of failing
+    PyObject *encoded = nullptr;
+    Py_ssize_t size = 0;
+    const char *data = PyUnicode_AsUTF8AndSize(text, &size);
+    if (!data) {
+        PyErr_Clear();
+        encoded = PyUnicode_AsEncodedString(text, "utf-8", "backslashreplace");
+        if (!encoded) {
+            return nullptr;
+        }
+        data = PyBytes_AS_STRING(encoded);
+        size = PyBytes_GET_SIZE(encoded);
+    }
+
+    PythonOutputCapture &capture = PythonOutputCapture::instance();
+    PythonOutputChunk::Stream stream = writerStream(self);
+    if (!capture.tryWrite(stream, data, size)) {
+        // Waiting for the reader to make room must not hold the GIL
+        Py_BEGIN_ALLOW_THREADS
+        capture.write(stream, data, size);
+        Py_END_ALLOW_THREADS
+    }
+    Py_XDECREF(encoded);
+
+    return PyLong_FromSsize_t(PyUnicode_GetLength(text));
+}
+
+PyObject *writerFlush(PyObject *self, PyObject *) {
+    // The ring has no buffering of its own; the echo goes through C stdio
+    fflush(writerStream(self) == PythonOutputChunk::Stderr ? stderr : stdout);
+    Py_RETURN_NONE;
+}
+
+PyObject *writerFalse(PyObject *, PyObject *) {
+    Py_RETURN_FALSE;
+}
+
+PyObject *writerTrue(PyObject *, PyObject *) {
+    Py_RETURN_TRUE;
+}
+
+PyObject *writerEncoding(PyObject *, void *) {
+    return PyUnicode_FromString("utf-8");
+}
+
+PyObject *writerErrors(PyObject *self, void *) {
+    return PyUnicode_FromString(writerStream(self) == PythonOutputChunk::Stderr ? "backslashreplace" : "strict");
+}
+
+PyMethodDef g_writerMethods[] = {
+    {"write", writerWrite, METH_O, "Write a string to the ZoraPerl console."},
+    {"flush", writerFlush, METH_NOARGS, "Flush the echo to the process stream."},
+    {"isatty", writerFalse, METH_NOARGS, nullptr},
+    {"readable", writerFalse, METH_NOARGS, nullptr},
+    {"seekable", writerFalse, METH_NOARGS, nullptr},
+    {"writable", writerTrue, METH_NOARGS, nullptr},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+PyGetSetDef g_writerGetSet[] = {
+    {"encoding", writerEncoding, nullptr, nullptr, nullptr},
+    {"errors", writerErrors, nullptr, nullptr, nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}
+};
+
+PyType_Slot g_writerSlots[] = {
+    {Py_tp_methods, g_writerMethods},
+    {Py_tp_getset, g_writerGetSet},
+    {0, nullptr}
+};
+
+PyType_Spec g_writerSpec = {
+    "zoraperl.ConsoleWriter",
+    sizeof(WriterObject),
+    0,
+    Py_TPFLAGS_DEFAULT,
+    g_writerSlots
+};
+
+bool replaceStream(const char *name, PythonOutputChunk::Stream stream) {
+    // Whatever the old stream still buffers goes out before the swap
+    if (PyObject *old = PySys_GetObject(name)) {
+        PyObject *flushed = PyObject_CallMethod(old, "flush", nullptr);
+        Py_XDECREF(flushed);
+        PyErr_Clear();
+    }
+
+    PyObject *writer = PyType_GenericAlloc(reinterpret_cast<PyTypeObject *>(g_writerType), 0);
+    if (!writer) {
+        return false;
+    }
+    reinterpret_cast<WriterObject *>(writer)->stream = stream;
+    bool replaced = PySys_SetObject(name, writer) == 0;
+    Py_DECREF(writer);
+    return replaced;
+}
+
+qsizetype configuredCapacity() {
+    bool ok = false;
+    qsizetype requested = qEnvironmentVariableIntValue("ZORAPERL_PYTHON_OUTPUT_BUFFER", &ok);
+    if (!ok || requested <= 0) {
+        return kDefaultCapacity;
+    }
+    qsizetype capacity = kMinimumCapacity;
+    while (capacity < requested && capacity < (qsizetype(1) << 30)) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+}
+
+PythonOutputCapture &PythonOutputCapture::instance() {
+    static PythonOutputCapture capture;
+    return capture;
+}
+
+PythonOutputCapture::PythonOutputCapture()
+    : m_ring(configuredCapacity()), m_mask(m_ring.size() - 1), m_head(0), m_tail(0),
+      m_installed(false), m_echo(qEnvironmentVariable("ZORAPERL_PYTHON_ECHO") != "0"),
+      m_readers(0), m_readerThread(nullptr), m_dropped(0), m_droppedReported(0) {
+}
+
+bool PythonOutputCapture::install() {
+    if (m_installed) {
+        return true;
+    }
+
+    if (!g_writerType) {
+        g_writerType = PyType_FromSpec(&g_writerSpec);
+        if (!g_writerType) {
+            qDebug() << "Cannot create the console writer type";
+            PyErr_Clear();
+            return false;
+        }
+    }
+
+    if (!replaceStream("stdout", PythonOutputChunk::Stdout)
+        || !replaceStream("stderr", PythonOutputChunk::Stderr)) {
+        qDebug() << "Cannot redirect Python output to the console";
+        PyErr_Clear();
+        return false;
+    }
+
+    m_installed = true;
+    return true;
+}
+
+bool PythonOutputCapture::isInstalled() const {
+    return m_installed;
+}
+
+void PythonOutputCapture::write(PythonOutputChunk::Stream stream, const char *data, qsizetype size) {
+    if (m_echo) {
+        fwrite(data, 1, size, stream == PythonOutputChunk::Stderr ? stderr : stdout);
+    }
+
+    // Large writes go in pieces so each fits the ring with room to spare
+    const qsizetype maxPiece = qsizetype(m_ring.size() / 4) - qsizetype(sizeof(RecordHeader));
+    QElapsedTimer waited;
+
+    lockWriters();
+    while (size > 0) {
+        const qsizetype piece = qMin(size, maxPiece);
+        while (!append(stream, data, piece)) {
+            // Only worth waiting for a reader on another thread that is draining
+            if (!waited.isValid()) {
+                waited.start();
+            }
+            if (m_readers == 0 || m_readerThread == QThread::currentThreadId()
+                || waited.elapsed() >= kReaderWaitMs) {
+                m_dropped += size;
+                unlockWriters();
+                return;
+            }
+            QThread::msleep(1);
+        }
+        data += piece;
+        size -= piece;
+    }
+    unlockWriters();
+}
+
+bool PythonOutputCapture::tryWrite(PythonOutputChunk::Stream stream, const char *data, qsizetype size) {
+    if (size > qsizetype(m_ring.size() / 4) - qsizetype(sizeof(RecordHeader))) {
+        return false;
+    }
+    if (m_writerLock.test_and_set(std::memory_order_acquire)) {
+        return false;
+    }
+    bool written = append(stream, data, size);
+    unlockWriters();
+
+    if (written && m_echo) {
+        fwrite(data, 1, size, stream == PythonOutputChunk::Stderr ? stderr : stdout);
+    }
+    return written;
+}
+
+QList<PythonOutputChunk> PythonOutputCapture::drain(qsizetype maxBytes, quint64 *droppedBytes) {
+    QList<PythonOutputChunk> chunks;
+    for (;;) {
+        chunks.clear();
+        quint64 start = m_tail.load(std::memory_order_acquire);
+        if (readRecords(start, maxBytes, &chunks)) {
+            break;
+        }
+    }
+
+    if (droppedBytes) {
+        const quint64 dropped = m_dropped.load();
+        *droppedBytes = dropped - m_droppedReported;
+        m_droppedReported = dropped;
+    }
+    return chunks;
+}
+
+bool PythonOutputCapture::readRecords(quint64 start, qsizetype maxBytes, QList<PythonOutputChunk> *chunks) {
+    // A writer trimming scrollback just before this reader attached may move
+    // the tail and overwrite records while they are copied. It moves the tail
+    // before writing, so an unchanged tail at the end means the copy is good.
+    const quint64 head = m_head.load(std::memory_order_acquire);
+    quint64 tail = start;
+    qsizetype taken = 0;
+
+    while (tail < head && taken < maxBytes) {
+        RecordHeader header;
+        copyOut(tail, reinterpret_cast<char *>(&header), sizeof(header));
+        if (header.size > head - tail - sizeof(header)) {
+            // Torn; should the tail not have moved after all, skip the damage
+            if (m_tail.compare_exchange_strong(start, head)) {
+                chunks->clear();
+                return true;
+            }
+            return false;
+        }
+        const auto stream = static_cast<PythonOutputChunk::Stream>(header.stream);
+
+        // Consecutive writes to one stream come out as one chunk
+        if (chunks->isEmpty() || chunks->last().stream != stream) {
+            PythonOutputChunk chunk;
+            chunk.stream = stream;
+            chunks->append(chunk);
+        }
+        QByteArray &data = chunks->last().data;
+        const qsizetype offset = data.size();
+        data.resize(offset + header.size);
+        copyOut(tail + sizeof(header), data.data() + offset, header.size);
+
+        tail += sizeof(header) + header.size;
+        taken += header.size;
+    }
+    return m_tail.compare_exchange_strong(start, tail, std::memory_order_acq_rel);
+}
+
+void PythonOutputCapture::attachReader() {
+    m_readerThread = QThread::currentThreadId();
+    ++m_readers;
+}
+
+void PythonOutputCapture::detachReader() {
+    if (--m_readers == 0) {
+        m_readerThread = nullptr;
+    }
+}
+
+bool PythonOutputCapture::hasReader() const {
+    return m_readers > 0;
+}
+
+quint64 PythonOutputCapture::droppedBytes() const {
+    return m_dropped;
+}
+
+bool PythonOutputCapture::append(PythonOutputChunk::Stream stream, const char *data, qsizetype size) {
+    // Called with the writer lock held
+    const quint64 head = m_head.load(std::memory_order_relaxed);
+    const quint64 needed = sizeof(RecordHeader) + size;
+    quint64 tail = m_tail.load(std::memory_order_acquire);
+    while (head - tail + needed > m_ring.size()) {
+        if (m_readers > 0) {
+            return false;
+        }
+        // Nobody is reading, so the ring is scrollback: the oldest record
+        // makes room. The tail moves before its bytes are reused; a reader
+        // attaching meanwhile notices and reads again from the new tail.
+        RecordHeader oldest;
+        copyOut(tail, reinterpret_cast<char *>(&oldest), sizeof(oldest));
+        const quint64 next = tail + sizeof(oldest) + oldest.size;
+        if (m_tail.compare_exchange_strong(tail, next, std::memory_order_acq_rel)) {
+            tail = next;
+        }
+    }
+
+    RecordHeader header = {quint32(size), quint8(stream), {0, 0, 0}};
+    copyIn(head, reinterpret_cast<const char *>(&header), sizeof(header));
+    copyIn(head + sizeof(header), data, size);
+    m_head.store(head + needed, std::memory_order_release);
+    return true;
+}
+
+void PythonOutputCapture::copyIn(quint64 position, const char *data, qsizetype size) {
+    const qsizetype offset = qsizetype(position & m_mask);
+    const qsizetype first = qMin(size, qsizetype(m_ring.size()) - offset);
+    memcpy(m_ring.data() + offset, data, first);
+    memcpy(m_ring.data(), data + first, size - first);
+}
+
+void PythonOutputCapture::copyOut(quint64 position, char *data, qsizetype size) const {
+    const qsizetype offset = qsizetype(position & m_mask);
+    const qsizetype first = qMin(size, qsizetype(m_ring.size()) - offset);
+    memcpy(data, m_ring.data() + offset, first);
+    memcpy(data + first, m_ring.data(), size - first);
+}
+
+void PythonOutputCapture::lockWriters() {
+    while (m_writerLock.test_and_set(std::memory_order_acquire)) {
+        QThread::yieldCurrentThread();
+    }
+}
+
+void PythonOutputCapture::unlockWriters() {
+    m_writerLock.clear(std::memory_order_release);
+}
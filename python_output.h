@@ -0,0 +1,77 @@
+#ifndef PYTHON_OUTPUT_H
+#define PYTHON_OUTPUT_H
+
+#include <QByteArray>
+#include <QList>
+#include <QtGlobal>
+#include <atomic>
+#include <vector>
+
+struct PythonOutputChunk {
+    enum Stream : quint8 { Stdout, Stderr };
+
+    Stream stream = Stdout;
+    QByteArray data;    // UTF-8; a multi-byte character may span two chunks
+};
+
+// Replaces sys.stdout and sys.stderr of the main interpreter with writers
+// that copy into a bounded byte ring. Writers never take a lock the reader
+// holds: the reader (the console, on the GUI thread) only moves the read
+// position, so a script printing in a tight loop cannot stall the desktop.
+//
+// With no reader attached the ring is scrollback: the oldest output is
+// overwritten, so a console opened later shows the most recent output.
+// While a reader is attached a full ring makes the writer wait, with the GIL
+// released, for up to 100 ms; past that, output is dropped and counted.
+// Output is also echoed to the process's stdout/stderr as before
+// (ZORAPERL_PYTHON_ECHO=0 turns that off).
+class PythonOutputCapture {
+public:
+    static PythonOutputCapture &instance();
+
+    // With the GIL held, after the interpreter is initialized
+    bool install();
+    bool isInstalled() const;
+
+    // Any thread; data is UTF-8
+    void write(PythonOutputChunk::Stream stream, const char *data, qsizetype size);
+    // Same, but only if the ring has room right now; never waits
+    bool tryWrite(PythonOutputChunk::Stream stream, const char *data, qsizetype size);
+
+    // Reader side, one thread at a time. Takes whole chunks, up to about
+    // maxBytes, and the number of bytes dropped since the previous call.
+    QList<PythonOutputChunk> drain(qsizetype maxBytes, quint64 *droppedBytes = nullptr);
+    void attachReader();
+    void detachReader();
+    bool hasReader() const;
+
+    quint64 droppedBytes() const;
+
+private:
+    PythonOutputCapture();
+
+    bool append(PythonOutputChunk::Stream stream, const char *data, qsizetype size);
+    bool readRecords(quint64 start, qsizetype maxBytes, QList<PythonOutputChunk> *chunks);
+    void copyIn(quint64 position, const char *data, qsizetype size);
+    void copyOut(quint64 position, char *data, qsizetype size) const;
+    void lockWriters();
+    void unlockWriters();
+
+    std::vector<char> m_ring;
+    quint64 m_mask;
+    // Monotonic byte positions; m_head is written by writers, m_tail by the
+    // reader, or by writers trimming scrollback while there is none
+    std::atomic<quint64> m_head;
+    std::atomic<quint64> m_tail;
+    // Serializes writers only (several with free-threaded Python)
+    std::atomic_flag m_writerLock = ATOMIC_FLAG_INIT;
+
+    std::atomic<bool> m_installed;
+    std::atomic<bool> m_echo;
+    std::atomic<int> m_readers;
+    std::atomic<Qt::HANDLE> m_readerThread;
+    std::atomic<quint64> m_dropped;
+    quint64 m_droppedReported;
+};
+
+#endif // PYTHON_OUTPUT_H
@@ -0,0 +1,423 @@
+#include "python_profiler.h"
+#include <QMutexLocker>
+#include <QStringList>
+#include <QDebug>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+// Undefine slots before including Python headers to avoid conflicts
+#ifdef slots
+#undef slots
+#endif
+
+// Include Python headers
+#include <Python.h>
+#include <frameobject.h>
+
+// Redefine slots for Qt after Python headers
+#ifndef slots
+#define slots Q_SLOTS
+#endif
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+namespace {
+const char *kCapsuleName = "zoraperl.profiler";
+
+qint64 wallNow() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+qint64 threadCpuNow() {
+#ifdef Q_OS_WIN
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) {
+        return 0;
+    }
+    auto ticks = [](const FILETIME &time) {
+        return (static_cast<qint64>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+    };
+    return (ticks(kernel) + ticks(user)) * 100;
+#else
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return static_cast<qint64>(now.tv_sec) * 1000000000 + now.tv_nsec;
+#endif
+}
+
+// Blocks allocated by Python code on this thread, counted by the hooks below
+thread_local quint64 t_allocations = 0;
+
+struct ActiveFrame {
+    int function;
+    int node;
+    bool builtin;
+    qint64 wallStart;
+    qint64 cpuStart;
+    quint64 allocationStart;
+    qint64 childWall;
+    qint64 childCpu;
+    quint64 childAllocations;
+};
+
+struct ThreadProfile {
+    std::vector<ActiveFrame> stack;
+    std::vector<int> depth;     // active frames per function id, to count recursion once
+    bool hooked = false;
+};
+
+thread_local ThreadProfile t_profile;
+
+// --- allocation counting hooks, wrapping the PYMEM and OBJECT domains ---
+
+PyMemAllocatorEx g_originalAllocators[2];
+
+void *countingMalloc(void *context, size_t size) {
+    ++t_allocations;
+    auto *original = static_cast<PyMemAllocatorEx *>(context);
+    return original->malloc(original->ctx, size);
+}
+
+void *countingCalloc(void *context, size_t count, size_t size) {
+    ++t_allocations;
+    auto *original = static_cast<PyMemAllocatorEx *>(context);
+    return original->calloc(original->ctx, count, size);
+}
+
+void *countingRealloc(void *context, void *pointer, size_t size) {
+    if (!pointer) {
+        ++t_allocations;
+    }
+    auto *original = static_cast<PyMemAllocatorEx *>(context);
+    return original->realloc(original->ctx, pointer, size);
+}
+
+void countingFree(void *context, void *pointer) {
+    auto *original = static_cast<PyMemAllocatorEx *>(context);
+    original->free(original->ctx, pointer);
+}
+
+QString sanitized(QString name) {
+    // ';' separates frames in collapsed stacks
+    return name.replace(QLatin1Char(';'), QLatin1Char(','));
+}
+
+}
+
+QString pythonScriptLabel(const QString &kind, const QString &text) {
+    if (text.isEmpty()) {
+        return kind;
+    }
+    QString line = text.section(QLatin1Char('\n'), 0, 0).trimmed();
+    return kind + ": " + (line.size() > 60 ? line.left(57) + "..." : line);
+}
+
+PythonProfiler::PythonProfiler()
+    : m_enabled(false), m_capsule(nullptr) {
+}
+
+PythonProfiler::~PythonProfiler() {
+    // Python is never finalized; the capsule and code references stay valid
+}
+
+void PythonProfiler::setEnabled(bool enabled) {
+    m_enabled = enabled;
+    qDebug() << "Python profiling" << (enabled ? "enabled" : "disabled");
+}
+
+bool PythonProfiler::isEnabled() const {
+    return m_enabled;
+}
+
+void PythonProfiler::installAllocationHooks() {
+#ifndef Py_GIL_DISABLED
+    // Wrapping hooks may be installed after initialization; called with the
+    // GIL held, the first time a script is profiled
+    static bool installed = false;
+    if (installed) {
+        return;
+    }
+    installed = true;
+
+    const PyMemAllocatorDomain domains[2] = {PYMEM_DOMAIN_MEM, PYMEM_DOMAIN_OBJ};
+    for (int i = 0; i < 2; ++i) {
+        PyMem_GetAllocator(domains[i], &g_originalAllocators[i]);
+        PyMemAllocatorEx hook = {&g_originalAllocators[i], countingMalloc, countingCalloc, countingRealloc, countingFree};
+        PyMem_SetAllocator(domains[i], &hook);
+    }
+#endif
+}
+
+void PythonProfiler::beginScript(const QString &kind, const QString &text) {
+    if (!m_capsule) {
+        m_capsule = PyCapsule_New(this, kCapsuleName, nullptr);
+        if (!m_capsule) {
+            PyErr_Clear();
+            return;
+        }
+    }
+    installAllocationHooks();
+
+    if (!t_profile.hooked) {
+        PyEval_SetProfile(&PythonProfiler::profileCallback, m_capsule);
+        t_profile.hooked = true;
+    }
+
+    int script = functionId(sanitized(pythonScriptLabel(kind, text)), true);
+    push(script, false);
+}
+
+void PythonProfiler::endScript() {
+    // Frames left open by an exception unwind with the script
+    while (!t_profile.stack.empty()) {
+        pop();
+    }
+}
+
+void PythonProfiler::detachThread() {
+    if (t_profile.hooked && !m_enabled) {
+        PyEval_SetProfile(nullptr, nullptr);
+        t_profile.hooked = false;
+        t_profile.stack.clear();
+    }
+}
+
+int PythonProfiler::profileCallback(PyObject *self, struct _frame *frame, int what, PyObject *arg) {
+    auto *profiler = static_cast<PythonProfiler *>(PyCapsule_GetPointer(self, kCapsuleName));
+    if (!profiler || !profiler->m_enabled || t_profile.stack.empty()) {
+        return 0;
+    }
+
+    switch (what) {
+    case PyTrace_CALL: {
+        PyCodeObject *code = PyFrame_GetCode(frame);
+        profiler->push(profiler->codeFunctionId(reinterpret_cast<PyObject *>(code)), false);
+        Py_DECREF(code);
+        break;
+    }
+    case PyTrace_RETURN:
+        // Never pops the script frame itself
+        if (t_profile.stack.size() > 1 && !t_profile.stack.back().builtin) {
+            profiler->pop();
+        }
+        break;
+    case PyTrace_C_CALL:
+        if (PyCFunction_Check(arg)) {
+            profiler->push(profiler->builtinFunctionId(arg), true);
+        }
+        break;
+    case PyTrace_C_RETURN:
+    case PyTrace_C_EXCEPTION:
+        if (PyCFunction_Check(arg) && t_profile.stack.size() > 1 && t_profile.stack.back().builtin) {
+            profiler->pop();
+        }
+        break;
+    default:
+        break;
+    }
+    return 0;
+}
+
+int PythonProfiler::functionId(const QString &name, bool script) {
+    QMutexLocker locker(&m_mutex);
+    auto it = m_ids.constFind(name);
+    if (it != m_ids.constEnd()) {
+        return it.value();
+    }
+
+    int id = m_entries.size();
+    PythonProfileEntry entry;
+    entry.name = name;
+    m_entries.append(entry);
+    m_isScript.append(script);
+    m_ids.insert(name, id);
+    return id;
+}
+
+int PythonProfiler::codeFunctionId(PyObject *code) {
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_codeIds.constFind(code);
+        if (it != m_codeIds.constEnd()) {
+            return it.value();
+        }
+    }
+
+    // "qualname (file:line)"; the code object is kept alive so its address
+    // can't be reused by another function while it is cached
+    PyCodeObject *codeObject = reinterpret_cast<PyCodeObject *>(code);
+#if PY_VERSION_HEX >= 0x030B0000
+    PyObject *nameObject = codeObject->co_qualname;
+#else
+    PyObject *nameObject = codeObject->co_name;
+#endif
+    const char *name = PyUnicode_AsUTF8(nameObject);
+    const char *file = PyUnicode_AsUTF8(codeObject->co_filename);
+    PyErr_Clear();
+
+    QString label = QString("%1 (%2:%3)")
+                        .arg(QString::fromUtf8(name ? name : "?"),
+                             QString::fromUtf8(file ? file : "?"))
+                        .arg(codeObject->co_firstlineno);
+    int id = functionId(sanitized(label), false);
+
+    QMutexLocker locker(&m_mutex);
+    if (!m_codeIds.contains(code)) {
+        Py_INCREF(code);
+        m_codeIds.insert(code, id);
+    }
+    return id;
+}
+
+int PythonProfiler::builtinFunctionId(PyObject *function) {
+    const PyMethodDef *method = reinterpret_cast<PyCFunctionObject *>(function)->m_ml;
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_builtinIds.constFind(method);
+        if (it != m_builtinIds.constEnd()) {
+            return it.value();
+        }
+    }
+
+    // "module.name" for module functions, "type.name" for methods
+    QString owner = "builtins";
+    PyObject *self = PyCFunction_GET_SELF(function);
+    if (self && PyModule_Check(self)) {
+        const char *module = PyModule_GetName(self);
+        if (module) {
+            owner = QString::fromUtf8(module);
+        }
+    } else if (self) {
+        owner = QString::fromUtf8(Py_TYPE(self)->tp_name);
+    }
+    PyErr_Clear();
+
+    int id = functionId(sanitized(owner + "." + QString::fromUtf8(method->ml_name)), false);
+
+    QMutexLocker locker(&m_mutex);
+    m_builtinIds.insert(method, id);
+    return id;
+}
+
+int PythonProfiler::nodeId(int parent, int function) {
+    // Called with m_mutex held
+    QPair<int, int> key(parent, function);
+    auto it = m_nodeIds.constFind(key);
+    if (it != m_nodeIds.constEnd()) {
+        return it.value();
+    }
+    int id = m_nodes.size();
+    m_nodes.append(Node{parent, function, 0});
+    m_nodeIds.insert(key, id);
+    return id;
+}
+
+void PythonProfiler::push(int function, bool builtin) {
+    int parent = t_profile.stack.empty() ? -1 : t_profile.stack.back().node;
+    int node;
+    {
+        QMutexLocker locker(&m_mutex);
+        node = nodeId(parent, function);
+    }
+
+    if (static_cast<int>(t_profile.depth.size()) <= function) {
+        t_profile.depth.resize(function + 1, 0);
+    }
+    ++t_profile.depth[function];
+
+    t_profile.stack.push_back(ActiveFrame{function, node, builtin, wallNow(), threadCpuNow(), t_allocations, 0, 0, 0});
+}
+
+void PythonProfiler::pop() {
+    ActiveFrame frame = t_profile.stack.back();
+    t_profile.stack.pop_back();
+
+    qint64 wall = wallNow() - frame.wallStart;
+    qint64 cpu = threadCpuNow() - frame.cpuStart;
+    quint64 allocations = t_allocations - frame.allocationStart;
+    bool outermost = (--t_profile.depth[frame.function] == 0);
+
+    if (!t_profile.stack.empty()) {
+        ActiveFrame &parent = t_profile.stack.back();
+        parent.childWall += wall;
+        parent.childCpu += cpu;
+        parent.childAllocations += allocations;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    if (frame.function >= m_entries.size() || frame.node >= m_nodes.size()) {
+        // Started before a reset() from another thread
+        return;
+    }
+    PythonProfileEntry &entry = m_entries[frame.function];
+    ++entry.calls;
+    entry.selfWallNs += wall - frame.childWall;
+    entry.selfCpuNs += cpu - frame.childCpu;
+    entry.selfAllocations += allocations - frame.childAllocations;
+    if (outermost) {
+        entry.wallNs += wall;
+        entry.cpuNs += cpu;
+        entry.allocations += allocations;
+    }
+    m_nodes[frame.node].selfWallNs += wall - frame.childWall;
+}
+
+PythonProfileReport PythonProfiler::report() const {
+    PythonProfileReport report;
+    {
+        QMutexLocker locker(&m_mutex);
+        for (int i = 0; i < m_entries.size(); ++i) {
+            if (m_entries.at(i).calls == 0) {
+                continue;
+            }
+            (m_isScript.at(i) ? report.scripts : report.functions).append(m_entries.at(i));
+        }
+    }
+
+    auto bySelfTime = [](const PythonProfileEntry &a, const PythonProfileEntry &b) {
+        return a.selfWallNs > b.selfWallNs;
+    };
+    std::sort(report.scripts.begin(), report.scripts.end(), bySelfTime);
+    std::sort(report.functions.begin(), report.functions.end(), bySelfTime);
+    return report;
+}
+
+QString PythonProfiler::collapsedStacks() const {
+    QMutexLocker locker(&m_mutex);
+    QStringList lines;
+    for (int i = 0; i < m_nodes.size(); ++i) {
+        qint64 micros = m_nodes.at(i).selfWallNs / 1000;
+        if (micros <= 0) {
+            continue;
+        }
+
+        QStringList frames;
+        for (int current = i; current >= 0; current = m_nodes.at(current).parent) {
+            frames.prepend(m_entries.at(m_nodes.at(current).function).name);
+        }
+        lines << frames.join(QLatin1Char(';')) + " " + QString::number(micros);
+    }
+    return lines.join(QLatin1Char('\n')) + (lines.isEmpty() ? "" : "\n");
+}
+
+void PythonProfiler::reset() {
+    QMutexLocker locker(&m_mutex);
+    for (PyObject *code : m_codeIds.keys()) {
+        Py_DECREF(code);
+    }
+    m_codeIds.clear();
+    m_builtinIds.clear();
+    m_ids.clear();
+    m_entries.clear();
+    m_isScript.clear();
+    m_nodes.clear();
+    m_nodeIds.clear();
+    t_profile.stack.clear();
+    t_profile.depth.clear();
+}
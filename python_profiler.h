@@ -0,0 +1,109 @@
+#ifndef PYTHON_PROFILER_H
+#define PYTHON_PROFILER_H
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QPair>
+#include <QString>
+#include <atomic>
+
+// Same declaration as in Python.h, so this header does not need the Python headers
+typedef struct _object PyObject;
+
+struct PythonProfileEntry {
+    QString name;
+    quint64 calls = 0;
+    qint64 wallNs = 0;      // inclusive; recursive calls counted once
+    qint64 selfWallNs = 0;
+    qint64 cpuNs = 0;
+    qint64 selfCpuNs = 0;
+    quint64 allocations = 0;
+    quint64 selfAllocations = 0;
+};
+
+// "<string>: first line of source", "<expression>: 1 + 2" or a file name;
+// how profiles and memory accounting name a script
+QString pythonScriptLabel(const QString &kind, const QString &text);
+
+// Sorted by self wall time, most expensive first
+struct PythonProfileReport {
+    QList<PythonProfileEntry> scripts;
+    QList<PythonProfileEntry> functions;
+};
+
+// Opt-in profiler for code run through PythonManager, built on
+// PyEval_SetProfile: per script and per Python/builtin function wall time,
+// thread CPU time, call counts and allocation counts (allocations through
+// the Python allocators, counted by a hook that wraps them).
+class PythonProfiler {
+public:
+    PythonProfiler();
+    ~PythonProfiler();
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+
+    PythonProfileReport report() const;
+    // One "script;outer;inner <self microseconds>" line per stack, for flamegraph.pl
+    QString collapsedStacks() const;
+    // Needs the GIL
+    void reset();
+
+    // Around each script run, with the GIL held. kind is "<string>",
+    // "<expression>" or a file name; text is the source or expression.
+    void beginScript(const QString &kind, const QString &text);
+    void endScript();
+    // Removes the profile hook from this thread once profiling is off
+    void detachThread();
+
+private:
+    struct Node {
+        int parent;
+        int function;
+        qint64 selfWallNs;
+    };
+
+    int functionId(const QString &name, bool script);
+    int codeFunctionId(PyObject *code);
+    int builtinFunctionId(PyObject *function);
+    int nodeId(int parent, int function);
+    void push(int function, bool builtin);
+    void pop();
+    void installAllocationHooks();
+    static int profileCallback(PyObject *self, struct _frame *frame, int what, PyObject *arg);
+
+    std::atomic<bool> m_enabled;
+    PyObject *m_capsule;
+
+    mutable QMutex m_mutex;
+    QList<PythonProfileEntry> m_entries;
+    QList<bool> m_isScript;
+    QHash<QString, int> m_ids;
+    QHash<PyObject *, int> m_codeIds;
+    QHash<const void *, int> m_builtinIds;
+    QList<Node> m_nodes;
+    QHash<QPair<int, int>, int> m_nodeIds;
+};
+
+class PythonProfileScope {
+public:
+    PythonProfileScope(PythonProfiler &profiler, const QString &kind, const QString &text)
+        : m_profiler(profiler.isEnabled() ? &profiler : nullptr) {
+        if (m_profiler) {
+            m_profiler->beginScript(kind, text);
+        } else {
+            profiler.detachThread();
+        }
+    }
+    ~PythonProfileScope() {
+        if (m_profiler) {
+            m_profiler->endScript();
+        }
+    }
+
+private:
+    PythonProfiler *m_profiler;
+};
+
+#endif // PYTHON_PROFILER_H
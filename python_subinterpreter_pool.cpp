@@ -0,0 +1,275 @@
+#include "python_subinterpreter_pool.h"
+#include "python_variant.h"
+#include <QThread>
+#include <QSemaphore>
+#include <QPromise>
+#include <QMutexLocker>
+#include <QDebug>
+#include <atomic>
+#include <memory>
+
+// Undefine slots before including Python headers to avoid conflicts
+#ifdef slots
+#undef slots
+#endif
+
+// Include Python headers
+#include <Python.h>
+
+// Redefine slots for Qt after Python headers
+#ifndef slots
+#define slots Q_SLOTS
+#endif
+
+namespace {
+// Each pool thread runs one job at a time, so the channel of the running job
+// can live in a thread-local
+thread_local PythonPoolResult *t_currentResult = nullptr;
+
+PyObject *channelSend(PyObject *, PyObject *value) {
+    if (!t_currentResult) {
+        PyErr_SetString(PyExc_RuntimeError, "zoraperl_channel.send() called outside a pool job");
+        return nullptr;
+    }
+    t_currentResult->messages.append(pythonToVariant(value));
+    Py_RETURN_NONE;
+}
+
+PyMethodDef kChannelMethods[] = {
+    {"send", channelSend, METH_O, "Send a value back to the C++ caller of the running job."},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+// Creates zoraperl_channel in the current interpreter if it is not there yet
+bool installChannelModule() {
+    PyObject *modules = PyImport_GetModuleDict();
+    if (PyDict_GetItemString(modules, "zoraperl_channel")) {
+        return true;
+    }
+
+    PyObject *module = PyModule_New("zoraperl_channel");
+    if (!module) {
+        return false;
+    }
+
+    bool success = PyModule_AddFunctions(module, kChannelMethods) == 0
+                   && PyDict_SetItemString(modules, "zoraperl_channel", module) == 0;
+    Py_DECREF(module);
+    return success;
+}
+
+// Runs one script in a fresh namespace of the current interpreter. Needs the GIL.
+PythonPoolResult runScript(const QString &code) {
+    PythonPoolResult result;
+    if (!installChannelModule()) {
+        result.error = takePythonError();
+        return result;
+    }
+
+    t_currentResult = &result;
+
+    PyObject *globals = PyDict_New();
+    PyObject *compiled = nullptr;
+    PyObject *value = nullptr;
+    if (globals) {
+        PyDict_SetItemString(globals, "__builtins__", PyEval_GetBuiltins());
+        PyObject *name = PyUnicode_FromString("__main__");
+        if (name) {
+            PyDict_SetItemString(globals, "__name__", name);
+            Py_DECREF(name);
+        }
+        compiled = Py_CompileString(code.toUtf8().constData(), "<pool>", Py_file_input);
+    }
+    if (compiled) {
+        value = PyEval_EvalCode(compiled, globals, globals);
+    }
+
+    result.success = (value != nullptr);
+    if (!result.success) {
+        result.error = takePythonError();
+    }
+
+    Py_XDECREF(value);
+    Py_XDECREF(compiled);
+    Py_XDECREF(globals);
+
+    t_currentResult = nullptr;
+    return result;
+}
+}
+
+PythonSubinterpreterPool::PythonSubinterpreterPool(QObject *parent)
+    : QObject(parent), m_size(0), m_stopping(false) {
+}
+
+PythonSubinterpreterPool::~PythonSubinterpreterPool() {
+    stop();
+}
+
+bool PythonSubinterpreterPool::isSupported() {
+#if PY_VERSION_HEX >= 0x030C0000
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool PythonSubinterpreterPool::start(int size) {
+    if (!m_threads.isEmpty()) {
+        return true;
+    }
+    if (!isSupported() || !Py_IsInitialized() || size <= 0) {
+        return false;
+    }
+
+    qDebug() << "Starting subinterpreter pool with" << size << "interpreters";
+    m_stopping = false;
+
+    // Wait until every thread has tried to create its interpreter
+    QSemaphore ready;
+    std::atomic<int> created(0);
+
+    for (int i = 0; i < size; ++i) {
+        QThread *thread = QThread::create([this, &ready, &created]() {
+            workerLoop(&ready, &created);
+        });
+        thread->setObjectName(QString("python-subinterpreter-%1").arg(i));
+        m_threads.append(thread);
+        thread->start();
+    }
+
+    ready.acquire(size);
+
+    if (created == 0) {
+        qDebug() << "No subinterpreter could be created";
+        stop();
+        return false;
+    }
+
+    m_size = created;
+    qDebug() << "Subinterpreter pool ready:" << m_size << "of" << size;
+    return true;
+}
+
+void PythonSubinterpreterPool::stop() {
+    QList<Job> pending;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stopping = true;
+        while (!m_queue.isEmpty()) {
+            pending.append(m_queue.dequeue());
+        }
+        m_condition.wakeAll();
+    }
+
+    for (Job &job : pending) {
+        job.cancel();
+    }
+
+    for (QThread *thread : std::as_const(m_threads)) {
+        thread->wait();
+        delete thread;
+    }
+    m_threads.clear();
+    m_size = 0;
+}
+
+int PythonSubinterpreterPool::size() const {
+    return m_size;
+}
+
+QFuture<PythonPoolResult> PythonSubinterpreterPool::submit(const QString &code) {
+    auto promise = std::make_shared<QPromise<PythonPoolResult>>();
+    QFuture<PythonPoolResult> future = promise->future();
+    promise->start();
+
+    Job job;
+    job.code = code;
+    job.complete = [promise](const PythonPoolResult &result) {
+        promise->addResult(result);
+        promise->finish();
+    };
+    job.cancel = [promise]() {
+        promise->future().cancel();
+        promise->finish();
+    };
+
+    QMutexLocker locker(&m_mutex);
+    if (m_stopping || m_threads.isEmpty()) {
+        job.cancel();
+        return future;
+    }
+
+    m_queue.enqueue(std::move(job));
+    m_condition.wakeOne();
+    return future;
+}
+
+bool PythonSubinterpreterPool::takeJob(Job *job) {
+    QMutexLocker locker(&m_mutex);
+    while (m_queue.isEmpty() && !m_stopping) {
+        m_condition.wait(&m_mutex);
+    }
+    if (m_queue.isEmpty()) {
+        return false;
+    }
+    *job = m_queue.dequeue();
+    return true;
+}
+
+void PythonSubinterpreterPool::workerLoop(QSemaphore *ready, std::atomic<int> *created) {
+#if PY_VERSION_HEX >= 0x030C0000
+    // A main-interpreter thread state for this thread, needed to create the subinterpreter
+    PyThreadState *mainState = PyThreadState_New(PyInterpreterState_Main());
+    PyEval_RestoreThread(mainState);
+
+    PyInterpreterConfig config = {};
+    config.use_main_obmalloc = 0;
+    config.allow_fork = 0;
+    config.allow_exec = 0;
+    config.allow_threads = 1;
+    config.allow_daemon_threads = 0;
+    config.check_multi_interp_extensions = 1;
+    config.gil = PyInterpreterConfig_OWN_GIL;
+
+    // On success the main GIL is released and the new interpreter's GIL is held
+    PyThreadState *subState = nullptr;
+    PyStatus status = Py_NewInterpreterFromConfig(&subState, &config);
+    if (PyStatus_Exception(status) || !subState) {
+        qDebug() << "Failed to create subinterpreter:" << (status.err_msg ? status.err_msg : "unknown error");
+        PyThreadState_Clear(mainState);
+        PyThreadState_DeleteCurrent();
+        ready->release();
+        return;
+    }
+
+    installChannelModule();
+    ++*created;
+    ready->release();
+
+    // Only hold this interpreter's GIL while a job is running
+    PyEval_SaveThread();
+
+    Job job;
+    while (takeJob(&job)) {
+        PyEval_RestoreThread(subState);
+        PythonPoolResult result = runScript(job.code);
+        PyEval_SaveThread();
+        job.complete(result);
+    }
+
+    PyEval_RestoreThread(subState);
+    Py_EndInterpreter(subState);
+
+    PyEval_RestoreThread(mainState);
+    PyThreadState_Clear(mainState);
+    PyThreadState_DeleteCurrent();
+#else
+    Q_UNUSED(created);
+    ready->release();
+#endif
+}
+
+PythonPoolResult PythonSubinterpreterPool::runInCurrentInterpreter(const QString &code) {
+    return runScript(code);
+}
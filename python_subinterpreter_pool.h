@@ -0,0 +1,69 @@
+#ifndef PYTHON_SUBINTERPRETER_POOL_H
+#define PYTHON_SUBINTERPRETER_POOL_H
+
+#include <QObject>
+#include <QList>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QFuture>
+#include <QVariantList>
+#include <atomic>
+#include <functional>
+
+class QThread;
+class QSemaphore;
+
+struct PythonPoolResult {
+    bool success = false;
+    QString error;
+    // Values the script passed to zoraperl_channel.send(), in order
+    QVariantList messages;
+};
+
+// Pool of isolated subinterpreters, each with its own GIL and thread, so
+// independent scripts run in parallel across cores. Needs Python 3.12+.
+//
+// Scripts hand results back through a per-job channel: the module
+// zoraperl_channel is preloaded in every subinterpreter and send(value)
+// converts the value to a QVariant on the spot, so no Python object ever
+// crosses an interpreter boundary.
+class PythonSubinterpreterPool : public QObject {
+    Q_OBJECT
+
+public:
+    explicit PythonSubinterpreterPool(QObject *parent = nullptr);
+    ~PythonSubinterpreterPool();
+
+    static bool isSupported();
+
+    // The main interpreter must be initialized and its GIL released
+    bool start(int size);
+    void stop();
+    int size() const;
+
+    QFuture<PythonPoolResult> submit(const QString &code);
+
+    // Same job semantics in whatever interpreter holds the GIL on this thread;
+    // used as the fallback when subinterpreters are not available
+    static PythonPoolResult runInCurrentInterpreter(const QString &code);
+
+private:
+    struct Job {
+        QString code;
+        std::function<void(const PythonPoolResult &)> complete;
+        std::function<void()> cancel;
+    };
+
+    void workerLoop(QSemaphore *ready, std::atomic<int> *created);
+    bool takeJob(Job *job);
+
+    QList<QThread *> m_threads;
+    int m_size;
+    QMutex m_mutex;
+    QWaitCondition m_condition;
+    QQueue<Job> m_queue;
+    bool m_stopping;
+};
+
+#endif // PYTHON_SUBINTERPRETER_POOL_H
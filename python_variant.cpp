@@ -0,0 +1,188 @@
+#include "python_variant.h"
+#include <QVariantList>
+#include <QVariantMap>
+#include <QSet>
+
+// Undefine slots before including Python headers to avoid conflicts
+#ifdef slots
+#undef slots
+#endif
+
+// Include Python headers
+#include <Python.h>
+
+// Redefine slots for Qt after Python headers
+#ifndef slots
+#define slots Q_SLOTS
+#endif
+
+namespace {
+QString objectToString(PyObject *object) {
+    QString text;
+    PyObject *str = PyObject_Str(object);
+    if (str) {
+        const char *utf8 = PyUnicode_AsUTF8(str);
+        if (utf8) {
+            text = QString::fromUtf8(utf8);
+        }
+        Py_DECREF(str);
+    }
+    PyErr_Clear();
+    return text;
+}
+
+QString objectToRepr(PyObject *object) {
+    QString text;
+    PyObject *repr = PyObject_Repr(object);
+    if (repr) {
+        const char *utf8 = PyUnicode_AsUTF8(repr);
+        if (utf8) {
+            text = QString::fromUtf8(utf8);
+        }
+        Py_DECREF(repr);
+    }
+    PyErr_Clear();
+    return text;
+}
+
+// Deep enough for any real result, shallow enough for the C stack of every thread
+const int kMaxDepth = 100;
+
+QVariant convert(PyObject *object, int depth, QSet<PyObject *> &open);
+
+QVariant convertContainer(PyObject *object, int depth, QSet<PyObject *> &open) {
+    // A container inside itself comes out the way repr() writes it
+    if (open.contains(object)) {
+        return PyDict_Check(object) ? QString("{...}") : QString("[...]");
+    }
+    if (depth >= kMaxDepth) {
+        return objectToRepr(object);
+    }
+    open.insert(object);
+
+    QVariant converted;
+    if (PyDict_Check(object)) {
+        QVariantMap map;
+        PyObject *key = nullptr;
+        PyObject *value = nullptr;
+        Py_ssize_t position = 0;
+        while (PyDict_Next(object, &position, &key, &value)) {
+            // A str with lone surrogates has no UTF-8 form, and str() of it fails
+            // the same way; its repr escapes them
+            const char *utf8 = PyUnicode_Check(key) ? PyUnicode_AsUTF8(key) : nullptr;
+            QString name;
+            if (utf8) {
+                name = QString::fromUtf8(utf8);
+            } else if (PyUnicode_Check(key)) {
+                PyErr_Clear();
+                name = objectToRepr(key);
+            } else {
+                name = objectToString(key);
+            }
+            map.insert(name, convert(value, depth + 1, open));
+        }
+        converted = map;
+    } else {
+        PyObject *sequence = PySequence_Fast(object, "expected a sequence");
+        QVariantList list;
+        if (sequence) {
+            Py_ssize_t size = PySequence_Fast_GET_SIZE(sequence);
+            PyObject **items = PySequence_Fast_ITEMS(sequence);
+            list.reserve(size);
+            for (Py_ssize_t i = 0; i < size; ++i) {
+                list.append(convert(items[i], depth + 1, open));
+            }
+            Py_DECREF(sequence);
+        }
+        PyErr_Clear();
+        converted = list;
+    }
+
+    open.remove(object);
+    return converted;
+}
+
+QVariant convert(PyObject *object, int depth, QSet<PyObject *> &open) {
+    if (!object || object == Py_None) {
+        return QVariant();
+    }
+
+    // bool is a subclass of int, so it has to be checked first
+    if (PyBool_Check(object)) {
+        return QVariant(object == Py_True);
+    }
+
+    if (PyLong_Check(object)) {
+        int overflow = 0;
+        long long value = PyLong_AsLongLongAndOverflow(object, &overflow);
+        if (overflow == 0 && !(value == -1 && PyErr_Occurred())) {
+            return QVariant(static_cast<qlonglong>(value));
+        }
+        // Too large for 64 bits: keep the exact digits
+        PyErr_Clear();
+        return objectToString(object);
+    }
+
+    if (PyFloat_Check(object)) {
+        return QVariant(PyFloat_AS_DOUBLE(object));
+    }
+
+    if (PyUnicode_Check(object)) {
+        Py_ssize_t size = 0;
+        const char *utf8 = PyUnicode_AsUTF8AndSize(object, &size);
+        if (utf8) {
+            return QString::fromUtf8(utf8, size);
+        }
+        PyErr_Clear();
+        return QVariant();
+    }
+
+    if (PyBytes_Check(object)) {
+        return QByteArray(PyBytes_AS_STRING(object), PyBytes_GET_SIZE(object));
+    }
+
+    if (PyByteArray_Check(object)) {
+        return QByteArray(PyByteArray_AS_STRING(object), PyByteArray_GET_SIZE(object));
+    }
+
+    if (PyList_Check(object) || PyTuple_Check(object) || PyDict_Check(object)) {
+        return convertContainer(object, depth, open);
+    }
+
+    return objectToString(object);
+}
+}
+
+QVariant pythonToVariant(PyObject *object) {
+    QSet<PyObject *> open;
+    return convert(object, 0, open);
+}
+
+QString takePythonError() {
+    if (!PyErr_Occurred()) {
+        return QString();
+    }
+
+#if PY_VERSION_HEX >= 0x030C0000
+    // 3.12 keeps the exception normalized; the type/value/traceback triple is deprecated
+    PyObject *value = PyErr_GetRaisedException();
+    QString typeName = value ? QString::fromUtf8(Py_TYPE(value)->tp_name) : QString("Error");
+    QString message = value ? objectToString(value) : QString();
+    Py_XDECREF(value);
+#else
+    PyObject *type = nullptr;
+    PyObject *value = nullptr;
+    PyObject *traceback = nullptr;
+    PyErr_Fetch(&type, &value, &traceback);
+    PyErr_NormalizeException(&type, &value, &traceback);
+
+    QString typeName = type ? QString::fromUtf8(reinterpret_cast<PyTypeObject *>(type)->tp_name) : QString("Error");
+    QString message = value ? objectToString(value) : QString();
+
+    Py_XDECREF(type);
+    Py_XDECREF(value);
+    Py_XDECREF(traceback);
+#endif
+
+    return message.isEmpty() ? typeName : typeName + ": " + message;
+}
@@ -0,0 +1,19 @@
+#ifndef PYTHON_VARIANT_H
+#define PYTHON_VARIANT_H
+
+#include <QVariant>
+#include <QString>
+
+// Same declaration as in Python.h, so this header does not need the Python headers
+typedef struct _object PyObject;
+
+// Converts None/bool/int/float/str/bytes/list/tuple/dict into the matching
+// QVariant types in one pass. Anything else falls back to str(). A container
+// that contains itself becomes "[...]" or "{...}", and nesting past 100 levels
+// is returned as its repr() string. Needs the GIL.
+QVariant pythonToVariant(PyObject *object);
+
+// Formats and clears the current Python exception ("TypeError: ..."). Needs the GIL.
+QString takePythonError();
+
+#endif // PYTHON_VARIANT_H
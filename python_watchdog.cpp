@@ -0,0 +1,159 @@
+#include "python_watchdog.h"
+#include "python_worker.h"
+#include <QMutexLocker>
+#include <QDebug>
+
+namespace {
+const int kMaxOverruns = 64;
+
+int environmentMs(const char *name, int fallback) {
+    bool ok = false;
+    int value = qEnvironmentVariable(name).toInt(&ok);
+    return ok && value >= 0 ? value : fallback;
+}
+}
+
+PythonWatchdog::PythonWatchdog(PythonWorker *worker, QObject *parent)
+    : QThread(parent), m_worker(worker), m_stopping(false),
+      m_defaultTimeout(environmentMs("ZORAPERL_PYTHON_TIMEOUT_MS", 0)),
+      m_gracePeriod(environmentMs("ZORAPERL_PYTHON_TIMEOUT_GRACE_MS", 1000)),
+      m_jobId(0), m_timeoutMs(0), m_stage(0) {
+    setObjectName("python-watchdog");
+}
+
+PythonWatchdog::~PythonWatchdog() {
+    stop();
+}
+
+void PythonWatchdog::setDefaultTimeout(int ms) {
+    QMutexLocker locker(&m_mutex);
+    m_defaultTimeout = qMax(0, ms);
+}
+
+int PythonWatchdog::defaultTimeout() const {
+    QMutexLocker locker(&m_mutex);
+    return m_defaultTimeout;
+}
+
+void PythonWatchdog::setGracePeriod(int ms) {
+    QMutexLocker locker(&m_mutex);
+    m_gracePeriod = qMax(10, ms);
+    m_condition.wakeAll();
+}
+
+int PythonWatchdog::gracePeriod() const {
+    QMutexLocker locker(&m_mutex);
+    return m_gracePeriod;
+}
+
+QList<PythonOverrun> PythonWatchdog::overruns() const {
+    QMutexLocker locker(&m_mutex);
+    return m_overruns;
+}
+
+void PythonWatchdog::clearOverruns() {
+    QMutexLocker locker(&m_mutex);
+    m_overruns.clear();
+}
+
+void PythonWatchdog::watch(quint64 jobId, int timeoutMs, const QString &label) {
+    QMutexLocker locker(&m_mutex);
+    int timeout = timeoutMs < 0 ? m_defaultTimeout : timeoutMs;
+    if (timeout == 0 || m_stopping) {
+        return;
+    }
+
+    m_jobId = jobId;
+    m_label = label.isEmpty() ? QString("job %1").arg(jobId) : label;
+    m_timeoutMs = timeout;
+    m_stage = 0;
+    m_elapsed.start();
+
+    if (!isRunning()) {
+        start();
+    }
+    m_condition.wakeAll();
+}
+
+void PythonWatchdog::unwatch(quint64 jobId) {
+    QMutexLocker locker(&m_mutex);
+    if (m_jobId == jobId) {
+        m_jobId = 0;
+        m_condition.wakeAll();
+    }
+}
+
+void PythonWatchdog::stop() {
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stopping = true;
+        m_condition.wakeAll();
+    }
+    if (isRunning()) {
+        wait();
+    }
+}
+
+void PythonWatchdog::run() {
+    QMutexLocker locker(&m_mutex);
+    while (!m_stopping) {
+        if (m_jobId == 0) {
+            m_condition.wait(&m_mutex);
+            continue;
+        }
+
+        qint64 due = m_timeoutMs + qint64(m_stage) * m_gracePeriod;
+        qint64 elapsed = m_elapsed.elapsed();
+        if (elapsed < due) {
+            m_condition.wait(&m_mutex, QDeadlineTimer(due - elapsed));
+            continue;
+        }
+
+        PythonOverrun overrun;
+        overrun.jobId = m_jobId;
+        overrun.label = m_label;
+        overrun.timeoutMs = m_timeoutMs;
+        overrun.elapsedMs = elapsed;
+        overrun.stage = static_cast<PythonOverrun::Stage>(m_stage);
+        overrun.time = QDateTime::currentDateTime();
+
+        // Only the latest step of a job is kept
+        if (!m_overruns.isEmpty() && m_overruns.first().jobId == overrun.jobId) {
+            m_overruns.first() = overrun;
+        } else {
+            m_overruns.prepend(overrun);
+            while (m_overruns.size() > kMaxOverruns) {
+                m_overruns.removeLast();
+            }
+        }
+
+        if (++m_stage > PythonOverrun::Abandoned) {
+            m_jobId = 0;
+        }
+
+        locker.unlock();
+        escalate(overrun);
+        emit jobOverran(overrun);
+        locker.relock();
+    }
+}
+
+void PythonWatchdog::escalate(const PythonOverrun &overrun) {
+    switch (overrun.stage) {
+    case PythonOverrun::Interrupted:
+        qDebug() << "Python job" << overrun.label << "overran its" << overrun.timeoutMs
+                 << "ms deadline, interrupting";
+        m_worker->interrupt(overrun.jobId, PythonWorker::RaiseKeyboardInterrupt);
+        break;
+    case PythonOverrun::TimedOut:
+        qDebug() << "Python job" << overrun.label << "ignored KeyboardInterrupt after"
+                 << overrun.elapsedMs << "ms, raising TimeoutError";
+        m_worker->interrupt(overrun.jobId, PythonWorker::RaiseTimeoutError);
+        break;
+    case PythonOverrun::Abandoned:
+        qDebug() << "Python job" << overrun.label << "still running after"
+                 << overrun.elapsedMs << "ms, abandoning it";
+        m_worker->abandon(overrun.jobId);
+        break;
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef PYTHON_WATCHDOG_H
+#define PYTHON_WATCHDOG_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QDateTime>
+#include <QList>
+#include <QString>
+
+class PythonWorker;
+
+struct PythonOverrun {
+    enum Stage {
+        Interrupted,    // KeyboardInterrupt scheduled at the deadline
+        TimedOut,       // TimeoutError after the grace period, for scripts that swallowed the first
+        Abandoned       // still running after a second grace period; its caller was released and its thread replaced
+    };
+
+    quint64 jobId = 0;
+    QString label;
+    int timeoutMs = 0;
+    qint64 elapsedMs = 0;
+    Stage stage = Interrupted;
+    QDateTime time;
+};
+
+// Watches the job running on the interpreter thread. Past its deadline the
+// job gets KeyboardInterrupt, then TimeoutError, both through pending calls
+// so nothing here waits for the GIL; a job that still runs (typically stuck
+// in C code holding the GIL) is abandoned: the caller blocked on it,
+// usually the desktop, gets its fallback result instead of freezing, and the
+// worker moves the queue to a replacement thread.
+class PythonWatchdog : public QThread {
+    Q_OBJECT
+
+public:
+    explicit PythonWatchdog(PythonWorker *worker, QObject *parent = nullptr);
+    ~PythonWatchdog();
+
+    // Deadline for jobs submitted without their own; 0 disables it
+    void setDefaultTimeout(int ms);
+    int defaultTimeout() const;
+    // Time between escalation steps
+    void setGracePeriod(int ms);
+    int gracePeriod() const;
+
+    // Most recent first
+    QList<PythonOverrun> overruns() const;
+    void clearOverruns();
+
+    // Called by the worker around each job; timeoutMs -1 means the default
+    void watch(quint64 jobId, int timeoutMs, const QString &label);
+    void unwatch(quint64 jobId);
+
+    void stop();
+
+signals:
+    void jobOverran(const PythonOverrun &overrun);
+
+protected:
+    void run() override;
+
+private:
+    void escalate(const PythonOverrun &overrun);
+
+    PythonWorker *m_worker;
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_condition;
+    bool m_stopping;
+    int m_defaultTimeout;
+    int m_gracePeriod;
+
+    // The watched job; id 0 when nothing is watched
+    quint64 m_jobId;
+    QString m_label;
+    int m_timeoutMs;
+    int m_stage;
+    QElapsedTimer m_elapsed;
+
+    QList<PythonOverrun> m_overruns;
+};
+
+#endif // PYTHON_WATCHDOG_H
@@ -0,0 +1,310 @@
+#include "python_worker.h"
+#include "python_watchdog.h"
+#include <QMutexLocker>
+#include <QDebug>
+#include <thread>
+
+// Undefine slots before including Python headers to avoid conflicts
+#ifdef slots
+#undef slots
+#endif
+
+// Include Python headers
+#include <Python.h>
+
+// Redefine slots for Qt after Python headers
+#ifndef slots
+#define slots Q_SLOTS
+#endif
+
+namespace {
+// Stuck threads left behind before abandon() stops replacing them; a job
+// stuck in C code with the GIL held stalls every replacement as well
+const int kMaxRetiredThreads = 2;
+
+thread_local PythonWorker *t_servingWorker = nullptr;
+}
+
+PythonWorker::PythonWorker(QObject *parent)
+    : QThread(parent), m_stopping(false), m_nextJobId(1),
+      m_runningJobId(std::make_shared<std::atomic<quint64>>(0)), m_runningThreadId(0),
+      m_runningOnMainThread(true), m_cancelRequestedId(0), m_interruptException(RaiseKeyboardInterrupt),
+      m_abandonedJobId(0), m_watchdog(nullptr), m_generation(0), m_servingThread(this) {
+    setObjectName("python-interpreter");
+}
+
+PythonWorker::~PythonWorker() {
+    stop();
+}
+
+quint64 PythonWorker::enqueue(std::function<void()> run, std::function<void()> cancel,
+                              const QString &label, int timeoutMs) {
+    QMutexLocker locker(&m_mutex);
+
+    Job job;
+    job.id = m_nextJobId++;
+    job.run = std::move(run);
+    job.cancel = std::move(cancel);
+    job.label = label;
+    job.timeoutMs = timeoutMs;
+
+    quint64 id = job.id;
+    if (m_stopping) {
+        job.cancel();
+        return id;
+    }
+
+    // Nothing queued would run before the abandoned job returns
+    if (isWedged()) {
+        qDebug() << "Python interpreter is stuck in job" << m_abandonedJobId.load() << ", refusing job" << id;
+        job.cancel();
+        return id;
+    }
+
+    m_queue.enqueue(std::move(job));
+    m_condition.wakeOne();
+
+    if (m_servingThread == this && !isRunning()) {
+        start();
+    }
+
+    return id;
+}
+
+bool PythonWorker::cancel(quint64 jobId) {
+    QMutexLocker locker(&m_mutex);
+
+    for (int i = 0; i < m_queue.size(); ++i) {
+        if (m_queue.at(i).id == jobId) {
+            Job job = m_queue.takeAt(i);
+            locker.unlock();
+            job.cancel();
+            qDebug() << "Cancelled queued Python job" << jobId;
+            return true;
+        }
+    }
+
+    locker.unlock();
+    return interrupt(jobId, RaiseKeyboardInterrupt);
+}
+
+bool PythonWorker::interrupt(quint64 jobId, Interrupt exception) {
+    if (jobId == 0 || *m_runningJobId != jobId || !Py_IsInitialized()) {
+        return false;
+    }
+
+    if (!m_runningOnMainThread) {
+        return interruptReplacement(jobId, exception);
+    }
+
+    // Runs on the interpreter thread at the next bytecode boundary; the job id
+    // check there keeps a late call from hitting the job that runs after this one
+    m_interruptException = exception;
+    m_cancelRequestedId = jobId;
+    if (Py_AddPendingCall(&PythonWorker::interruptPendingCall, this) != 0) {
+        qDebug() << "Failed to schedule interrupt for Python job" << jobId;
+        return false;
+    }
+
+    qDebug() << "Interrupting running Python job" << jobId;
+    return true;
+}
+
+bool PythonWorker::interruptReplacement(quint64 jobId, Interrupt exception) {
+    // Pending calls only reach Python's main thread. Setting the exception
+    // directly needs the GIL, so a helper waits for it and the watchdog never
+    // blocks; the job id is checked with the GIL held, before the next job on
+    // that thread can have a thread state to hit
+    std::shared_ptr<std::atomic<quint64>> running = m_runningJobId;
+    unsigned long threadId = m_runningThreadId;
+    std::thread([running, jobId, threadId, exception]() {
+        PyGILState_STATE gstate = PyGILState_Ensure();
+        if (*running == jobId) {
+            PyThreadState_SetAsyncExc(threadId, exception == RaiseTimeoutError
+                                                    ? PyExc_TimeoutError : PyExc_KeyboardInterrupt);
+        }
+        PyGILState_Release(gstate);
+    }).detach();
+
+    qDebug() << "Interrupting running Python job" << jobId << "on a replacement interpreter thread";
+    return true;
+}
+
+int PythonWorker::interruptPendingCall(void *worker) {
+    PythonWorker *self = static_cast<PythonWorker *>(worker);
+    quint64 running = *self->m_runningJobId;
+    if (running != 0 && running == self->m_cancelRequestedId) {
+        if (self->m_interruptException == RaiseTimeoutError) {
+            PyErr_SetString(PyExc_TimeoutError, "Python job exceeded its time limit");
+        } else {
+            PyErr_SetString(PyExc_KeyboardInterrupt, "Python job cancelled");
+        }
+        return -1;
+    }
+    return 0;
+}
+
+bool PythonWorker::abandon(quint64 jobId) {
+    std::function<void()> cancelRunning;
+    bool replaced = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (jobId == 0 || *m_runningJobId != jobId) {
+            return false;
+        }
+        cancelRunning = m_runningCancel;
+
+        for (int i = m_retiredThreads.size() - 1; i >= 0; --i) {
+            QThread *thread = m_retiredThreads.at(i);
+            if (thread->isFinished()) {
+                m_retiredThreads.removeAt(i);
+                if (thread != this) {
+                    delete thread;
+                }
+            }
+        }
+
+        // The stuck thread keeps the job and retires when it returns; it still
+        // takes the GIL in turns, so replacement jobs run slower until then
+        if (!m_stopping && Py_IsInitialized() && m_retiredThreads.size() < kMaxRetiredThreads) {
+            int generation = ++m_generation;
+            m_retiredThreads.append(m_servingThread);
+            *m_runningJobId = 0;
+            m_cancelRequestedId = 0;
+            m_runningCancel = nullptr;
+
+            m_servingThread = QThread::create([this, generation]() { serve(generation); });
+            m_servingThread->setObjectName(QString("python-interpreter-%1").arg(generation));
+            m_servingThread->start();
+            replaced = true;
+        } else {
+            m_abandonedJobId = jobId;
+        }
+    }
+
+    // Callers blocked on the future return; whatever the job produces later is dropped
+    if (cancelRunning) {
+        cancelRunning();
+    }
+    if (replaced) {
+        qDebug() << "Abandoned Python job" << jobId << "- its thread was replaced";
+    } else {
+        qDebug() << "Abandoned Python job" << jobId << "- interpreter thread unavailable until it returns";
+    }
+    return true;
+}
+
+bool PythonWorker::isWedged() const {
+    quint64 abandoned = m_abandonedJobId;
+    return abandoned != 0 && abandoned == *m_runningJobId;
+}
+
+void PythonWorker::setWatchdog(PythonWatchdog *watchdog) {
+    QMutexLocker locker(&m_mutex);
+    m_watchdog = watchdog;
+}
+
+quint64 PythonWorker::currentJobId() const {
+    return *m_runningJobId;
+}
+
+bool PythonWorker::isCurrentThread() const {
+    // Retired threads count too: their job may still call back in
+    return t_servingWorker == this;
+}
+
+void PythonWorker::stop() {
+    QList<Job> pending;
+    QList<QThread *> threads;
+    QThread *serving = nullptr;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stopping = true;
+        while (!m_queue.isEmpty()) {
+            pending.append(m_queue.dequeue());
+        }
+        serving = m_servingThread;
+        threads = m_retiredThreads;
+        threads.append(serving);
+        m_retiredThreads.clear();
+        m_servingThread = this;
+        m_condition.wakeAll();
+    }
+
+    for (Job &job : pending) {
+        job.cancel();
+    }
+
+    for (QThread *thread : threads) {
+        if (thread == QThread::currentThread()) {
+            continue;
+        }
+        if (thread->isRunning()) {
+            // An abandoned job may never return; don't let it hang shutdown
+            while (!thread->wait(500)) {
+                if (thread != serving || isWedged()) {
+                    qDebug() << "Terminating interpreter thread" << thread->objectName()
+                             << "stuck in an abandoned Python job";
+                    thread->terminate();
+                    thread->wait();
+                    break;
+                }
+            }
+        }
+        if (thread != this) {
+            delete thread;
+        }
+    }
+}
+
+void PythonWorker::run() {
+    serve(0);
+}
+
+void PythonWorker::serve(int generation) {
+    t_servingWorker = this;
+    forever {
+        Job job;
+        PythonWatchdog *watchdog = nullptr;
+        {
+            QMutexLocker locker(&m_mutex);
+            while (m_queue.isEmpty() && !m_stopping && m_generation == generation) {
+                m_condition.wait(&m_mutex);
+            }
+            if (m_queue.isEmpty() || m_generation != generation) {
+                return;
+            }
+            job = m_queue.dequeue();
+            *m_runningJobId = job.id;
+            m_runningThreadId = PyThread_get_thread_ident();
+            m_runningOnMainThread = QThread::currentThread() == this;
+            m_runningCancel = job.cancel;
+            watchdog = m_watchdog;
+        }
+
+        if (watchdog) {
+            watchdog->watch(job.id, job.timeoutMs, job.label);
+        }
+
+        job.run();
+
+        if (watchdog) {
+            watchdog->unwatch(job.id);
+        }
+
+        {
+            QMutexLocker locker(&m_mutex);
+            if (m_generation != generation) {
+                qDebug() << "Abandoned Python job" << job.id << "returned, retiring its replaced thread";
+                return;
+            }
+            *m_runningJobId = 0;
+            m_cancelRequestedId = 0;
+            m_runningCancel = nullptr;
+            if (m_abandonedJobId == job.id) {
+                qDebug() << "Abandoned Python job" << job.id << "returned, interpreter thread available again";
+                m_abandonedJobId = 0;
+            }
+        }
+    }
+}
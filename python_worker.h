@@ -0,0 +1,125 @@
+#ifndef PYTHON_WORKER_H
+#define PYTHON_WORKER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QList>
+#include <QFuture>
+#include <QPromise>
+#include <QString>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+// The interpreter thread. Python is initialized by the first job, so this is
+// Python's main thread and receives pending calls; every job after that runs
+// here in submission order. Callers get a QFuture and never touch the GIL.
+//
+// A job abandoned by the watchdog keeps the thread it runs on, so a
+// replacement thread takes over the queue and the stuck thread retires when
+// its job finally returns. Replacements are not Python's main thread; their
+// jobs are interrupted with PyThreadState_SetAsyncExc instead.
+class PythonWatchdog;
+
+class PythonWorker : public QThread {
+    Q_OBJECT
+
+public:
+    enum Interrupt { RaiseKeyboardInterrupt, RaiseTimeoutError };
+
+    explicit PythonWorker(QObject *parent = nullptr);
+    ~PythonWorker();
+
+    // Queues a task; the returned future is canceled if the job never runs.
+    // With a watchdog attached, timeoutMs bounds the run time (-1: the
+    // watchdog's default, 0: unbounded); label names the job in overrun reports.
+    template <typename T>
+    QFuture<T> submit(std::function<T()> task, quint64 *jobId = nullptr,
+                      const QString &label = QString(), int timeoutMs = -1);
+
+    // Drops a queued job, or interrupts a running one with KeyboardInterrupt
+    bool cancel(quint64 jobId);
+    bool interrupt(quint64 jobId, Interrupt exception);
+
+    // Gives up on a running job that ignores interrupts: its future is
+    // canceled and a replacement thread serves the queue. With too many
+    // stuck threads already, or before Python is up, new jobs are refused
+    // until the job finally returns instead.
+    bool abandon(quint64 jobId);
+    bool isWedged() const;
+
+    void setWatchdog(PythonWatchdog *watchdog);
+
+    quint64 currentJobId() const;
+    bool isCurrentThread() const;
+    void stop();
+
+protected:
+    void run() override;
+
+private:
+    struct Job {
+        quint64 id = 0;
+        std::function<void()> run;
+        std::function<void()> cancel;
+        QString label;
+        int timeoutMs = -1;
+    };
+
+    quint64 enqueue(std::function<void()> run, std::function<void()> cancel,
+                    const QString &label, int timeoutMs);
+    void serve(int generation);
+    bool interruptReplacement(quint64 jobId, Interrupt exception);
+    static int interruptPendingCall(void *worker);
+
+    QMutex m_mutex;
+    QWaitCondition m_condition;
+    QQueue<Job> m_queue;
+    bool m_stopping;
+    quint64 m_nextJobId;
+    // Shared with interrupt helpers, which may outlive the worker
+    std::shared_ptr<std::atomic<quint64>> m_runningJobId;
+    std::atomic<unsigned long> m_runningThreadId;
+    std::atomic<bool> m_runningOnMainThread;
+    std::atomic<quint64> m_cancelRequestedId;
+    std::atomic<int> m_interruptException;
+    std::atomic<quint64> m_abandonedJobId;
+    std::function<void()> m_runningCancel;
+    PythonWatchdog *m_watchdog;
+
+    // The thread serving the queue (this until a job is abandoned) and the
+    // stuck threads it replaced
+    int m_generation;
+    QThread *m_servingThread;
+    QList<QThread *> m_retiredThreads;
+};
+
+template <typename T>
+QFuture<T> PythonWorker::submit(std::function<T()> task, quint64 *jobId, const QString &label, int timeoutMs) {
+    auto promise = std::make_shared<QPromise<T>>();
+    QFuture<T> future = promise->future();
+
+    quint64 id = enqueue(
+        [promise, task]() {
+            promise->start();
+            if (!promise->isCanceled()) {
+                promise->addResult(task());
+            }
+            promise->finish();
+        },
+        [promise]() {
+            promise->start();
+            promise->future().cancel();
+            promise->finish();
+        },
+        label, timeoutMs);
+
+    if (jobId) {
+        *jobId = id;
+    }
+    return future;
+}
+
+#endif // PYTHON_WORKER_H
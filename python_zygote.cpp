@@ -0,0 +1,747 @@
+#include "python_zygote.h"
+#include "python_manager.h"
+#include "python_variant.h"
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QProcess>
+#include <QThread>
+#include <QDebug>
+#include <atomic>
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <csignal>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// Undefine slots before including Python headers to avoid conflicts
+#ifdef slots
+#undef slots
+#endif
+
+// Include Python headers
+#include <Python.h>
+
+// Redefine slots for Qt after Python headers
+#ifndef slots
+#define slots Q_SLOTS
+#endif
+
+namespace {
+const quint32 kRingMagic = 0x5a595254;  // "ZYRT"
+
+enum SlotState : quint32 { SlotFree, SlotReady };
+
+struct RingHeader {
+    quint32 magic;
+    quint32 slotCount;
+    quint32 slotBytes;
+    quint32 reserved;
+};
+
+// Followed by slotBytes of serialized PythonPoolResult
+struct SlotHeader {
+    std::atomic<quint32> state;
+    quint32 length;
+    quint64 jobId;
+};
+static_assert(sizeof(SlotHeader) == 16, "slot header must keep the payload 16-byte aligned");
+
+SlotHeader *ringSlot(void *ring, int index) {
+    RingHeader *header = static_cast<RingHeader *>(ring);
+    char *base = static_cast<char *>(ring) + sizeof(RingHeader);
+    return reinterpret_cast<SlotHeader *>(base + size_t(index) * (sizeof(SlotHeader) + header->slotBytes));
+}
+
+char *slotPayload(SlotHeader *slot) {
+    return reinterpret_cast<char *>(slot + 1);
+}
+
+QByteArray serializeResult(const PythonPoolResult &result) {
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream << result.success << result.error << result.messages;
+    return payload;
+}
+
+PythonPoolResult deserializeResult(const char *data, int length) {
+    PythonPoolResult result;
+    QDataStream stream(QByteArray::fromRawData(data, length));
+    stream >> result.success >> result.error >> result.messages;
+    if (stream.status() != QDataStream::Ok) {
+        result = PythonPoolResult();
+        result.error = "Error: corrupt result from forked Python worker";
+    }
+    return result;
+}
+
+#ifdef Q_OS_UNIX
+void writeLine(int fd, const QByteArray &line) {
+    QByteArray data = line + '\n';
+    // Lines are far below PIPE_BUF, so a line is never split
+    while (::write(fd, data.constData(), data.size()) < 0 && errno == EINTR) {
+    }
+}
+
+void flushPythonStream(const char *name) {
+    PyObject *stream = PySys_GetObject(name);
+    if (stream) {
+        PyObject *result = PyObject_CallMethod(stream, "flush", nullptr);
+        Py_XDECREF(result);
+    }
+    PyErr_Clear();
+}
+
+void preloadModules() {
+    QString preload = qEnvironmentVariable("ZORAPERL_ZYGOTE_PRELOAD",
+                                           "json,re,math,collections,functools,itertools,datetime");
+    for (const QString &name : preload.split(',', Qt::SkipEmptyParts)) {
+        PyObject *module = PyImport_ImportModule(name.trimmed().toUtf8().constData());
+        if (!module) {
+            qDebug() << "Zygote failed to preload" << name << ":" << takePythonError();
+        }
+        Py_XDECREF(module);
+    }
+
+    // Everything allocated so far moves to the permanent generation, so the
+    // collector in a child never touches (and un-shares) those pages
+    PyObject *gc = PyImport_ImportModule("gc");
+    PyObject *collected = gc ? PyObject_CallMethod(gc, "collect", nullptr) : nullptr;
+    PyObject *frozen = gc ? PyObject_CallMethod(gc, "freeze", nullptr) : nullptr;
+    if (!frozen) {
+        qDebug() << "Zygote could not freeze the heap:" << takePythonError();
+    }
+    Py_XDECREF(frozen);
+    Py_XDECREF(collected);
+    Py_XDECREF(gc);
+}
+
+// A forked script, as the zygote tracks it
+struct ChildJob {
+    quint64 jobId = 0;
+    int slot = -1;
+    int resultFd = -1;      // read end of the child's private result pipe
+    QByteArray result;      // length-prefixed serialized PythonPoolResult
+    bool overflow = false;
+    qint64 deadline = 0;    // on the zygote's clock; 0 means none
+    int timeoutMs = 0;
+    bool killed = false;
+};
+
+// In the forked child: run, send the result back and exit without unwinding.
+// The child holds nothing but its own pipe: the ring, the request pipe and
+// the protocol fd are gone before the script starts.
+[[noreturn]] void runChild(int resultFd, quint32 slotBytes, const QByteArray &code) {
+    PythonPoolResult result = PythonSubinterpreterPool::runInCurrentInterpreter(QString::fromUtf8(code));
+    flushPythonStream("stdout");
+    flushPythonStream("stderr");
+
+    QByteArray payload = serializeResult(result);
+    if (payload.size() > qsizetype(slotBytes)) {
+        PythonPoolResult tooLarge;
+        tooLarge.error = QString("Error: script result exceeds %1 bytes").arg(slotBytes);
+        payload = serializeResult(tooLarge);
+    }
+
+    quint32 length = payload.size();
+    QByteArray message(reinterpret_cast<const char *>(&length), sizeof(length));
+    message += payload;
+    const char *data = message.constData();
+    qsizetype remaining = message.size();
+    while (remaining > 0) {
+        ssize_t written = ::write(resultFd, data, remaining);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            _exit(1);
+        }
+        data += written;
+        remaining -= written;
+    }
+    _exit(0);
+}
+
+void isolateChild(void *ring, size_t ringBytes, int protocolFd, const QHash<pid_t, ChildJob> &children) {
+    // Other jobs' source arrives on stdin and their results on the other pipes
+    int devNull = ::open("/dev/null", O_RDONLY);
+    if (devNull >= 0) {
+        dup2(devNull, STDIN_FILENO);
+        ::close(devNull);
+    } else {
+        ::close(STDIN_FILENO);
+    }
+    ::close(protocolFd);
+    for (const ChildJob &job : children) {
+        if (job.resultFd >= 0) {
+            ::close(job.resultFd);
+        }
+    }
+    // The shared-memory object is unlinked and its fd closed, so this can't be undone
+    munmap(ring, ringBytes);
+}
+
+void readResult(ChildJob &job, quint32 slotBytes) {
+    char buffer[16384];
+    forever {
+        ssize_t count = ::read(job.resultFd, buffer, sizeof(buffer));
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count == 0) {
+            ::close(job.resultFd);
+            job.resultFd = -1;
+            return;
+        }
+        if (count < 0) {
+            return;     // EAGAIN: the rest comes later
+        }
+        // Keep draining so the child can't block, but never buffer past one slot
+        if (job.result.size() + count > qsizetype(sizeof(quint32) + slotBytes)) {
+            job.overflow = true;
+        } else {
+            job.result.append(buffer, count);
+        }
+    }
+}
+
+// Copies a well-formed result into the job's slot; the child itself never sees the ring
+bool publishResult(void *ring, const ChildJob &job) {
+    RingHeader *header = static_cast<RingHeader *>(ring);
+    if (job.overflow || job.result.size() < qsizetype(sizeof(quint32))) {
+        return false;
+    }
+    quint32 length;
+    memcpy(&length, job.result.constData(), sizeof(length));
+    if (length > header->slotBytes || qsizetype(sizeof(length) + length) != job.result.size()) {
+        return false;
+    }
+
+    SlotHeader *slot = ringSlot(ring, job.slot);
+    memcpy(slotPayload(slot), job.result.constData() + sizeof(length), length);
+    slot->length = length;
+    slot->jobId = job.jobId;
+    slot->state.store(SlotReady, std::memory_order_release);
+    return true;
+}
+
+void reapChildren(QHash<pid_t, ChildJob> &children, void *ring, int protocolFd) {
+    RingHeader *header = static_cast<RingHeader *>(ring);
+    int status = 0;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        auto it = children.find(pid);
+        if (it == children.end()) {
+            continue;
+        }
+        ChildJob job = it.value();
+        children.erase(it);
+
+        if (job.resultFd >= 0) {
+            readResult(job, header->slotBytes);
+            if (job.resultFd >= 0) {
+                ::close(job.resultFd);
+            }
+        }
+
+        // Exactly one line per job
+        QByteArray id = QByteArray::number(job.jobId);
+        if (job.killed) {
+            writeLine(protocolFd, "timeout " + id + ' ' + QByteArray::number(job.timeoutMs));
+        } else if (publishResult(ring, job)) {
+            writeLine(protocolFd, "done " + id);
+        } else {
+            int code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+            writeLine(protocolFd, "exited " + id + ' ' + QByteArray::number(code));
+        }
+    }
+}
+
+void killOverdueChildren(QHash<pid_t, ChildJob> &children, qint64 now) {
+    for (auto it = children.begin(); it != children.end(); ++it) {
+        ChildJob &job = it.value();
+        if (job.deadline > 0 && !job.killed && now >= job.deadline) {
+            qDebug() << "Forked Python job" << job.jobId << "overran its" << job.timeoutMs << "ms deadline, killing it";
+            ::kill(it.key(), SIGKILL);
+            job.killed = true;
+        }
+    }
+}
+#endif
+}
+
+PythonZygote::PythonZygote(QObject *parent)
+    : QObject(parent), m_process(nullptr), m_ring(nullptr), m_ringBytes(0),
+      m_running(false), m_nextJobId(1) {
+}
+
+PythonZygote::~PythonZygote() {
+    stop();
+}
+
+bool PythonZygote::isSupported() {
+#ifdef Q_OS_UNIX
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool PythonZygote::start(int slotCount, int slotBytes) {
+#ifdef Q_OS_UNIX
+    if (isRunning()) {
+        return true;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    static std::atomic<int> counter(0);
+    m_shmName = QString("/zoraperl-zygote-%1-%2").arg(QCoreApplication::applicationPid()).arg(++counter);
+    slotCount = qMax(1, slotCount);
+    slotBytes = (qMax(1024, slotBytes) + 15) & ~15;
+    m_ringBytes = sizeof(RingHeader) + size_t(slotCount) * (sizeof(SlotHeader) + slotBytes);
+
+    QByteArray name = m_shmName.toUtf8();
+    int fd = shm_open(name.constData(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        qDebug() << "Failed to create zygote shared memory:" << strerror(errno);
+        return false;
+    }
+    if (ftruncate(fd, m_ringBytes) != 0) {
+        qDebug() << "Failed to size zygote shared memory:" << strerror(errno);
+        ::close(fd);
+        shm_unlink(name.constData());
+        return false;
+    }
+    void *ring = mmap(nullptr, m_ringBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (ring == MAP_FAILED) {
+        qDebug() << "Failed to map zygote shared memory:" << strerror(errno);
+        shm_unlink(name.constData());
+        return false;
+    }
+    m_ring = ring;
+
+    RingHeader *header = static_cast<RingHeader *>(m_ring);
+    header->magic = kRingMagic;
+    header->slotCount = slotCount;
+    header->slotBytes = slotBytes;
+
+    m_process = new QProcess(this);
+    m_process->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    m_process->start(QCoreApplication::applicationFilePath(), {"--python-zygote", m_shmName});
+
+    bool ready = m_process->waitForStarted();
+    while (ready && !m_output.contains("ready\n")) {
+        ready = m_process->waitForReadyRead(30000);
+        m_output += m_process->readAllStandardOutput();
+    }
+
+    // The zygote has its own mapping now, and children inherit it
+    shm_unlink(name.constData());
+
+    if (!ready) {
+        qDebug() << "Python zygote failed to start";
+        m_process->kill();
+        m_process->waitForFinished();
+        m_process->deleteLater();
+        m_process = nullptr;
+        m_output.clear();
+        unmap();
+        return false;
+    }
+    m_output.remove(0, m_output.indexOf("ready\n") + 6);
+
+    connect(m_process, &QProcess::readyReadStandardOutput, this, &PythonZygote::readOutput);
+    connect(m_process, qOverload<int, QProcess::ExitStatus>(&QProcess::finished),
+            this, &PythonZygote::processFinished);
+
+    {
+        QMutexLocker locker(&m_mutex);
+        m_freeSlots.clear();
+        for (int i = 0; i < slotCount; ++i) {
+            m_freeSlots.append(i);
+        }
+        m_running = true;
+    }
+
+    qDebug() << "Python zygote ready in" << timer.elapsed() << "ms with" << slotCount << "result slots";
+    return true;
+#else
+    Q_UNUSED(slotCount);
+    Q_UNUSED(slotBytes);
+    qDebug() << "Python zygote needs fork(), not available on this platform";
+    return false;
+#endif
+}
+
+void PythonZygote::stop() {
+    {
+        QMutexLocker locker(&m_mutex);
+        m_running = false;
+    }
+
+    if (m_process) {
+        QProcess *process = m_process;
+        m_process = nullptr;
+        disconnect(process, nullptr, this, nullptr);
+
+        // Closing stdin ends the request loop; running children finish on their own
+        process->closeWriteChannel();
+        if (!process->waitForFinished(2000)) {
+            process->kill();
+            process->waitForFinished();
+        }
+        process->deleteLater();
+    }
+
+    failAll("Error: Python zygote stopped");
+    unmap();
+}
+
+bool PythonZygote::isRunning() const {
+    QMutexLocker locker(&m_mutex);
+    return m_running;
+}
+
+QFuture<PythonPoolResult> PythonZygote::submit(const QString &code, int timeoutMs) {
+    auto promise = std::make_shared<QPromise<PythonPoolResult>>();
+    QFuture<PythonPoolResult> future = promise->future();
+    promise->start();
+
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_running) {
+            locker.unlock();
+            PythonPoolResult result;
+            result.error = "Error: Python zygote not running";
+            promise->addResult(result);
+            promise->finish();
+            return future;
+        }
+
+        Job job;
+        job.id = m_nextJobId++;
+        job.code = code.toUtf8();
+        job.timeoutMs = qMax(0, timeoutMs);
+        job.promise = promise;
+        m_pending.enqueue(job);
+    }
+
+    // The pipe belongs to the thread the zygote lives on
+    if (QThread::currentThread() == thread()) {
+        dispatch();
+    } else {
+        QMetaObject::invokeMethod(this, &PythonZygote::dispatch, Qt::QueuedConnection);
+    }
+    return future;
+}
+
+void PythonZygote::dispatch() {
+    QByteArray requests;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_running) {
+            return;
+        }
+        while (!m_pending.isEmpty() && !m_freeSlots.isEmpty()) {
+            Job job = m_pending.dequeue();
+            job.slot = m_freeSlots.takeFirst();
+            requests += "run " + QByteArray::number(job.id) + ' ' + QByteArray::number(job.slot) + ' '
+                        + QByteArray::number(job.timeoutMs) + ' ' + job.code.toBase64() + '\n';
+            job.code.clear();
+            m_dispatched.insert(job.id, job);
+        }
+    }
+
+    if (!requests.isEmpty() && m_process) {
+        m_process->write(requests);
+    }
+}
+
+void PythonZygote::readOutput() {
+    if (!m_process) {
+        return;
+    }
+    m_output += m_process->readAllStandardOutput();
+
+    int newline;
+    while ((newline = m_output.indexOf('\n')) >= 0) {
+        QList<QByteArray> fields = m_output.left(newline).split(' ');
+        m_output.remove(0, newline + 1);
+        if (fields.size() < 2) {
+            continue;
+        }
+        quint64 id = fields.at(1).toULongLong();
+
+        if (fields.at(0) == "done") {
+            PythonPoolResult result;
+            {
+                QMutexLocker locker(&m_mutex);
+                auto it = m_dispatched.constFind(id);
+                if (it == m_dispatched.constEnd() || !m_ring) {
+                    continue;
+                }
+                SlotHeader *slot = ringSlot(m_ring, it->slot);
+                const quint32 slotBytes = static_cast<RingHeader *>(m_ring)->slotBytes;
+                // Read the length once; anything past the slot is never trusted
+                const quint32 length = slot->length;
+                if (slot->state.load(std::memory_order_acquire) != SlotReady || slot->jobId != id) {
+                    result.error = "Error: forked Python worker left no result";
+                } else if (length > slotBytes) {
+                    result.error = "Error: forked Python worker reported a corrupt result";
+                } else {
+                    result = deserializeResult(slotPayload(slot), int(length));
+                }
+                slot->state.store(SlotFree, std::memory_order_relaxed);
+            }
+            finishJob(id, result);
+        } else if (fields.at(0) == "timeout" && fields.size() >= 3) {
+            PythonPoolResult result;
+            result.error = QString("Error: forked Python worker exceeded its %1 ms deadline and was killed")
+                               .arg(QString::fromLatin1(fields.at(2)));
+            finishJob(id, result);
+        } else if (fields.at(0) == "exited" && fields.size() >= 3) {
+            // The child sent no usable result: it crashed or called os._exit()
+            PythonPoolResult result;
+            result.error = QString("Error: forked Python worker exited with status %1")
+                               .arg(QString::fromLatin1(fields.at(2)));
+            finishJob(id, result);
+        } else if (fields.at(0) == "failed") {
+            PythonPoolResult result;
+            result.error = "Error: could not fork a Python worker";
+            finishJob(id, result);
+        }
+    }
+
+    dispatch();
+}
+
+void PythonZygote::processFinished() {
+    qDebug() << "Python zygote exited";
+    {
+        QMutexLocker locker(&m_mutex);
+        m_running = false;
+    }
+    failAll("Error: Python zygote exited");
+}
+
+void PythonZygote::finishJob(quint64 id, const PythonPoolResult &result) {
+    Job job;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_dispatched.contains(id)) {
+            return;
+        }
+        job = m_dispatched.take(id);
+        m_freeSlots.append(job.slot);
+    }
+    job.promise->addResult(result);
+    job.promise->finish();
+}
+
+void PythonZygote::failAll(const QString &error) {
+    QList<Job> jobs;
+    {
+        QMutexLocker locker(&m_mutex);
+        jobs = m_dispatched.values();
+        m_dispatched.clear();
+        while (!m_pending.isEmpty()) {
+            jobs.append(m_pending.dequeue());
+        }
+        m_freeSlots.clear();
+    }
+
+    PythonPoolResult result;
+    result.error = error;
+    for (Job &job : jobs) {
+        job.promise->addResult(result);
+        job.promise->finish();
+    }
+}
+
+void PythonZygote::unmap() {
+#ifdef Q_OS_UNIX
+    QMutexLocker locker(&m_mutex);
+    if (m_ring) {
+        munmap(m_ring, m_ringBytes);
+        m_ring = nullptr;
+        m_ringBytes = 0;
+    }
+#endif
+}
+
+int PythonZygote::serve(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QStringList arguments = app.arguments();
+    int index = arguments.indexOf("--python-zygote");
+    if (index < 0 || index + 1 >= arguments.size()) {
+        qDebug() << "Usage: --python-zygote <shared memory name>";
+        return 2;
+    }
+
+    // Children write straight to the inherited stderr; nothing reads a console ring here
+    qputenv("ZORAPERL_PYTHON_CAPTURE", "0");
+
+    PythonManager manager;
+    if (!manager.initialize()) {
+        qDebug() << "Python zygote failed to initialize the interpreter";
+        return 1;
+    }
+    return manager.runZygoteServer(arguments.at(index + 1));
+}
+
+int PythonZygote::serveRequests(const QString &shmName) {
+#ifdef Q_OS_UNIX
+    QByteArray name = shmName.toUtf8();
+    int fd = shm_open(name.constData(), O_RDWR, 0);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        qDebug() << "Zygote cannot open shared memory" << shmName << ":" << strerror(errno);
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        return 1;
+    }
+    void *ring = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (ring == MAP_FAILED || static_cast<RingHeader *>(ring)->magic != kRingMagic) {
+        qDebug() << "Zygote shared memory" << shmName << "is not a result ring";
+        return 1;
+    }
+    int slotCount = static_cast<RingHeader *>(ring)->slotCount;
+    quint32 slotBytes = static_cast<RingHeader *>(ring)->slotBytes;
+
+    preloadModules();
+
+    // Script output goes to stderr; stdout carries only the protocol
+    int protocolFd = dup(STDOUT_FILENO);
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+    writeLine(protocolFd, "ready");
+
+    QHash<pid_t, ChildJob> children;
+    QElapsedTimer clock;
+    clock.start();
+    QByteArray input;
+    forever {
+        killOverdueChildren(children, clock.elapsed());
+        reapChildren(children, ring, protocolFd);
+
+        // Wake for requests, result data, the next reap and the nearest deadline
+        pollfd request = {STDIN_FILENO, POLLIN, 0};
+        QList<pollfd> polled = {request};
+        QList<pid_t> polledChildren;
+        int waitMs = children.isEmpty() ? -1 : 20;
+        for (auto it = children.cbegin(); it != children.cend(); ++it) {
+            if (it->resultFd >= 0) {
+                pollfd result = {it->resultFd, POLLIN, 0};
+                polled.append(result);
+                polledChildren.append(it.key());
+            }
+        }
+
+        int ready = poll(polled.data(), nfds_t(polled.size()), waitMs);
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ready <= 0) {
+            continue;
+        }
+
+        for (int i = 1; i < polled.size(); ++i) {
+            if (polled.at(i).revents != 0) {
+                auto it = children.find(polledChildren.at(i - 1));
+                if (it != children.end() && it->resultFd >= 0) {
+                    readResult(it.value(), slotBytes);
+                }
+            }
+        }
+        if (polled.first().revents == 0) {
+            continue;
+        }
+
+        char buffer[4096];
+        ssize_t count = ::read(STDIN_FILENO, buffer, sizeof(buffer));
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            break;
+        }
+        input.append(buffer, count);
+
+        int newline;
+        while ((newline = input.indexOf('\n')) >= 0) {
+            QList<QByteArray> fields = input.left(newline).split(' ');
+            input.remove(0, newline + 1);
+            if (fields.size() != 5 || fields.at(0) != "run") {
+                continue;
+            }
+            quint64 jobId = fields.at(1).toULongLong();
+            int slot = fields.at(2).toInt();
+            int timeoutMs = qMax(0, fields.at(3).toInt());
+            if (slot < 0 || slot >= slotCount) {
+                writeLine(protocolFd, "failed " + fields.at(1));
+                continue;
+            }
+            QByteArray code = QByteArray::fromBase64(fields.at(4));
+
+            int resultPipe[2];
+            if (pipe(resultPipe) != 0) {
+                qDebug() << "Zygote cannot create a result pipe:" << strerror(errno);
+                writeLine(protocolFd, "failed " + fields.at(1));
+                continue;
+            }
+            fcntl(resultPipe[0], F_SETFL, fcntl(resultPipe[0], F_GETFL) | O_NONBLOCK);
+            fcntl(resultPipe[0], F_SETFD, FD_CLOEXEC);
+
+            PyOS_BeforeFork();
+            pid_t pid = fork();
+            if (pid == 0) {
+                PyOS_AfterFork_Child();
+                ::close(resultPipe[0]);
+                isolateChild(ring, info.st_size, protocolFd, children);
+                runChild(resultPipe[1], slotBytes, code);
+            }
+            PyOS_AfterFork_Parent();
+            ::close(resultPipe[1]);
+
+            if (pid < 0) {
+                qDebug() << "Zygote fork failed:" << strerror(errno);
+                ::close(resultPipe[0]);
+                writeLine(protocolFd, "failed " + fields.at(1));
+            } else {
+                ChildJob job;
+                job.jobId = jobId;
+                job.slot = slot;
+                job.resultFd = resultPipe[0];
+                job.timeoutMs = timeoutMs;
+                job.deadline = timeoutMs > 0 ? clock.elapsed() + timeoutMs : 0;
+                children.insert(pid, job);
+            }
+        }
+    }
+
+    // The host is gone; children still running finish on their own
+    for (const ChildJob &job : std::as_const(children)) {
+        if (job.resultFd >= 0) {
+            ::close(job.resultFd);
+        }
+    }
+    munmap(ring, info.st_size);
+    ::close(protocolFd);
+    return 0;
+#else
+    Q_UNUSED(shmName);
+    return 1;
+#endif
+}
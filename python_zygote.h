@@ -0,0 +1,83 @@
+#ifndef PYTHON_ZYGOTE_H
+#define PYTHON_ZYGOTE_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QFuture>
+#include <QHash>
+#include <QMutex>
+#include <QPromise>
+#include <QQueue>
+#include <memory>
+#include "python_subinterpreter_pool.h"
+
+class QProcess;
+
+// Runs scripts out of process. The zygote is this binary started with
+// --python-zygote: it initializes Python, imports the common modules and
+// freezes the heap with gc.freeze(), then forks a child per script, so each
+// script gets its own process with the warm interpreter shared copy-on-write.
+// Children run the script like PythonSubinterpreterPool does (fresh
+// namespace, zoraperl_channel.send()) and hand the result to the zygote over
+// a private pipe. The child gets no access to the request pipe, the protocol
+// pipe or the shared-memory ring; the zygote checks the result and copies it
+// into the job's ring slot, and only "done <id>" travels to the host.
+//
+// POSIX only. Elsewhere start() fails and PythonManager falls back to the
+// in-process pool.
+class PythonZygote : public QObject {
+    Q_OBJECT
+
+public:
+    explicit PythonZygote(QObject *parent = nullptr);
+    ~PythonZygote();
+
+    static bool isSupported();
+
+    // Blocks until the zygote has warmed up
+    bool start(int slotCount = 16, int slotBytes = 64 * 1024);
+    void stop();
+    bool isRunning() const;
+
+    // Thread-safe; jobs beyond the slot count wait for a free slot. A child
+    // still running timeoutMs after its fork is killed (0: no deadline).
+    QFuture<PythonPoolResult> submit(const QString &code, int timeoutMs = 0);
+
+    // The zygote process: main() hands over when started with --python-zygote
+    static int serve(int argc, char *argv[]);
+    // Request loop of the zygote, on the interpreter thread with the GIL held
+    static int serveRequests(const QString &shmName);
+
+private slots:
+    void dispatch();
+    void readOutput();
+    void processFinished();
+
+private:
+    struct Job {
+        quint64 id = 0;
+        int slot = -1;
+        int timeoutMs = 0;
+        QByteArray code;
+        std::shared_ptr<QPromise<PythonPoolResult>> promise;
+    };
+
+    void finishJob(quint64 id, const PythonPoolResult &result);
+    void failAll(const QString &error);
+    void unmap();
+
+    QProcess *m_process;
+    QByteArray m_output;
+    QString m_shmName;
+    void *m_ring;
+    size_t m_ringBytes;
+
+    mutable QMutex m_mutex;
+    bool m_running;
+    quint64 m_nextJobId;
+    QQueue<Job> m_pending;
+    QHash<quint64, Job> m_dispatched;
+    QList<int> m_freeSlots;
+};
+
+#endif // PYTHON_ZYGOTE_H
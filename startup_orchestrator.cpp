@@ -0,0 +1,89 @@
+#include "startup_orchestrator.h"
+#include "system_checker.h"
+#include "python_manager.h"
+#include "startup_trace.h"
+#include <QtConcurrent>
+#include <QDebug>
+
+StartupOrchestrator::StartupOrchestrator(SystemChecker *checker, PythonManager *pythonManager, QObject *parent)
+    : QObject(parent), m_checker(checker), m_pythonManager(pythonManager),
+      m_pendingPhases(ConfigPhase | PythonPhase | DesktopPhase),
+      m_configured(false), m_pythonReady(false), m_lazyPython(false) {
+    connect(&m_configWatcher, &QFutureWatcher<bool>::finished, this, &StartupOrchestrator::onConfigChecked);
+    connect(&m_pythonWatcher, &QFutureWatcher<bool>::finished, this, &StartupOrchestrator::onPythonInitialized);
+}
+
+void StartupOrchestrator::setLazyPython(bool lazy) {
+    m_lazyPython = lazy;
+}
+
+bool StartupOrchestrator::isLazyPython() const {
+    return m_lazyPython;
+}
+
+void StartupOrchestrator::start() {
+    qDebug() << "Starting concurrent startup phases";
+
+    emit phaseStarted("Checking system configuration...");
+    SystemChecker *checker = m_checker;
+    m_configWatcher.setFuture(QtConcurrent::run([checker]() {
+        TraceSpan span("config phase");
+        return checker->isSystemConfigured();
+    }));
+
+    m_pythonWatcher.setFuture(m_pythonManager->initializeAsync());
+    if (m_lazyPython) {
+        // Nothing on the desktop needs Python yet; don't hold the splash for it
+        completePhase(PythonPhase);
+    } else {
+        emit phaseStarted("Initializing Python interpreter...");
+    }
+}
+
+void StartupOrchestrator::markDesktopReady() {
+    completePhase(DesktopPhase);
+}
+
+bool StartupOrchestrator::isReady() const {
+    return m_pendingPhases == 0 && m_configured && (m_lazyPython || m_pythonReady);
+}
+
+void StartupOrchestrator::onConfigChecked() {
+    m_configured = m_configWatcher.result();
+    qDebug() << "Config phase finished, configured:" << m_configured;
+    completePhase(ConfigPhase);
+}
+
+void StartupOrchestrator::onPythonInitialized() {
+    m_pythonReady = m_pythonWatcher.result();
+    qDebug() << "Python phase finished, ready:" << m_pythonReady;
+    
+    if (m_lazyPython) {
+        if (!m_pythonReady) {
+            emit pythonUnavailable();
+        }
+        return;
+    }
+    completePhase(PythonPhase);
+}
+
+void StartupOrchestrator::completePhase(Phase phase) {
+    if (!(m_pendingPhases & phase)) {
+        return;
+    }
+
+    m_pendingPhases &= ~phase;
+    if (m_pendingPhases != 0) {
+        return;
+    }
+
+    // A missing configuration takes precedence: onboarding does not need Python
+    if (!m_configured) {
+        emit configurationMissing();
+    } else if (!m_lazyPython && !m_pythonReady) {
+        emit pythonFailed();
+    } else {
+        qDebug() << "All startup phases ready";
+        emit ready();
+    }
+}
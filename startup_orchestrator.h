@@ -0,0 +1,58 @@
+#ifndef STARTUP_ORCHESTRATOR_H
+#define STARTUP_ORCHESTRATOR_H
+
+#include <QObject>
+#include <QString>
+#include <QFutureWatcher>
+
+class SystemChecker;
+class PythonManager;
+
+// Runs the independent startup phases concurrently and reports when all of
+// them are done. Config validation and Python bring-up run on worker threads
+// while the GUI thread builds the desktop widgets. In lazy Python mode the
+// interpreter keeps warming up after the desktop is shown.
+class StartupOrchestrator : public QObject {
+    Q_OBJECT
+
+public:
+    enum Phase {
+        ConfigPhase = 0x1,
+        PythonPhase = 0x2,
+        DesktopPhase = 0x4
+    };
+
+    StartupOrchestrator(SystemChecker *checker, PythonManager *pythonManager, QObject *parent = nullptr);
+
+    void setLazyPython(bool lazy);
+    bool isLazyPython() const;
+    
+    void start();
+    void markDesktopReady();
+    bool isReady() const;
+
+signals:
+    void phaseStarted(const QString &message);
+    void configurationMissing();
+    void pythonFailed();
+    void pythonUnavailable();
+    void ready();
+
+private slots:
+    void onConfigChecked();
+    void onPythonInitialized();
+
+private:
+    void completePhase(Phase phase);
+
+    SystemChecker *m_checker;
+    PythonManager *m_pythonManager;
+    QFutureWatcher<bool> m_configWatcher;
+    QFutureWatcher<bool> m_pythonWatcher;
+    int m_pendingPhases;
+    bool m_configured;
+    bool m_pythonReady;
+    bool m_lazyPython;
+};
+
+#endif // STARTUP_ORCHESTRATOR_H
@@ -0,0 +1,179 @@
+#include "startup_trace.h"
+#include <QCoreApplication>
+#include <QThread>
+#include <QFile>
+#include <QDir>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutexLocker>
+#include <QDebug>
+#include <cstring>
+
+namespace {
+const char *kDefaultTraceFile = "zoraperl-startup-trace.json";
+}
+
+StartupTrace &StartupTrace::instance() {
+    static StartupTrace trace;
+    return trace;
+}
+
+StartupTrace::StartupTrace() : m_enabled(false) {
+    m_clock.start();
+}
+
+void StartupTrace::configure(int argc, char *argv[]) {
+    // Environment variable: a file path, or any non-path value for the default file
+    QString envValue = qEnvironmentVariable("ZORAPERL_TRACE");
+    if (!envValue.isEmpty() && envValue != "0") {
+        enable(envValue == "1" ? QString(kDefaultTraceFile) : envValue);
+    }
+
+    // Command line flag overrides the environment
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--trace-startup") == 0) {
+            enable(kDefaultTraceFile);
+        } else if (std::strncmp(argv[i], "--trace-startup=", 16) == 0) {
+            enable(QString::fromLocal8Bit(argv[i] + 16));
+        }
+    }
+}
+
+void StartupTrace::enable(const QString &outputPath) {
+    QMutexLocker locker(&m_mutex);
+    m_outputPath = QDir::current().absoluteFilePath(outputPath);
+    m_enabled = true;
+}
+
+bool StartupTrace::isEnabled() const {
+    return m_enabled;
+}
+
+qint64 StartupTrace::elapsedMicroseconds() const {
+    return m_clock.nsecsElapsed() / 1000;
+}
+
+void StartupTrace::addComplete(const char *name, const char *category, qint64 startUs, qint64 durationUs) {
+    if (!m_enabled) {
+        return;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_events.append({name, category, 'X', startUs, durationUs, currentThreadId()});
+}
+
+void StartupTrace::addInstant(const char *name, const char *category) {
+    if (!m_enabled) {
+        return;
+    }
+
+    qint64 timestamp = elapsedMicroseconds();
+    QMutexLocker locker(&m_mutex);
+    m_events.append({name, category, 'i', timestamp, 0, currentThreadId()});
+}
+
+void StartupTrace::finish(const char *name) {
+    if (!m_enabled) {
+        return;
+    }
+
+    addInstant(name, "startup");
+
+    QMutexLocker locker(&m_mutex);
+    // Only the first finish writes; spans still open elsewhere are dropped
+    if (!m_enabled.exchange(false)) {
+        return;
+    }
+
+    if (writeToFile()) {
+        qDebug() << "Startup trace written to:" << m_outputPath;
+    } else {
+        qDebug() << "Failed to write startup trace:" << m_outputPath;
+    }
+}
+
+int StartupTrace::currentThreadId() {
+    // Called with m_mutex held
+    quintptr key = reinterpret_cast<quintptr>(QThread::currentThreadId());
+    auto it = m_threadIds.constFind(key);
+    if (it != m_threadIds.constEnd()) {
+        return it.value();
+    }
+
+    int id = m_threadIds.size() + 1;
+    m_threadIds.insert(key, id);
+
+    QThread *thread = QThread::currentThread();
+    QString name = thread ? thread->objectName() : QString();
+    if (name.isEmpty()) {
+        // Before QApplication exists only the main thread is running
+        bool isMain = !QCoreApplication::instance() || thread == QCoreApplication::instance()->thread();
+        name = isMain ? QString("main") : QString("worker-%1").arg(id);
+    }
+    m_threadNames.insert(id, name);
+
+    return id;
+}
+
+bool StartupTrace::writeToFile() {
+    // Called with m_mutex held
+    qint64 pid = QCoreApplication::applicationPid();
+    QJsonArray events;
+
+    for (auto it = m_threadNames.constBegin(); it != m_threadNames.constEnd(); ++it) {
+        QJsonObject metadata;
+        metadata["name"] = "thread_name";
+        metadata["ph"] = "M";
+        metadata["pid"] = pid;
+        metadata["tid"] = it.key();
+        metadata["args"] = QJsonObject{{"name", it.value()}};
+        events.append(metadata);
+    }
+
+    for (const Event &event : m_events) {
+        QJsonObject object;
+        object["name"] = QString::fromUtf8(event.name);
+        object["cat"] = QString::fromUtf8(event.category);
+        object["ph"] = QString(QChar(event.phase));
+        object["ts"] = event.timestamp;
+        object["pid"] = pid;
+        object["tid"] = event.threadId;
+        if (event.phase == 'X') {
+            object["dur"] = event.duration;
+        } else {
+            object["s"] = "g";
+        }
+        events.append(object);
+    }
+
+    QJsonObject root;
+    root["traceEvents"] = events;
+    root["displayTimeUnit"] = "ms";
+
+    QFile file(m_outputPath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    file.close();
+    return true;
+}
+
+TraceSpan::TraceSpan(const char *name, const char *category)
+    : m_name(name), m_category(category), m_start(-1) {
+    StartupTrace &trace = StartupTrace::instance();
+    if (trace.isEnabled()) {
+        m_start = trace.elapsedMicroseconds();
+    }
+}
+
+TraceSpan::~TraceSpan() {
+    if (m_start < 0) {
+        return;
+    }
+
+    StartupTrace &trace = StartupTrace::instance();
+    trace.addComplete(m_name, m_category, m_start, trace.elapsedMicroseconds() - m_start);
+}
@@ -0,0 +1,64 @@
+#ifndef STARTUP_TRACE_H
+#define STARTUP_TRACE_H
+
+#include <QString>
+#include <QVector>
+#include <QHash>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <atomic>
+
+// Collects startup spans and writes them as a Chrome trace / Perfetto JSON file.
+// Enabled with the ZORAPERL_TRACE environment variable or --trace-startup[=file].
+class StartupTrace {
+public:
+    static StartupTrace &instance();
+
+    void configure(int argc, char *argv[]);
+    void enable(const QString &outputPath);
+    bool isEnabled() const;
+
+    qint64 elapsedMicroseconds() const;
+    void addComplete(const char *name, const char *category, qint64 startUs, qint64 durationUs);
+    void addInstant(const char *name, const char *category);
+
+    // Records the final marker and writes the trace file once
+    void finish(const char *name);
+
+private:
+    StartupTrace();
+
+    struct Event {
+        const char *name;
+        const char *category;
+        char phase;
+        qint64 timestamp;
+        qint64 duration;
+        int threadId;
+    };
+
+    int currentThreadId();
+    bool writeToFile();
+
+    QElapsedTimer m_clock;
+    QMutex m_mutex;
+    QVector<Event> m_events;
+    QHash<quintptr, int> m_threadIds;
+    QHash<int, QString> m_threadNames;
+    QString m_outputPath;
+    std::atomic<bool> m_enabled;
+};
+
+// Records one complete ("X") event covering the lifetime of the object
+class TraceSpan {
+public:
+    explicit TraceSpan(const char *name, const char *category = "startup");
+    ~TraceSpan();
+
+private:
+    const char *m_name;
+    const char *m_category;
+    qint64 m_start;
+};
+
+#endif // STARTUP_TRACE_H
@@ -1,19 +1,27 @@
 #include "system_checker.h"
+#include "startup_trace.h"
+#include "zora_layout.h"
 #include <QDir>
 #include <QFile>
-#include <QProcess>
 #include <QCoreApplication>
 #include <QDebug>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QStandardPaths>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QSaveFile>
+#include <QCryptographicHash>
+#include <QCborValue>
 
 SystemChecker::SystemChecker(QObject *parent) : QObject(parent) {
-    m_zoraPerlPath = getZoraPerlPath();
-    m_configPath = m_zoraPerlPath + "/etc/config.json";
 }
 
 bool SystemChecker::isSystemConfigured() {
+    TraceSpan span("SystemChecker::isSystemConfigured");
+    
+    resolvePaths();
+    
     qDebug() << "Checking if system is configured...";
     qDebug() << "ZoraPerl path:" << m_zoraPerlPath;
     qDebug() << "Config path:" << m_configPath;
@@ -21,7 +29,21 @@ bool SystemChecker::isSystemConfigured() {
     return checkZoraPerlDirectory() && checkConfigFile();
 }
 
+void SystemChecker::resolvePaths() {
+    // Resolved on first use rather than in the constructor so the lookup runs
+    // on the startup worker thread
+    if (!m_zoraPerlPath.isEmpty()) {
+        return;
+    }
+    
+    TraceSpan span("ZoraLayout::rootPath");
+    m_zoraPerlPath = ZoraLayout::rootPath();
+    m_configPath = ZoraLayout::configFilePath();
+    m_snapshotPath = m_zoraPerlPath + "/etc/config.cbor";
+}
+
 bool SystemChecker::checkZoraPerlDirectory() {
+    TraceSpan span("SystemChecker::checkZoraPerlDirectory");
     QDir zoraPerlDir(m_zoraPerlPath);
     if (!zoraPerlDir.exists()) {
         qDebug() << "ZoraPerl directory does not exist:" << m_zoraPerlPath;
@@ -29,13 +51,10 @@ bool SystemChecker::checkZoraPerlDirectory() {
     }
     
     // Check required subdirectories
-    QStringList requiredDirs = {"bin", "compat", "etc", "system", "users"};
-    for (const QString &dir : requiredDirs) {
-        QDir subDir(zoraPerlDir.absoluteFilePath(dir));
-        if (!subDir.exists()) {
-            qDebug() << "Required subdirectory missing:" << dir;
-            return false;
-        }
+    QStringList missing = ZoraLayout::missingDirectories();
+    if (!missing.isEmpty()) {
+        qDebug() << "Required subdirectories missing:" << missing;
+        return false;
     }
     
     qDebug() << "ZoraPerl directory structure is valid";
@@ -43,13 +62,29 @@ bool SystemChecker::checkZoraPerlDirectory() {
 }
 
 bool SystemChecker::checkConfigFile() {
-    QFile configFile(m_configPath);
-    if (!configFile.exists()) {
+    TraceSpan span("SystemChecker::checkConfigFile");
+    
+    // One stat of the source decides whether the binary snapshot is still current
+    QFileInfo sourceInfo(m_configPath);
+    if (!sourceInfo.exists()) {
         qDebug() << "Config file does not exist:" << m_configPath;
         return false;
     }
     
-    // Try to parse the config file
+    QCborMap snapshot = readConfigSnapshot();
+    qint64 sourceSize = sourceInfo.size();
+    qint64 sourceMtime = sourceInfo.lastModified().toMSecsSinceEpoch();
+    
+    if (!snapshot.isEmpty()
+        && snapshot.value(QStringLiteral("sourceSize")).toInteger() == sourceSize
+        && snapshot.value(QStringLiteral("sourceMtime")).toInteger() == sourceMtime) {
+        qDebug() << "Using config snapshot:" << m_snapshotPath;
+        m_config = snapshot.value(QStringLiteral("config")).toMap().toJsonObject();
+        return validateConfig(m_config);
+    }
+    
+    // Snapshot is missing or stale, fall back to the JSON source
+    QFile configFile(m_configPath);
     if (!configFile.open(QIODevice::ReadOnly)) {
         qDebug() << "Cannot read config file:" << m_configPath;
         return false;
@@ -58,16 +93,35 @@ bool SystemChecker::checkConfigFile() {
     QByteArray data = configFile.readAll();
     configFile.close();
     
+    QByteArray sourceHash = QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+    
+    // Touched but unchanged: keep the snapshot config, refresh its key
+    if (!snapshot.isEmpty() && snapshot.value(QStringLiteral("sourceHash")).toByteArray() == sourceHash) {
+        qDebug() << "Config file unchanged since snapshot, refreshing snapshot key";
+        m_config = snapshot.value(QStringLiteral("config")).toMap().toJsonObject();
+        writeConfigSnapshot(sourceSize, sourceMtime, sourceHash);
+        return validateConfig(m_config);
+    }
+    
     QJsonParseError error;
-    QJsonDocument doc = QJsonDocument::fromJson(data, &error);
+    QJsonDocument doc;
+    {
+        TraceSpan parseSpan("config.json parse");
+        doc = QJsonDocument::fromJson(data, &error);
+    }
     
     if (error.error != QJsonParseError::NoError) {
         qDebug() << "Invalid JSON in config file:" << error.errorString();
         return false;
     }
     
-    QJsonObject config = doc.object();
+    m_config = doc.object();
+    writeConfigSnapshot(sourceSize, sourceMtime, sourceHash);
     
+    return validateConfig(m_config);
+}
+
+bool SystemChecker::validateConfig(const QJsonObject &config) const {
     // Check if config has required fields
     if (!config.contains("username") || !config.contains("language") || !config.contains("setupVersion")) {
         qDebug() << "Config file missing required fields";
@@ -78,103 +132,71 @@ bool SystemChecker::checkConfigFile() {
     return true;
 }
 
-QString SystemChecker::getZoraPerlPath() {
-    // Get the application directory and navigate to find ZoraPerl
-    QDir appDir(QCoreApplication::applicationDirPath());
-    qDebug() << "Application directory:" << appDir.absolutePath();
-    
-    // Try different approaches to find ZoraPerl directory
+QJsonObject SystemChecker::config() const {
+    return m_config;
+}
+
+QCborMap SystemChecker::readConfigSnapshot() const {
+    TraceSpan span("config snapshot read");
     
-    // Method 1: Check if we're already in ZoraPerl directory
-    if (appDir.dirName() == "ZoraPerl") {
-        return appDir.absolutePath();
+    QFile snapshotFile(m_snapshotPath);
+    if (!snapshotFile.open(QIODevice::ReadOnly)) {
+        return QCborMap();
     }
     
-    // Method 2: Check if ZoraPerl is a sibling directory
-    QDir parentDir = appDir;
-    if (parentDir.cdUp()) {
-        QDir zoraPerlDir(parentDir.absoluteFilePath("ZoraPerl"));
-        if (zoraPerlDir.exists()) {
-            return zoraPerlDir.absolutePath();
-        }
+    QCborParserError error;
+    QCborValue value = QCborValue::fromCbor(snapshotFile.readAll(), &error);
+    if (error.error != QCborError::NoError || !value.isMap()) {
+        qDebug() << "Ignoring unreadable config snapshot:" << m_snapshotPath;
+        return QCborMap();
     }
     
-    // Method 3: Search up the directory tree
-    QDir searchDir = appDir;
-    for (int i = 0; i < 5; ++i) {
-        QDir zoraPerlDir(searchDir.absoluteFilePath("ZoraPerl"));
-        if (zoraPerlDir.exists()) {
-            return zoraPerlDir.absolutePath();
-        }
-        if (!searchDir.cdUp()) {
-            break;
-        }
+    QCborMap snapshot = value.toMap();
+    if (snapshot.value(QStringLiteral("version")).toInteger() != kConfigSnapshotVersion) {
+        return QCborMap();
     }
     
-    // Method 4: Use current working directory
-    QDir currentDir = QDir::current();
-    QDir zoraPerlDir(currentDir.absoluteFilePath("ZoraPerl"));
-    if (zoraPerlDir.exists()) {
-        return zoraPerlDir.absolutePath();
+    return snapshot;
+}
+
+void SystemChecker::writeConfigSnapshot(qint64 sourceSize, qint64 sourceMtime, const QByteArray &sourceHash) const {
+    QCborMap snapshot;
+    snapshot.insert(QStringLiteral("version"), kConfigSnapshotVersion);
+    snapshot.insert(QStringLiteral("sourceSize"), sourceSize);
+    snapshot.insert(QStringLiteral("sourceMtime"), sourceMtime);
+    snapshot.insert(QStringLiteral("sourceHash"), sourceHash);
+    snapshot.insert(QStringLiteral("config"), QCborMap::fromJsonObject(m_config));
+    
+    // Write atomically so a crash never leaves a truncated snapshot behind
+    QSaveFile snapshotFile(m_snapshotPath);
+    if (!snapshotFile.open(QIODevice::WriteOnly)) {
+        qDebug() << "Cannot write config snapshot:" << m_snapshotPath;
+        return;
     }
     
-    // Fallback: relative to application directory
-    return appDir.absoluteFilePath("ZoraPerl");
+    snapshotFile.write(QCborValue(snapshot).toCbor());
+    if (!snapshotFile.commit()) {
+        qDebug() << "Failed to commit config snapshot:" << m_snapshotPath;
+    }
 }
 
-bool SystemChecker::runOnboarding() {
-    QString onboardingPath = findOnboardingExecutable();
-    if (onboardingPath.isEmpty()) {
-        qDebug() << "Onboarding executable not found";
+bool SystemChecker::adoptConfig(const QJsonObject &config) {
+    if (!validateConfig(config)) {
         return false;
     }
     
-    qDebug() << "Starting onboarding process:" << onboardingPath;
-    
-    // Start the onboarding process
-    QProcess process;
-    process.setProgram(onboardingPath);
-    process.setWorkingDirectory(QFileInfo(onboardingPath).absolutePath());
+    resolvePaths();
+    m_config = config;
     
-    // Start the process and wait for it to finish
-    if (!process.startDetached()) {
-        qDebug() << "Failed to start onboarding process";
-        return false;
+    // The file was just written; hash it for the snapshot key but skip the parse
+    QFileInfo sourceInfo(m_configPath);
+    QFile configFile(m_configPath);
+    if (!configFile.open(QIODevice::ReadOnly)) {
+        qDebug() << "Cannot read config file:" << m_configPath;
+        return true;
     }
     
+    QByteArray sourceHash = QCryptographicHash::hash(configFile.readAll(), QCryptographicHash::Sha1);
+    writeConfigSnapshot(sourceInfo.size(), sourceInfo.lastModified().toMSecsSinceEpoch(), sourceHash);
     return true;
 }
-
-QString SystemChecker::findOnboardingExecutable() {
-    // Search for ZoraPerl_Onboarding.exe in various locations
-    QDir appDir(QCoreApplication::applicationDirPath());
-    
-    // List of possible locations
-    QStringList searchPaths = {
-        appDir.absoluteFilePath("ZoraPerl_Onboarding/ZoraPerl_Onboarding.exe"),
-        appDir.absoluteFilePath("ZoraPerl_Onboarding/build/ZoraPerl_Onboarding.exe"),
-        appDir.absoluteFilePath("../ZoraPerl_Onboarding/ZoraPerl_Onboarding.exe"),
-        appDir.absoluteFilePath("../ZoraPerl_Onboarding/build/ZoraPerl_Onboarding.exe")
-    };
-    
-    // Also search in parent directories
-    QDir searchDir = appDir;
-    for (int i = 0; i < 3; ++i) {
-        searchPaths.append(searchDir.absoluteFilePath("ZoraPerl_Onboarding/ZoraPerl_Onboarding.exe"));
-        searchPaths.append(searchDir.absoluteFilePath("ZoraPerl_Onboarding/build/ZoraPerl_Onboarding.exe"));
-        if (!searchDir.cdUp()) {
-            break;
-        }
-    }
-    
-    // Check each path
-    for (const QString &path : searchPaths) {
-        QFile file(path);
-        if (file.exists()) {
-            qDebug() << "Found onboarding executable at:" << path;
-            return path;
-        }
-    }
-    
-    return QString();
-}
\ No newline at end of file
@@ -4,6 +4,8 @@
 #include <QObject>
 #include <QString>
 #include <QDir>
+#include <QJsonObject>
+#include <QCborMap>
 
 class SystemChecker : public QObject {
     Q_OBJECT
@@ -12,16 +14,29 @@ public:
     explicit SystemChecker(QObject *parent = nullptr);
     
     bool isSystemConfigured();
-    bool runOnboarding();
+    
+    // Takes the config produced by an in-process onboarding run
+    bool adoptConfig(const QJsonObject &config);
+    
+    // Configuration loaded by the last successful check
+    QJsonObject config() const;
     
 private:
+    void resolvePaths();
     bool checkZoraPerlDirectory();
     bool checkConfigFile();
-    QString findOnboardingExecutable();
-    QString getZoraPerlPath();
+    bool validateConfig(const QJsonObject &config) const;
+    
+    // Binary copy of config.json keyed on its size, mtime and SHA-1
+    QCborMap readConfigSnapshot() const;
+    void writeConfigSnapshot(qint64 sourceSize, qint64 sourceMtime, const QByteArray &sourceHash) const;
     
     QString m_zoraPerlPath;
     QString m_configPath;
+    QString m_snapshotPath;
+    QJsonObject m_config;
+    
+    static const int kConfigSnapshotVersion = 1;
 };
 
 #endif // SYSTEM_CHECKER_H
\ No newline at end of file
@@ -0,0 +1,642 @@
+#include "thumbnail_cache.h"
+#include "startup_trace.h"
+#include "zora_layout.h"
+#include <QApplication>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QImageReader>
+#include <QSaveFile>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+// The index file is this header followed by kSlotCount slots
+struct IndexHeader {
+    char magic[8];
+    quint32 version;
+    quint32 slotCount;
+    quint32 entries;
+    quint32 thumbnailSize;
+    quint64 totalBytes;     // pixels stored, summed over entries
+    quint64 clock;          // bumped on every use, orders entries for LRU
+    quint64 orphanBytes;    // stored files no entry refers to that could not be removed yet
+};
+
+// An all-zero key marks a free slot
+struct IndexSlot {
+    quint64 key[2];
+    quint64 lastUsed;
+    quint8 content[20];
+    quint16 width;
+    quint16 height;
+    quint8 reserved[16];
+};
+
+const char kIndexMagic[8] = {'Z', 'P', 'T', 'H', 'U', 'M', 'B', '\0'};
+const quint32 kIndexVersion = 1;
+const quint32 kSlotCount = 1 << 15;
+const qint64 kSlotsOffset = 64;
+const qint64 kIndexSize = kSlotsOffset + qint64(kSlotCount) * qint64(sizeof(IndexSlot));
+static_assert(sizeof(IndexHeader) <= kSlotsOffset, "index header overlaps the slots");
+static_assert(sizeof(IndexSlot) == 64, "index slots are one cache line");
+
+// Linear probing stays short below 70% load
+const quint32 kMaxEntries = kSlotCount / 10 * 7;
+
+const quint64 kDefaultCapacityMb = 256;
+const int kDefaultJobs = 2;
+const qsizetype kMaxPrefetch = 4096;
+const int kMemoryCacheKiB = 32 << 10;
+
+IndexHeader *indexHeader(uchar *index) {
+    return reinterpret_cast<IndexHeader *>(index);
+}
+
+IndexSlot *indexSlots(uchar *index) {
+    return reinterpret_cast<IndexSlot *>(index + kSlotsOffset);
+}
+
+bool isFree(const IndexSlot &slot) {
+    return slot.key[0] == 0 && slot.key[1] == 0;
+}
+
+quint64 slotBytes(const IndexSlot &slot) {
+    return quint64(slot.width) * slot.height * 4;
+}
+
+int imageCost(const QImage &image) {
+    return qMax(1, int(image.sizeInBytes() >> 10));
+}
+
+void releaseMappedFile(void *file) {
+    // Closing the file unmaps the pixels
+    delete static_cast<QFile *>(file);
+}
+}
+
+ThumbnailCache &ThumbnailCache::instance() {
+    // Owned by the application so the images go before the GUI does
+    static ThumbnailCache *cache = new ThumbnailCache(qApp);
+    return *cache;
+}
+
+ThumbnailCache::ThumbnailCache(QObject *parent)
+    : QObject(parent), m_directory(ZoraLayout::path("system/cache/thumbnails")),
+      m_indexLock(QDir(m_directory).filePath("index.lock")), m_index(nullptr),
+      m_images(kMemoryCacheKiB), m_pool(new QThreadPool(this)), m_maxJobs(kDefaultJobs), m_running(0),
+      m_capacityBytes(kDefaultCapacityMb << 20) {
+    bool ok = false;
+    int jobs = qEnvironmentVariableIntValue("ZORAPERL_THUMBNAIL_THREADS", &ok);
+    if (ok && jobs > 0) {
+        m_maxJobs = qMin(jobs, 8);
+    }
+    m_pool->setMaxThreadCount(m_maxJobs);
+
+    qint64 capacityMb = qEnvironmentVariable("ZORAPERL_THUMBNAIL_CACHE_MB").toLongLong(&ok);
+    if (ok && capacityMb > 0) {
+        m_capacityBytes = quint64(capacityMb) << 20;
+    }
+
+    if (!openIndex()) {
+        qDebug() << "Thumbnail index unavailable; thumbnails are kept in memory only";
+    }
+}
+
+ThumbnailCache::~ThumbnailCache() {
+    // Queued thumbnails are simply generated again next time
+    m_pool->clear();
+    m_pool->waitForDone();
+}
+
+bool ThumbnailCache::canThumbnail(const QFileInfo &info) {
+    static QSet<QString> formats;
+    if (formats.isEmpty()) {
+        const QList<QByteArray> supported = QImageReader::supportedImageFormats();
+        for (const QByteArray &format : supported) {
+            formats.insert(QString::fromLatin1(format).toLower());
+        }
+    }
+    return info.isFile() && formats.contains(info.suffix().toLower());
+}
+
+QImage ThumbnailCache::thumbnail(const QFileInfo &info) {
+    if (!canThumbnail(info)) {
+        return QImage();
+    }
+
+    const QByteArray key = keyFor(info);
+    const int slot = findSlot(key);
+    if (slot >= 0) {
+        indexSlots(m_index)[slot].lastUsed = ++indexHeader(m_index)->clock;
+    }
+    if (QImage *image = m_images.object(key)) {
+        return *image;
+    }
+    if (slot < 0) {
+        return QImage();
+    }
+
+    const IndexSlot &entry = indexSlots(m_index)[slot];
+    const QByteArray content(reinterpret_cast<const char *>(entry.content), sizeof(entry.content));
+    QImage image = mapContent(contentPath(m_directory, content), entry.width, entry.height);
+    if (image.isNull()) {
+        // The stored file went missing; generate it again
+        removeSlot(slot);
+        return QImage();
+    }
+    m_images.insert(key, new QImage(image), imageCost(image));
+    return image;
+}
+
+void ThumbnailCache::request(const QFileInfo &info, Priority priority) {
+    if (!canThumbnail(info)) {
+        return;
+    }
+
+    const QByteArray key = keyFor(info);
+    if (m_inFlight.contains(key) || m_failed.contains(key)) {
+        return;
+    }
+
+    auto queued = m_queued.find(key);
+    if (queued != m_queued.end()) {
+        // The prefetch queue entry is skipped once the job has moved up
+        if (priority == Visible && queued->priority == Prefetch) {
+            queued->priority = Visible;
+            m_visibleQueue.append(key);
+        }
+        return;
+    }
+
+    m_queued.insert(key, Job{info, priority});
+    if (priority == Visible) {
+        m_visibleQueue.append(key);
+    } else {
+        m_prefetchQueue.append(key);
+
+        // A long scroll shouldn't leave thousands of stale prefetches queued
+        while (m_prefetchQueue.size() > kMaxPrefetch) {
+            const QByteArray stale = m_prefetchQueue.takeFirst();
+            auto it = m_queued.find(stale);
+            if (it != m_queued.end() && it->priority == Prefetch) {
+                m_queued.erase(it);
+            }
+        }
+    }
+    startJobs();
+}
+
+void ThumbnailCache::startJobs() {
+    while (m_running < m_maxJobs) {
+        QByteArray key;
+        while (key.isEmpty() && !m_visibleQueue.isEmpty()) {
+            QByteArray next = m_visibleQueue.takeFirst();
+            if (m_queued.contains(next)) {
+                key = next;
+            }
+        }
+        while (key.isEmpty() && !m_prefetchQueue.isEmpty()) {
+            QByteArray next = m_prefetchQueue.takeFirst();
+            auto it = m_queued.constFind(next);
+            if (it != m_queued.constEnd() && it->priority == Prefetch) {
+                key = next;
+            }
+        }
+        if (key.isEmpty()) {
+            return;
+        }
+
+        const Job job = m_queued.take(key);
+        m_inFlight.insert(key);
+        ++m_running;
+
+        QFutureWatcher<Generated> *watcher = new QFutureWatcher<Generated>(this);
+        connect(watcher, &QFutureWatcher<Generated>::finished, this, [this, watcher]() {
+            const Generated generated = watcher->result();
+            watcher->deleteLater();
+            onGenerated(generated);
+        });
+        // Without the index nothing could find a stored file again, so none is written
+        watcher->setFuture(QtConcurrent::run(m_pool, &ThumbnailCache::generate, key,
+                                             job.info.absoluteFilePath(), m_index ? m_directory : QString()));
+    }
+}
+
+void ThumbnailCache::onGenerated(const Generated &generated) {
+    --m_running;
+    m_inFlight.remove(generated.key);
+
+    if (generated.image.isNull()) {
+        m_failed.insert(generated.key);
+    } else {
+        if (!generated.content.isEmpty()) {
+            insertSlot(generated.key, generated);
+        }
+        m_images.insert(generated.key, new QImage(generated.image), imageCost(generated.image));
+        emit thumbnailReady(generated.path);
+    }
+    startJobs();
+}
+
+bool ThumbnailCache::openIndex() {
+    if (!QDir().mkpath(m_directory)) {
+        return false;
+    }
+
+    // A second instance mapping the same index would corrupt it. The lock is
+    // held for the life of the process, so only a dead owner makes it stale.
+    m_indexLock.setStaleLockTime(0);
+    if (!m_indexLock.tryLock(0)) {
+        qDebug() << "Thumbnail cache is in use by another instance";
+        return false;
+    }
+
+    m_indexFile.setFileName(QDir(m_directory).filePath("index"));
+    if (!m_indexFile.open(QIODevice::ReadWrite)) {
+        m_indexLock.unlock();
+        return false;
+    }
+
+    const bool fresh = m_indexFile.size() != kIndexSize;
+    if (fresh && (!m_indexFile.resize(0) || !m_indexFile.resize(kIndexSize))) {
+        m_indexFile.close();
+        m_indexLock.unlock();
+        return false;
+    }
+
+    // Shared and writable: slot updates reach the file without a write call
+    m_index = m_indexFile.map(0, kIndexSize);
+    if (!m_index) {
+        m_indexFile.close();
+        m_indexLock.unlock();
+        return false;
+    }
+
+    const IndexHeader *header = indexHeader(m_index);
+    if (fresh || memcmp(header->magic, kIndexMagic, sizeof(kIndexMagic)) != 0
+        || header->version != kIndexVersion || header->slotCount != kSlotCount
+        || header->thumbnailSize != quint32(kThumbnailSize) || !indexIsConsistent()) {
+        resetStore();
+    } else if (header->orphanBytes > 0) {
+        sweepOrphans();
+    }
+    return true;
+}
+
+bool ThumbnailCache::indexIsConsistent() const {
+    // The probe loops and eviction trust these counters, so a damaged or
+    // half-written index is rebuilt rather than used
+    const IndexHeader *header = indexHeader(m_index);
+    const IndexSlot *table = indexSlots(m_index);
+    quint32 entries = 0;
+    quint64 totalBytes = 0;
+    for (quint32 slot = 0; slot < kSlotCount; ++slot) {
+        if (isFree(table[slot])) {
+            continue;
+        }
+        if (table[slot].width == 0 || table[slot].width > kThumbnailSize
+            || table[slot].height == 0 || table[slot].height > kThumbnailSize) {
+            return false;
+        }
+        ++entries;
+        totalBytes += slotBytes(table[slot]);
+    }
+    return entries == header->entries && entries <= kMaxEntries && totalBytes == header->totalBytes;
+}
+
+void ThumbnailCache::resetStore() {
+    qDebug() << "Resetting thumbnail cache in" << m_directory;
+
+    // Files the old index referred to can't be found any more. Mapped ones
+    // can't be removed on Windows, so the images mapping them go first.
+    m_images.clear();
+    m_orphans.clear();
+    const QFileInfoList stores = QDir(m_directory).entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QFileInfo &store : stores) {
+        QDir(store.absoluteFilePath()).removeRecursively();
+    }
+
+    memset(m_index, 0, kIndexSize);
+    IndexHeader *header = indexHeader(m_index);
+    memcpy(header->magic, kIndexMagic, sizeof(kIndexMagic));
+    header->version = kIndexVersion;
+    header->slotCount = kSlotCount;
+    header->thumbnailSize = kThumbnailSize;
+}
+
+int ThumbnailCache::findSlot(const QByteArray &key) const {
+    if (!m_index) {
+        return -1;
+    }
+
+    quint64 wanted[2];
+    memcpy(wanted, key.constData(), sizeof(wanted));
+
+    const IndexSlot *table = indexSlots(m_index);
+    const quint32 mask = kSlotCount - 1;
+    quint32 slot = quint32(wanted[0]) & mask;
+    for (quint32 probes = 0; probes < kSlotCount; ++probes, slot = (slot + 1) & mask) {
+        if (isFree(table[slot])) {
+            return -1;
+        }
+        if (table[slot].key[0] == wanted[0] && table[slot].key[1] == wanted[1]) {
+            return int(slot);
+        }
+    }
+    return -1;
+}
+
+bool ThumbnailCache::insertSlot(const QByteArray &key, const Generated &generated) {
+    if (!m_index) {
+        return false;
+    }
+    IndexHeader *header = indexHeader(m_index);
+    IndexSlot *table = indexSlots(m_index);
+    const quint32 mask = kSlotCount - 1;
+
+    // A regenerated thumbnail may have new pixels; its old file is removed
+    // below once nothing refers to it
+    QByteArray replacedContent;
+    const int existing = findSlot(key);
+    if (existing >= 0) {
+        replacedContent = QByteArray(reinterpret_cast<const char *>(table[existing].content), 20);
+        m_images.remove(key);
+        removeSlot(existing);
+    }
+
+    // Pixels identical to a file awaiting removal make it live again
+    auto orphan = m_orphans.find(contentPath(m_directory, generated.content));
+    if (orphan != m_orphans.end()) {
+        header->orphanBytes -= qMin(header->orphanBytes, orphan.value());
+        m_orphans.erase(orphan);
+    }
+
+    IndexSlot entry = {};
+    memcpy(entry.key, key.constData(), sizeof(entry.key));
+    memcpy(entry.content, generated.content.constData(), sizeof(entry.content));
+    entry.width = quint16(generated.image.width());
+    entry.height = quint16(generated.image.height());
+    entry.lastUsed = ++header->clock;
+
+    // Eviction keeps entries under kMaxEntries, so a free slot exists unless
+    // the counters are wrong; the probe is bounded all the same
+    quint32 slot = quint32(entry.key[0]) & mask;
+    quint32 probes = 0;
+    while (probes < kSlotCount && !isFree(table[slot])) {
+        slot = (slot + 1) & mask;
+        ++probes;
+    }
+    if (probes == kSlotCount) {
+        qDebug() << "Thumbnail index is full although it counts" << header->entries << "entries";
+        resetStore();
+        return false;
+    }
+    table[slot] = entry;
+    ++header->entries;
+    header->totalBytes += slotBytes(entry);
+
+    if (!replacedContent.isEmpty()) {
+        removeContent({replacedContent});
+    }
+    evict();
+    return true;
+}
+
+void ThumbnailCache::removeSlot(int slot) {
+    IndexHeader *header = indexHeader(m_index);
+    IndexSlot *table = indexSlots(m_index);
+    const quint32 mask = kSlotCount - 1;
+
+    --header->entries;
+    header->totalBytes -= slotBytes(table[slot]);
+
+    // Backward-shift deletion: later entries of the probe run move up into
+    // the hole, so lookups never need tombstones
+    quint32 hole = quint32(slot);
+    quint32 next = hole;
+    for (quint32 probes = 1; probes < kSlotCount; ++probes) {
+        next = (next + 1) & mask;
+        if (isFree(table[next])) {
+            break;
+        }
+        const quint32 home = quint32(table[next].key[0]) & mask;
+        const bool reachable = hole <= next ? (hole < home && home <= next) : (hole < home || home <= next);
+        if (!reachable) {
+            table[hole] = table[next];
+            hole = next;
+        }
+    }
+    memset(&table[hole], 0, sizeof(IndexSlot));
+}
+
+void ThumbnailCache::evict() {
+    IndexHeader *header = indexHeader(m_index);
+    if (!m_orphans.isEmpty()) {
+        removeOrphans();
+    }
+    if (header->totalBytes + header->orphanBytes <= m_capacityBytes && header->entries <= kMaxEntries) {
+        return;
+    }
+    TraceSpan span("ThumbnailCache::evict", "desktop");
+
+    // Oldest first, down to 90% of the limits so this doesn't run on every insert
+    struct Candidate {
+        quint64 lastUsed;
+        QByteArray key;
+    };
+    QList<Candidate> candidates;
+    candidates.reserve(header->entries);
+    const IndexSlot *table = indexSlots(m_index);
+    for (quint32 slot = 0; slot < kSlotCount; ++slot) {
+        if (!isFree(table[slot])) {
+            candidates.append({table[slot].lastUsed,
+                               QByteArray(reinterpret_cast<const char *>(table[slot].key), 16)});
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) {
+        return a.lastUsed < b.lastUsed;
+    });
+
+    const quint64 targetBytes = m_capacityBytes / 10 * 9;
+    const quint32 targetEntries = kMaxEntries / 10 * 9;
+    QSet<QByteArray> evictedContent;
+    for (const Candidate &candidate : std::as_const(candidates)) {
+        if (header->totalBytes + header->orphanBytes <= targetBytes && header->entries <= targetEntries) {
+            break;
+        }
+        const int slot = findSlot(candidate.key);
+        if (slot < 0) {
+            continue;
+        }
+        // The image maps the file, which Windows won't remove while mapped
+        m_images.remove(candidate.key);
+        evictedContent.insert(QByteArray(reinterpret_cast<const char *>(table[slot].content), 20));
+        removeSlot(slot);
+    }
+    removeContent(evictedContent);
+}
+
+void ThumbnailCache::removeContent(QSet<QByteArray> contents) {
+    // Identical thumbnails share one file; keep those still referenced
+    const IndexSlot *table = indexSlots(m_index);
+    for (quint32 slot = 0; slot < kSlotCount && !contents.isEmpty(); ++slot) {
+        if (!isFree(table[slot])) {
+            contents.remove(QByteArray(reinterpret_cast<const char *>(table[slot].content), 20));
+        }
+    }
+
+    // A file someone still maps stays on disk and counts against the
+    // capacity until removeOrphans() gets it
+    IndexHeader *header = indexHeader(m_index);
+    for (const QByteArray &content : std::as_const(contents)) {
+        const QString path = contentPath(m_directory, content);
+        const QFileInfo info(path);
+        if (!info.exists() || m_orphans.contains(path)) {
+            continue;
+        }
+        const quint64 size = quint64(info.size());
+        if (!QFile::remove(path)) {
+            m_orphans.insert(path, size);
+            header->orphanBytes += size;
+        }
+    }
+}
+
+void ThumbnailCache::removeOrphans() {
+    IndexHeader *header = indexHeader(m_index);
+    for (auto it = m_orphans.begin(); it != m_orphans.end();) {
+        if (QFile::remove(it.key()) || !QFileInfo::exists(it.key())) {
+            header->orphanBytes -= qMin(header->orphanBytes, it.value());
+            it = m_orphans.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void ThumbnailCache::sweepOrphans() {
+    // Only after a session that left files behind: anything stored that no
+    // entry names is removed now that no image maps it
+    TraceSpan span("ThumbnailCache::sweepOrphans", "desktop");
+
+    QSet<QString> referenced;
+    const IndexSlot *table = indexSlots(m_index);
+    for (quint32 slot = 0; slot < kSlotCount; ++slot) {
+        if (!isFree(table[slot])) {
+            const QByteArray content(reinterpret_cast<const char *>(table[slot].content), 20);
+            referenced.insert(QString::fromLatin1(content.toHex()) + ".thumb");
+        }
+    }
+
+    quint64 remaining = 0;
+    const QFileInfoList stores = QDir(m_directory).entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QFileInfo &store : stores) {
+        const QFileInfoList files = QDir(store.absoluteFilePath()).entryInfoList({"*.thumb"}, QDir::Files);
+        for (const QFileInfo &file : files) {
+            // Same spelling as contentPath(), which insertSlot() looks orphans up by
+            const QString path = QString("%1/%2/%3").arg(m_directory, store.fileName(), file.fileName());
+            if (referenced.contains(file.fileName()) || QFile::remove(path)) {
+                continue;
+            }
+            m_orphans.insert(path, quint64(file.size()));
+            remaining += quint64(file.size());
+        }
+    }
+    indexHeader(m_index)->orphanBytes = remaining;
+}
+
+QByteArray ThumbnailCache::keyFor(const QFileInfo &info) {
+    // Stat data identifies the source, so a lookup never reads the file itself
+    QByteArray identity;
+    QDataStream stream(&identity, QIODevice::WriteOnly);
+    stream << info.absoluteFilePath() << info.size() << info.lastModified().toMSecsSinceEpoch()
+           << qint32(kThumbnailSize);
+
+    QByteArray key = QCryptographicHash::hash(identity, QCryptographicHash::Sha1).left(16);
+    if (key == QByteArray(key.size(), '\0')) {
+        key[0] = 1;
+    }
+    return key;
+}
+
+QString ThumbnailCache::contentPath(const QString &directory, const QByteArray &content) {
+    const QString hex = QString::fromLatin1(content.toHex());
+    return QString("%1/%2/%3.thumb").arg(directory, hex.left(2), hex);
+}
+
+ThumbnailCache::Generated ThumbnailCache::generate(const QByteArray &key, const QString &path,
+                                                   const QString &directory) {
+    TraceSpan span("ThumbnailCache::generate", "desktop");
+
+    Generated generated;
+    generated.key = key;
+    generated.path = path;
+
+    QImageReader reader(path);
+    reader.setAutoTransform(true);
+
+    // Let the decoder shrink large photos itself (JPEG does so almost for free)
+    const QSize sourceSize = reader.size();
+    const bool rotated = reader.transformation() & QImageIOHandler::TransformationRotate90;
+    if (sourceSize.isValid() && !rotated
+        && (sourceSize.width() > kThumbnailSize || sourceSize.height() > kThumbnailSize)) {
+        reader.setScaledSize(sourceSize.scaled(kThumbnailSize, kThumbnailSize, Qt::KeepAspectRatio));
+    }
+
+    QImage image = reader.read();
+    if (image.isNull()) {
+        qDebug() << "Cannot thumbnail" << path << ":" << reader.errorString();
+        return generated;
+    }
+    if (image.width() > kThumbnailSize || image.height() > kThumbnailSize) {
+        image = image.scaled(kThumbnailSize, kThumbnailSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    }
+    image = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    generated.image = image;
+    if (directory.isEmpty()) {
+        // Memory only; an empty content means nothing was stored
+        return generated;
+    }
+
+    // 32-bit rows are never padded, so the stored file is exactly the pixels
+    const QByteArray pixels = QByteArray::fromRawData(reinterpret_cast<const char *>(image.constBits()),
+                                                      image.sizeInBytes());
+    generated.content = QCryptographicHash::hash(pixels, QCryptographicHash::Sha1);
+
+    const QString filePath = contentPath(directory, generated.content);
+    if (QFileInfo::exists(filePath)) {
+        return generated;
+    }
+
+    QSaveFile file(filePath);
+    if (!QDir().mkpath(QFileInfo(filePath).path()) || !file.open(QIODevice::WriteOnly)
+        || file.write(pixels) != pixels.size() || !file.commit()) {
+        qDebug() << "Cannot write thumbnail" << filePath;
+        generated.content.clear();
+    }
+    return generated;
+}
+
+QImage ThumbnailCache::mapContent(const QString &filePath, int width, int height) {
+    QFile *file = new QFile(filePath);
+    const qint64 size = qint64(width) * height * 4;
+    if (size <= 0 || !file->open(QIODevice::ReadOnly) || file->size() != size) {
+        delete file;
+        return QImage();
+    }
+
+    uchar *mapped = file->map(0, size);
+    if (!mapped) {
+        delete file;
+        return QImage();
+    }
+
+    // Read-only image over the mapping; the file lives as long as the image data
+    return QImage(static_cast<const uchar *>(mapped), width, height, qsizetype(width) * 4,
+                  QImage::Format_ARGB32_Premultiplied, releaseMappedFile, file);
+}
@@ -0,0 +1,112 @@
+#ifndef THUMBNAIL_CACHE_H
+#define THUMBNAIL_CACHE_H
+
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QList>
+#include <QHash>
+#include <QSet>
+#include <QCache>
+#include <QImage>
+#include <QFile>
+#include <QLockFile>
+#include <QFileInfo>
+
+class QThreadPool;
+
+// Persistent thumbnails for the desktop and file views, at most
+// kThumbnailSize pixels on a side. Pixels are stored raw under
+// ZoraPerl/system/cache/thumbnails, one file per distinct thumbnail named
+// by the SHA-1 of its pixels. A memory-mapped open-addressing table maps a
+// file's path, size and mtime to its thumbnail, so checking for one reads
+// mapped memory only and a miss costs no system call at all.
+//
+// Missing thumbnails are generated on a small pool, visible items first,
+// and the least recently used ones are evicted once the store exceeds
+// ZORAPERL_THUMBNAIL_CACHE_MB (256 by default). Files that cannot be
+// removed yet (on Windows, while still mapped) count against that limit
+// until a later eviction or startup removes them.
+//
+// One process owns the store at a time; another instance running at the
+// same time keeps its thumbnails in memory only. GUI thread only.
+class ThumbnailCache : public QObject {
+    Q_OBJECT
+
+public:
+    enum Priority {
+        Visible,
+        Prefetch
+    };
+
+    static ThumbnailCache &instance();
+    ~ThumbnailCache();
+
+    static bool canThumbnail(const QFileInfo &info);
+
+    // The stored thumbnail, memory-mapped, or a null image
+    QImage thumbnail(const QFileInfo &info);
+
+    // Generates a missing thumbnail and emits thumbnailReady() or nothing on failure.
+    // Asking again with Visible moves a queued prefetch ahead.
+    void request(const QFileInfo &info, Priority priority = Visible);
+
+    static const int kThumbnailSize = 128;
+
+signals:
+    void thumbnailReady(const QString &path);
+
+private:
+    struct Job {
+        QFileInfo info;
+        Priority priority;
+    };
+
+    struct Generated {
+        QByteArray key;
+        QString path;
+        QImage image;
+        QByteArray content;     // SHA-1 of the pixels, names the stored file
+    };
+
+    explicit ThumbnailCache(QObject *parent = nullptr);
+
+    bool openIndex();
+    bool indexIsConsistent() const;
+    void resetStore();
+    int findSlot(const QByteArray &key) const;
+    bool insertSlot(const QByteArray &key, const Generated &generated);
+    void removeSlot(int slot);
+    void evict();
+    void removeContent(QSet<QByteArray> contents);
+    void removeOrphans();
+    void sweepOrphans();
+
+    void startJobs();
+    void onGenerated(const Generated &generated);
+
+    static QByteArray keyFor(const QFileInfo &info);
+    static QString contentPath(const QString &directory, const QByteArray &content);
+    static Generated generate(const QByteArray &key, const QString &path, const QString &directory);
+    static QImage mapContent(const QString &filePath, int width, int height);
+
+    QString m_directory;
+    QLockFile m_indexLock;
+    QFile m_indexFile;
+    uchar *m_index;
+    QHash<QString, quint64> m_orphans;      // stored files that could not be removed yet
+
+    QCache<QByteArray, QImage> m_images;    // cost in KiB
+    QSet<QByteArray> m_failed;
+
+    QThreadPool *m_pool;
+    int m_maxJobs;
+    int m_running;
+    QHash<QByteArray, Job> m_queued;
+    QList<QByteArray> m_visibleQueue;
+    QList<QByteArray> m_prefetchQueue;
+    QSet<QByteArray> m_inFlight;
+    quint64 m_capacityBytes;
+};
+
+#endif // THUMBNAIL_CACHE_H
@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+"""Pack the Python standard library and ZoraPerl scripts into pythonXY.zip.
+
+The zip holds only precompiled bytecode: each module is stored as a .pyc at
+its import path (json/__init__.pyc, os.pyc, ...), which zipimport loads
+directly. Entries are stored uncompressed so imports need neither zlib nor a
+decompression pass. Run it with the same interpreter version the desktop
+embeds; bytecode from another version is ignored by zipimport.
+
+    build_python_bundle.py --output python312.zip --optimize 1 --scripts scripts
+"""
+
+import argparse
+import importlib.util
+import marshal
+import os
+import sys
+import sysconfig
+import zipfile
+
+# Packages a desktop session never imports
+EXCLUDED = {
+    "__pycache__",
+    "ensurepip",
+    "idlelib",
+    "lib2to3",
+    "pydoc_data",
+    "site-packages",
+    "dist-packages",
+    "lib-dynload",
+    "test",
+    "tests",
+    "tkinter",
+    "turtledemo",
+    "venv",
+}
+
+# Fixed timestamp so the same inputs give a byte-identical zip
+ZIP_DATE = (1980, 1, 1, 0, 0, 0)
+
+
+def is_excluded(name):
+    return name in EXCLUDED or name.startswith("config-")
+
+
+def timestamp_pyc(code, source_stat):
+    data = bytearray(importlib.util.MAGIC_NUMBER)
+    data += (0).to_bytes(4, "little")
+    data += (int(source_stat.st_mtime) & 0xFFFFFFFF).to_bytes(4, "little")
+    data += (source_stat.st_size & 0xFFFFFFFF).to_bytes(4, "little")
+    data += marshal.dumps(code)
+    return bytes(data)
+
+
+def collect(root):
+    """Yield (path on disk, path inside the zip) for every .py under root."""
+    for directory, subdirs, files in os.walk(root):
+        subdirs[:] = sorted(d for d in subdirs if not is_excluded(d))
+        for name in sorted(files):
+            if name.endswith(".py"):
+                path = os.path.join(directory, name)
+                yield path, os.path.relpath(path, root).replace(os.sep, "/")
+
+
+def add_tree(bundle, root, optimize, seen):
+    added = 0
+    for path, arcname in collect(root):
+        if arcname in seen:
+            continue
+        seen.add(arcname)
+
+        with open(path, "rb") as source:
+            text = source.read()
+        try:
+            code = compile(text, arcname, "exec", dont_inherit=True, optimize=optimize)
+        except (SyntaxError, ValueError) as error:
+            print(f"skipping {path}: {error}", file=sys.stderr)
+            continue
+
+        info = zipfile.ZipInfo(arcname[:-3] + ".pyc", ZIP_DATE)
+        info.compress_type = zipfile.ZIP_STORED
+        bundle.writestr(info, timestamp_pyc(code, os.stat(path)))
+        added += 1
+    return added
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--output", required=True, help="zip file to write")
+    parser.add_argument("--stdlib", default=sysconfig.get_paths()["stdlib"],
+                        help="standard library directory (default: this interpreter's)")
+    parser.add_argument("--scripts", action="append", default=[],
+                        help="script directory to pack at the zip root; may be repeated")
+    parser.add_argument("--optimize", type=int, choices=(0, 1, 2), default=0,
+                        help="bytecode optimization level, as python -O/-OO")
+    args = parser.parse_args()
+
+    # Scripts go first so they win over stdlib modules of the same name
+    roots = [d for d in args.scripts if os.path.isdir(d)] + [args.stdlib]
+
+    temporary = args.output + ".tmp"
+    seen = set()
+    with zipfile.ZipFile(temporary, "w") as bundle:
+        for root in roots:
+            count = add_tree(bundle, root, args.optimize, seen)
+            print(f"{root}: {count} modules")
+    os.replace(temporary, args.output)
+
+    print(f"wrote {args.output} ({os.path.getsize(args.output) // 1024} KiB, optimize={args.optimize})")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,236 @@
+#include "wallpaper_engine.h"
+#include "startup_trace.h"
+#include "zora_layout.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QPainter>
+#include <QSaveFile>
+#include <QtConcurrent>
+#include <cstring>
+
+namespace {
+// Raw pixels follow this header at kPixelOffset, rows bytesPerLine apart
+struct CacheHeader {
+    char magic[8];
+    quint32 version;
+    quint32 width;
+    quint32 height;
+    quint32 bytesPerLine;
+    quint32 format;
+    quint32 reserved;
+};
+
+const char kCacheMagic[8] = {'Z', 'P', 'W', 'A', 'L', 'L', '\0', '\0'};
+const qint64 kPixelOffset = 64;
+static_assert(sizeof(CacheHeader) <= kPixelOffset, "cache header overlaps the pixels");
+
+void releaseMappedFile(void *file) {
+    // Closing the file unmaps the pixels
+    delete static_cast<QFile *>(file);
+}
+}
+
+WallpaperEngine::WallpaperEngine(QObject *parent)
+    : QObject(parent) {
+    connect(&m_watcher, &QFutureWatcher<QImage>::finished, this, &WallpaperEngine::onDecoded);
+}
+
+void WallpaperEngine::setCacheDirectory(const QString &path) {
+    m_cacheDirectory = path;
+}
+
+QString WallpaperEngine::cacheDirectory() const {
+    return m_cacheDirectory.isEmpty() ? ZoraLayout::path("system/cache/wallpapers") : m_cacheDirectory;
+}
+
+QImage WallpaperEngine::cached(const QString &path, const QSize &pixelSize) const {
+    QString cachePath = cacheFilePath(path, pixelSize, cacheDirectory());
+    return cachePath.isEmpty() ? QImage() : mapCacheFile(cachePath);
+}
+
+void WallpaperEngine::request(const QString &path, const QSize &pixelSize) {
+    if (m_watcher.isRunning()) {
+        m_pendingPath = path;
+        m_pendingSize = pixelSize;
+        return;
+    }
+    start(path, pixelSize);
+}
+
+void WallpaperEngine::start(const QString &path, const QSize &pixelSize) {
+    m_runningPath = path;
+    m_watcher.setFuture(QtConcurrent::run(&WallpaperEngine::load, path, pixelSize, cacheDirectory()));
+}
+
+void WallpaperEngine::onDecoded() {
+    QImage image = m_watcher.result();
+    QString path = m_runningPath;
+
+    // Only the latest request that piled up meanwhile is still wanted
+    if (!m_pendingPath.isEmpty()) {
+        start(m_pendingPath, m_pendingSize);
+        m_pendingPath.clear();
+    }
+
+    if (image.isNull()) {
+        emit failed(path);
+    } else {
+        emit ready(path, image);
+    }
+}
+
+QImage WallpaperEngine::load(const QString &path, const QSize &pixelSize, const QString &cacheDirectory) {
+    TraceSpan span("WallpaperEngine::load", "desktop");
+
+    QString cachePath = cacheFilePath(path, pixelSize, cacheDirectory);
+    if (cachePath.isEmpty()) {
+        qDebug() << "Wallpaper not found:" << path;
+        return QImage();
+    }
+
+    QImage image = mapCacheFile(cachePath);
+    if (!image.isNull()) {
+        return image;
+    }
+
+    image = decode(path, pixelSize);
+    if (!image.isNull()) {
+        storeCacheFile(cachePath, image, cacheDirectory);
+    }
+    return image;
+}
+
+QString WallpaperEngine::cacheFilePath(const QString &path, const QSize &pixelSize, const QString &cacheDirectory) {
+    // The source is identified by its stat data rather than a hash of its
+    // contents, so checking the cache never reads the photo itself
+    QFileInfo source(path);
+    if (!source.isFile() || pixelSize.isEmpty()) {
+        return QString();
+    }
+
+    QByteArray identity;
+    QDataStream stream(&identity, QIODevice::WriteOnly);
+    stream << source.absoluteFilePath() << source.size()
+           << source.lastModified().toMSecsSinceEpoch()
+           << pixelSize << qint32(kCacheVersion);
+
+    QByteArray key = QCryptographicHash::hash(identity, QCryptographicHash::Sha1).toHex();
+    return QDir(cacheDirectory).absoluteFilePath(QString::fromLatin1(key) + ".wall");
+}
+
+QImage WallpaperEngine::mapCacheFile(const QString &cachePath) {
+    QFile *file = new QFile(cachePath);
+    if (!file->open(QIODevice::ReadOnly) || file->size() < kPixelOffset) {
+        delete file;
+        return QImage();
+    }
+
+    uchar *mapped = file->map(0, file->size());
+    if (!mapped) {
+        delete file;
+        return QImage();
+    }
+
+    CacheHeader header;
+    memcpy(&header, mapped, sizeof(header));
+    qint64 expectedSize = kPixelOffset + qint64(header.bytesPerLine) * header.height;
+    if (memcmp(header.magic, kCacheMagic, sizeof(kCacheMagic)) != 0 || header.version != kCacheVersion
+        || header.format == QImage::Format_Invalid || header.format >= QImage::NImageFormats
+        || file->size() != expectedSize) {
+        delete file;
+        return QImage();
+    }
+
+    // Read-only image over the mapping; the file lives as long as the image data
+    return QImage(static_cast<const uchar *>(mapped) + kPixelOffset, int(header.width), int(header.height),
+                  qsizetype(header.bytesPerLine), QImage::Format(header.format), releaseMappedFile, file);
+}
+
+QImage WallpaperEngine::decode(const QString &path, const QSize &pixelSize) {
+    TraceSpan span("WallpaperEngine::decode", "desktop");
+
+    QImageReader reader(path);
+    reader.setAutoTransform(true);
+
+    // JPEG can decode at 1/2, 1/4 or 1/8 size for nearly free; stopping at
+    // twice the needed size leaves the smooth scaler something to work with.
+    // Skipped for rotated photos, where the scaled size would apply pre-rotation.
+    QSize sourceSize = reader.size();
+    bool rotated = reader.transformation() & QImageIOHandler::TransformationRotate90;
+    if (sourceSize.isValid() && !rotated) {
+        QSize cover = sourceSize.scaled(pixelSize, Qt::KeepAspectRatioByExpanding);
+        if (sourceSize.width() > cover.width() * 2 && sourceSize.height() > cover.height() * 2) {
+            reader.setScaledSize(cover * 2);
+        }
+    }
+
+    QImage image = reader.read();
+    if (image.isNull()) {
+        qDebug() << "Cannot decode wallpaper" << path << ":" << reader.errorString();
+        return QImage();
+    }
+
+    // Opaque RGB32 blits fastest; transparent images go over black first
+    if (image.hasAlphaChannel()) {
+        QImage opaque(image.size(), QImage::Format_RGB32);
+        opaque.fill(Qt::black);
+        QPainter painter(&opaque);
+        painter.drawImage(0, 0, image);
+        painter.end();
+        image = opaque;
+    } else if (image.format() != QImage::Format_RGB32) {
+        image = image.convertToFormat(QImage::Format_RGB32);
+    }
+
+    // Fill the target and crop the overflow evenly. Qt's smooth scaler
+    // uses its SSE4.1/AVX2/NEON paths for RGB32.
+    QSize cover = image.size().scaled(pixelSize, Qt::KeepAspectRatioByExpanding);
+    if (cover != image.size()) {
+        image = image.scaled(cover, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    }
+    if (image.size() != pixelSize) {
+        QRect crop(QPoint((image.width() - pixelSize.width()) / 2, (image.height() - pixelSize.height()) / 2),
+                   pixelSize);
+        image = image.copy(crop);
+    }
+    return image;
+}
+
+void WallpaperEngine::storeCacheFile(const QString &cachePath, const QImage &image, const QString &cacheDirectory) {
+    QDir directory(cacheDirectory);
+    if (!directory.mkpath(".")) {
+        return;
+    }
+
+    CacheHeader header = {};
+    memcpy(header.magic, kCacheMagic, sizeof(kCacheMagic));
+    header.version = kCacheVersion;
+    header.width = image.width();
+    header.height = image.height();
+    header.bytesPerLine = image.bytesPerLine();
+    header.format = image.format();
+
+    QByteArray prefix(kPixelOffset, '\0');
+    memcpy(prefix.data(), &header, sizeof(header));
+
+    QSaveFile file(cachePath);
+    if (!file.open(QIODevice::WriteOnly)
+        || file.write(prefix) != prefix.size()
+        || file.write(reinterpret_cast<const char *>(image.constBits()), image.sizeInBytes()) != image.sizeInBytes()
+        || !file.commit()) {
+        qDebug() << "Cannot write wallpaper cache" << cachePath;
+        return;
+    }
+
+    // A 4K variant is 32 MB; keep only the most recently written ones
+    const QFileInfoList variants = directory.entryInfoList(QStringList{"*.wall"}, QDir::Files, QDir::Time);
+    for (int i = kCachedVariants; i < variants.size(); ++i) {
+        QFile::remove(variants.at(i).absoluteFilePath());
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef WALLPAPER_ENGINE_H
+#define WALLPAPER_ENGINE_H
+
+#include <QObject>
+#include <QString>
+#include <QSize>
+#include <QImage>
+#include <QFutureWatcher>
+
+// Decodes image wallpapers (PNG, JPEG, and WebP where the Qt image format
+// plugin is installed) on the thread pool, scaled and cropped to fill a
+// target size in device pixels. Each scaled variant is stored raw under
+// ZoraPerl/system/cache/wallpapers, keyed by the source file's path, size
+// and mtime plus the target size, so a later boot maps the finished pixels
+// instead of decoding the photo again.
+class WallpaperEngine : public QObject {
+    Q_OBJECT
+
+public:
+    explicit WallpaperEngine(QObject *parent = nullptr);
+
+    void setCacheDirectory(const QString &path);
+    QString cacheDirectory() const;
+
+    // The cached variant, memory-mapped, or a null image. Cheap enough for
+    // the GUI thread: one stat of the source and one of the cache file.
+    QImage cached(const QString &path, const QSize &pixelSize) const;
+
+    // Decodes on the thread pool and emits ready() or failed(). A request
+    // made while another runs replaces any request still waiting.
+    void request(const QString &path, const QSize &pixelSize);
+
+    // Any thread: the cached variant, or a fresh decode that is then cached
+    static QImage load(const QString &path, const QSize &pixelSize, const QString &cacheDirectory);
+
+signals:
+    void ready(const QString &path, const QImage &image);
+    void failed(const QString &path);
+
+private slots:
+    void onDecoded();
+
+private:
+    void start(const QString &path, const QSize &pixelSize);
+
+    static QString cacheFilePath(const QString &path, const QSize &pixelSize, const QString &cacheDirectory);
+    static QImage mapCacheFile(const QString &cachePath);
+    static QImage decode(const QString &path, const QSize &pixelSize);
+    static void storeCacheFile(const QString &cachePath, const QImage &image, const QString &cacheDirectory);
+
+    QString m_cacheDirectory;
+    QFutureWatcher<QImage> m_watcher;
+    QString m_runningPath;
+    QString m_pendingPath;
+    QSize m_pendingSize;
+
+    static const int kCacheVersion = 1;
+    static const int kCachedVariants = 8;
+};
+
+#endif // WALLPAPER_ENGINE_H
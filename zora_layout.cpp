@@ -0,0 +1,270 @@
+#include "zora_layout.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QCborMap>
+#include <QCborValue>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QDebug>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+QMutex g_layoutMutex;
+QString g_rootPath;
+
+const int kLayoutCacheVersion = 1;
+const int kSearchDepth = 5;
+}
+
+QString ZoraLayout::rootPath() {
+    QMutexLocker locker(&g_layoutMutex);
+    if (!g_rootPath.isEmpty()) {
+        return g_rootPath;
+    }
+
+    g_rootPath = loadCachedRoot();
+    if (!g_rootPath.isEmpty()) {
+        qDebug() << "ZoraPerl root (cached):" << g_rootPath;
+        return g_rootPath;
+    }
+
+    bool found = false;
+    g_rootPath = resolveRoot(&found);
+    qDebug() << "ZoraPerl root:" << g_rootPath << (found ? "" : "(not created yet)");
+
+    // Only an existing directory has an identity the cache can be validated against
+    if (found) {
+        storeCachedRoot(g_rootPath);
+    }
+
+    return g_rootPath;
+}
+
+QString ZoraLayout::path(const QString &relative) {
+    return QDir(rootPath()).absoluteFilePath(relative);
+}
+
+QString ZoraLayout::configFilePath() {
+    return path("etc/config.json");
+}
+
+const QStringList &ZoraLayout::requiredDirectories() {
+    static const QStringList directories = {"bin", "compat", "etc", "system", "users"};
+    return directories;
+}
+
+QStringList ZoraLayout::missingDirectories() {
+    QString root = rootPath();
+    QStringList missing;
+
+#ifndef _WIN32
+    // Open the root once and check every entry relative to it, so each check
+    // is a single fstatat instead of a full path walk
+    int rootFd = ::open(QFile::encodeName(root).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (rootFd < 0) {
+        return requiredDirectories();
+    }
+
+    for (const QString &directory : requiredDirectories()) {
+        struct stat info;
+        if (::fstatat(rootFd, QFile::encodeName(directory).constData(), &info, 0) != 0 || !S_ISDIR(info.st_mode)) {
+            missing.append(directory);
+        }
+    }
+
+    ::close(rootFd);
+#else
+    QDir rootDir(root);
+    for (const QString &directory : requiredDirectories()) {
+        if (!QFileInfo(rootDir.absoluteFilePath(directory)).isDir()) {
+            missing.append(directory);
+        }
+    }
+#endif
+
+    return missing;
+}
+
+bool ZoraLayout::createMissingDirectories() {
+    QString root = rootPath();
+    QDir rootDir(root);
+
+    if (!rootDir.exists()) {
+        qDebug() << "Creating ZoraPerl directory structure at:" << root;
+        if (!rootDir.mkpath(".")) {
+            qDebug() << "Failed to create ZoraPerl directory";
+            return false;
+        }
+        // The root now exists, so it can be cached
+        storeCachedRoot(root);
+    }
+
+    bool success = true;
+    for (const QString &directory : missingDirectories()) {
+        if (rootDir.mkdir(directory)) {
+            qDebug() << "Created" << directory << "directory";
+        } else {
+            qDebug() << "Failed to create" << directory << "directory";
+            success = false;
+        }
+    }
+
+    return success;
+}
+
+void ZoraLayout::invalidateCache() {
+    QMutexLocker locker(&g_layoutMutex);
+    g_rootPath.clear();
+    QFile::remove(cacheFilePath());
+}
+
+QString ZoraLayout::resolveRoot(bool *found) {
+    QDir appDir(QCoreApplication::applicationDirPath());
+    *found = true;
+
+    // Running from inside the install
+    if (appDir.dirName() == "ZoraPerl") {
+        return appDir.absolutePath();
+    }
+
+    // ZoraPerl next to the executable or next to one of its ancestors
+    QDir searchDir = appDir;
+    for (int i = 0; i <= kSearchDepth; ++i) {
+        QFileInfo candidate(searchDir.absoluteFilePath("ZoraPerl"));
+        if (candidate.isDir()) {
+            return candidate.absoluteFilePath();
+        }
+        if (!searchDir.cdUp()) {
+            break;
+        }
+    }
+
+    // Same search starting from the working directory
+    searchDir = QDir::current();
+    for (int i = 0; i <= kSearchDepth; ++i) {
+        QFileInfo candidate(searchDir.absoluteFilePath("ZoraPerl"));
+        if (candidate.isDir()) {
+            return candidate.absoluteFilePath();
+        }
+        if (!searchDir.cdUp()) {
+            break;
+        }
+    }
+
+    // Not installed yet: place it inside the Zora_Perl checkout if we are in one
+    *found = false;
+    searchDir = appDir;
+    do {
+        if (searchDir.dirName() == "Zora_Perl") {
+            return searchDir.absoluteFilePath("ZoraPerl");
+        }
+    } while (searchDir.cdUp());
+
+    return appDir.absoluteFilePath("ZoraPerl");
+}
+
+ZoraLayout::DirectoryIdentity ZoraLayout::directoryIdentity(const QString &path) {
+    DirectoryIdentity identity;
+
+#ifndef _WIN32
+    struct stat info;
+    if (::stat(QFile::encodeName(path).constData(), &info) == 0 && S_ISDIR(info.st_mode)) {
+        identity.device = static_cast<quint64>(info.st_dev);
+        identity.inode = static_cast<quint64>(info.st_ino);
+        identity.valid = true;
+    }
+#else
+    // No inode through Qt on Windows; the creation time identifies a recreated directory
+    QFileInfo info(path);
+    if (info.isDir()) {
+        identity.inode = static_cast<quint64>(info.birthTime().toMSecsSinceEpoch());
+        identity.valid = true;
+    }
+#endif
+
+    return identity;
+}
+
+QString ZoraLayout::cacheFilePath() {
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + "/ZoraPerl/layout.cbor";
+}
+
+QString ZoraLayout::cacheKey() {
+    // Resolution depends on where we were started from
+    return QCoreApplication::applicationDirPath() + '|' + QDir::currentPath();
+}
+
+QString ZoraLayout::loadCachedRoot() {
+    QFile cacheFile(cacheFilePath());
+    if (!cacheFile.open(QIODevice::ReadOnly)) {
+        return QString();
+    }
+
+    QCborMap cache = QCborValue::fromCbor(cacheFile.readAll()).toMap();
+    if (cache.value(QStringLiteral("version")).toInteger() != kLayoutCacheVersion) {
+        return QString();
+    }
+
+    QCborMap entry = cache.value(cacheKey()).toMap();
+    QString root = entry.value(QStringLiteral("root")).toString();
+    if (root.isEmpty()) {
+        return QString();
+    }
+
+    // A single stat: the entry is valid while the directory is the same one
+    DirectoryIdentity identity = directoryIdentity(root);
+    if (!identity.valid
+        || static_cast<quint64>(entry.value(QStringLiteral("device")).toInteger()) != identity.device
+        || static_cast<quint64>(entry.value(QStringLiteral("inode")).toInteger()) != identity.inode) {
+        qDebug() << "Layout cache entry is stale:" << root;
+        return QString();
+    }
+
+    return root;
+}
+
+void ZoraLayout::storeCachedRoot(const QString &root) {
+    DirectoryIdentity identity = directoryIdentity(root);
+    if (!identity.valid) {
+        return;
+    }
+
+    QString cachePath = cacheFilePath();
+    QDir().mkpath(QFileInfo(cachePath).absolutePath());
+
+    QCborMap cache;
+    QFile existing(cachePath);
+    if (existing.open(QIODevice::ReadOnly)) {
+        cache = QCborValue::fromCbor(existing.readAll()).toMap();
+        existing.close();
+    }
+    if (cache.value(QStringLiteral("version")).toInteger() != kLayoutCacheVersion) {
+        cache = QCborMap();
+    }
+
+    QCborMap entry;
+    entry.insert(QStringLiteral("root"), root);
+    entry.insert(QStringLiteral("device"), static_cast<qint64>(identity.device));
+    entry.insert(QStringLiteral("inode"), static_cast<qint64>(identity.inode));
+
+    cache.insert(QStringLiteral("version"), kLayoutCacheVersion);
+    cache.insert(cacheKey(), entry);
+
+    QSaveFile cacheFile(cachePath);
+    if (!cacheFile.open(QIODevice::WriteOnly)) {
+        qDebug() << "Cannot write layout cache:" << cachePath;
+        return;
+    }
+    cacheFile.write(QCborValue(cache).toCbor());
+    cacheFile.commit();
+}
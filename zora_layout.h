@@ -0,0 +1,39 @@
+#ifndef ZORA_LAYOUT_H
+#define ZORA_LAYOUT_H
+
+#include <QString>
+#include <QStringList>
+
+// Resolves the ZoraPerl install root and its directory layout. Shared by the
+// desktop and the onboarding tool so both agree on where the install lives.
+// The resolved root is cached in-process and on disk; the disk entry is
+// trusted for as long as the root directory keeps the same identity (inode).
+class ZoraLayout {
+public:
+    static QString rootPath();
+    static QString path(const QString &relative);
+    static QString configFilePath();
+
+    static const QStringList &requiredDirectories();
+    static QStringList missingDirectories();
+    static bool createMissingDirectories();
+
+    static void invalidateCache();
+
+private:
+    struct DirectoryIdentity {
+        quint64 device = 0;
+        quint64 inode = 0;
+        bool valid = false;
+    };
+
+    static QString resolveRoot(bool *found);
+    static DirectoryIdentity directoryIdentity(const QString &path);
+
+    static QString cacheFilePath();
+    static QString cacheKey();
+    static QString loadCachedRoot();
+    static void storeCachedRoot(const QString &root);
+};
+
+#endif // ZORA_LAYOUT_H
@@ -14,9 +14,25 @@
 #include "system_checker.h"
 #include "python_manager.h"
 #include "desktop_environment.h"
+#include "startup_orchestrator.h"
+#include "startup_trace.h"
+#include "onboardingflow.h"
+#include "python_zygote.h"
+#include <functional>
 
 int main(int argc, char *argv[]) {
+    // Out-of-process Python workers are forked from a copy of this binary
+    if (argc > 1 && qstrcmp(argv[1], "--python-zygote") == 0) {
+        return PythonZygote::serve(argc, argv);
+    }
+    
+    // Start the trace clock before anything else so the spans cover all of startup
+    StartupTrace &trace = StartupTrace::instance();
+    trace.configure(argc, argv);
+    
+    qint64 appStart = trace.elapsedMicroseconds();
     QApplication app(argc, argv);
+    trace.addComplete("QApplication", "startup", appStart, trace.elapsedMicroseconds() - appStart);
     
     // Set application properties
     app.setApplicationName("ZoraPerl");
@@ -24,6 +40,7 @@ int main(int argc, char *argv[]) {
     app.setOrganizationName("ZoraPerl");
     
     // Create splash screen
+    qint64 splashStart = trace.elapsedMicroseconds();
     QPixmap splashPixmap(400, 300);
     splashPixmap.fill(QColor(16, 16, 16)); // Dark background
     
@@ -38,54 +55,92 @@ int main(int argc, char *argv[]) {
     QSplashScreen splash(splashPixmap);
     splash.show();
     app.processEvents();
+    trace.addComplete("splash", "startup", splashStart, trace.elapsedMicroseconds() - splashStart);
     
-    // Initialize system checker
+    // Config validation and Python bring-up run on worker threads while the
+    // desktop widgets are built here; the splash closes once every phase is ready
     SystemChecker checker;
+    PythonManager pythonManager;
+    StartupOrchestrator startup(&checker, &pythonManager);
     
-    splash.showMessage("Checking system configuration...", Qt::AlignBottom | Qt::AlignCenter, Qt::white);
-    app.processEvents();
+    // The interpreter warms up in the background unless eager startup is requested
+    bool eagerPython = app.arguments().contains("--eager-python")
+                       || qEnvironmentVariableIntValue("ZORAPERL_EAGER_PYTHON") != 0;
+    startup.setLazyPython(!eagerPython);
     
-    // Check if system is properly configured
-    if (!checker.isSystemConfigured()) {
-        splash.showMessage("System not configured. Starting setup...", Qt::AlignBottom | Qt::AlignCenter, Qt::white);
-        app.processEvents();
-        
-        QTimer::singleShot(1000, [&]() {
-            splash.close();
-            if (!checker.runOnboarding()) {
-                QMessageBox::critical(nullptr, "Error", "Failed to start onboarding process. Please run ZoraPerl_Onboarding manually.");
-                app.quit();
-                return;
-            }
-            // After onboarding, we should restart the main application
-            QMessageBox::information(nullptr, "Setup Complete", "ZoraPerl has been configured. Please restart the application.");
-            app.quit();
-        });
-        
-        return app.exec();
-    }
-    
-    // Initialize Python interpreter
-    splash.showMessage("Initializing Python interpreter...", Qt::AlignBottom | Qt::AlignCenter, Qt::white);
-    app.processEvents();
+    QObject::connect(&startup, &StartupOrchestrator::phaseStarted, [&](const QString &message) {
+        splash.showMessage(message, Qt::AlignBottom | Qt::AlignCenter, Qt::white);
+    });
     
-    PythonManager pythonManager;
-    if (!pythonManager.initialize()) {
+    // Queued: the eager phase can fail during processEvents() below, and
+    // app.exit() does nothing until app.exec() is running
+    QObject::connect(&startup, &StartupOrchestrator::pythonFailed, &app, [&]() {
         splash.close();
         QMessageBox::critical(nullptr, "Error", "Failed to initialize Python interpreter.");
-        return -1;
-    }
+        app.exit(-1);
+    }, Qt::QueuedConnection);
+    
+    startup.start();
     
     splash.showMessage("Starting desktop environment...", Qt::AlignBottom | Qt::AlignCenter, Qt::white);
     app.processEvents();
     
-    // Create and show desktop environment
+    // Create desktop environment while the worker phases are running
+    qint64 desktopStart = trace.elapsedMicroseconds();
     DesktopEnvironment desktop;
+    desktop.setPythonManager(&pythonManager);
+    trace.addComplete("DesktopEnvironment", "startup", desktopStart, trace.elapsedMicroseconds() - desktopStart);
+    
+    // First boot: run the onboarding in-process and go straight to the desktop
+    std::function<void()> runOnboarding;
+    runOnboarding = [&]() {
+        OnboardingFlow *onboarding = new OnboardingFlow(&app);
+        QObject::connect(onboarding, &OnboardingFlow::completed, [&, onboarding](const QJsonObject &config) {
+            onboarding->deleteLater();
+            
+            // A rejected config is neither kept nor snapshotted, so the next
+            // boot would land here again; ask for it now instead
+            if (!checker.adoptConfig(config)) {
+                QMessageBox::warning(nullptr, "Setup", "The settings could not be saved. Please run the setup again.");
+                runOnboarding();
+                return;
+            }
+            desktop.setDeveloperMode(config.value("developerMode").toBool());
+            desktop.setWallpaper(config.value("wallpaper").toString());
+            desktop.setUserName(config.value("username").toString());
+            
+            if (!startup.isLazyPython() && !pythonManager.isInitialized()) {
+                QMessageBox::critical(nullptr, "Error", "Failed to initialize Python interpreter.");
+                app.exit(-1);
+                return;
+            }
+            desktop.show();
+        });
+        QObject::connect(onboarding, &OnboardingFlow::cancelled, [&]() {
+            app.quit();
+        });
+        onboarding->start();
+    };
+    QObject::connect(&startup, &StartupOrchestrator::configurationMissing, [&]() {
+        splash.close();
+        runOnboarding();
+    });
     
-    QTimer::singleShot(1500, [&]() {
+    QObject::connect(&startup, &StartupOrchestrator::pythonUnavailable, [&]() {
+        QMessageBox::warning(&desktop, "Python", "The Python interpreter failed to start. Scripting features are unavailable.");
+    });
+    
+    QObject::connect(&startup, &StartupOrchestrator::ready, [&]() {
+        trace.addInstant("all phases ready", "startup");
+        desktop.setDeveloperMode(checker.config().value("developerMode").toBool());
+        desktop.setWallpaper(checker.config().value("wallpaper").toString());
+        desktop.setUserName(checker.config().value("username").toString());
         splash.close();
         desktop.show();
     });
     
+    // The final signals are emitted from inside the event loop
+    QTimer::singleShot(0, &startup, &StartupOrchestrator::markDesktopReady);
+    
     return app.exec();
 }
\ No newline at end of file